@@ -0,0 +1,523 @@
+#include "stdafx.h"
+#include "async_db.hpp"
+#include "event_loop.hpp"
+#include "logger.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <mariadb/errmsg.h>
+
+#ifdef _WIN32
+    #include <ws2tcpip.h>
+    #define poll WSAPoll
+#else
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <unistd.h>
+#endif
+
+void AsyncDatabase::Query(std::string sql, Callback callback)
+{
+    Request request;
+    request.sql = std::move(sql);
+    request.complete = [callback = std::move(callback)](AsyncResult&& result) {
+        EventLoop::GetInstance()->Post([callback, result = std::move(result)] {
+            callback(result);
+        });
+    };
+    m_engine->Submit(this, std::move(request));
+}
+
+std::future<AsyncResult> AsyncDatabase::Query(std::string sql)
+{
+    auto promise = std::make_shared<std::promise<AsyncResult>>();
+    std::future<AsyncResult> future = promise->get_future();
+
+    Request request;
+    request.sql = std::move(sql);
+    request.complete = [promise](AsyncResult&& result) {
+        promise->set_value(std::move(result));
+    };
+    m_engine->Submit(this, std::move(request));
+    return future;
+}
+
+AsyncDatabase::AsyncDatabase(AsyncQueryEngine* engine, const DatabaseConfig& config, size_t connections)
+    : m_engine(engine), m_config(config), m_connections(connections)
+{
+}
+
+AsyncQueryEngine::~AsyncQueryEngine()
+{
+    Stop();
+}
+
+AsyncDatabase* AsyncQueryEngine::AddDatabase(const DatabaseConfig& config, size_t connections)
+{
+    m_databases.emplace_back(new AsyncDatabase(this, config, std::max<size_t>(connections, 1)));
+    return m_databases.back().get();
+}
+
+bool AsyncQueryEngine::Start()
+{
+    if (m_running) {
+        return true;
+    }
+
+    if (!OpenWakeup()) {
+        logger::error("AsyncQueryEngine: couldn't create wakeup channel");
+        return false;
+    }
+
+    // connections that fail here are retried when a query needs them
+    bool ok = true;
+    for (auto& database : m_databases) {
+        for (Connection& connection : database->m_connections) {
+            ok &= Connect(database.get(), connection);
+        }
+    }
+
+    m_running = true;
+    m_thread = std::thread(&AsyncQueryEngine::Run, this);
+    return ok;
+}
+
+void AsyncQueryEngine::Stop()
+{
+    // under the lock so a concurrent Submit either lands before the drain below or fails
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return;
+        }
+        m_running = false;
+        Wake();
+    }
+
+    m_thread.join();
+
+    for (auto& database : m_databases) {
+        for (Connection& connection : database->m_connections) {
+            if (connection.state != AsyncDatabase::State::Idle) {
+                connection.state = AsyncDatabase::State::Idle;
+                AsyncResult result;
+                result.m_error = "shutting down";
+                Complete(connection.request, std::move(result));
+            }
+            if (connection.mysql) {
+                mysql_close(connection.mysql);
+                connection.mysql = nullptr;
+            }
+        }
+        database->m_pending.clear();
+    }
+
+    std::vector<std::pair<AsyncDatabase*, Request>> submitted;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        submitted.swap(m_submitted);
+    }
+    for (auto& [database, request] : submitted) {
+        AsyncResult result;
+        result.m_error = "shutting down";
+        Complete(request, std::move(result));
+    }
+
+    // Submit only wakes under the lock while running, nobody can write past this point
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CloseWakeup();
+}
+
+void AsyncQueryEngine::Submit(AsyncDatabase* database, Request request)
+{
+    request.queuedAt = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_running) {
+            m_submitted.emplace_back(database, std::move(request));
+            // still under the lock, Stop can't close the pipe in between
+            Wake();
+            return;
+        }
+    }
+
+    AsyncResult result;
+    result.m_error = "async query engine isn't running";
+    Complete(request, std::move(result));
+}
+
+#ifdef _WIN32
+bool AsyncQueryEngine::OpenWakeup()
+{
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        return false;
+    }
+
+    // no socketpair() on Windows, connect two ends through a loopback listener
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int addrLen = sizeof(addr);
+
+    bool ok = listener != INVALID_SOCKET
+        && bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0
+        && getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addrLen) == 0
+        && listen(listener, 1) == 0;
+    if (ok) {
+        m_wakeup[1] = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        ok = m_wakeup[1] != INVALID_SOCKET
+            && connect(m_wakeup[1], reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    }
+    if (ok) {
+        m_wakeup[0] = accept(listener, nullptr, nullptr);
+        ok = m_wakeup[0] != INVALID_SOCKET;
+    }
+    if (listener != INVALID_SOCKET) {
+        closesocket(listener);
+    }
+
+    u_long nonBlocking = 1;
+    ok = ok && ioctlsocket(m_wakeup[0], FIONBIO, &nonBlocking) == 0
+            && ioctlsocket(m_wakeup[1], FIONBIO, &nonBlocking) == 0;
+    if (!ok) {
+        CloseWakeup();
+    }
+    return ok;
+}
+
+void AsyncQueryEngine::CloseWakeup()
+{
+    if (m_wakeup[0] == InvalidWakeHandle && m_wakeup[1] == InvalidWakeHandle) {
+        return;
+    }
+    for (WakeHandle& handle : m_wakeup) {
+        if (handle != InvalidWakeHandle) {
+            closesocket(handle);
+            handle = InvalidWakeHandle;
+        }
+    }
+    WSACleanup();
+}
+
+void AsyncQueryEngine::Wake()
+{
+    char byte = 0;
+    // a full buffer already means a pending wakeup
+    send(m_wakeup[1], &byte, 1, 0);
+}
+
+void AsyncQueryEngine::DrainWakeup()
+{
+    char buffer[64];
+    while (recv(m_wakeup[0], buffer, sizeof(buffer), 0) > 0) {
+    }
+}
+#else
+bool AsyncQueryEngine::OpenWakeup()
+{
+    if (pipe(m_wakeup) != 0) {
+        return false;
+    }
+    fcntl(m_wakeup[0], F_SETFL, O_NONBLOCK);
+    fcntl(m_wakeup[1], F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+void AsyncQueryEngine::CloseWakeup()
+{
+    for (WakeHandle& handle : m_wakeup) {
+        if (handle != InvalidWakeHandle) {
+            close(handle);
+            handle = InvalidWakeHandle;
+        }
+    }
+}
+
+void AsyncQueryEngine::Wake()
+{
+    char byte = 0;
+    // a full pipe already means a pending wakeup
+    (void)!write(m_wakeup[1], &byte, 1);
+}
+
+void AsyncQueryEngine::DrainWakeup()
+{
+    char buffer[64];
+    while (read(m_wakeup[0], buffer, sizeof(buffer)) > 0) {
+    }
+}
+#endif
+
+void AsyncQueryEngine::Run()
+{
+    std::vector<pollfd> fds;
+    std::vector<std::pair<AsyncDatabase*, Connection*>> polled;
+
+    while (m_running) {
+        std::vector<std::pair<AsyncDatabase*, Request>> submitted;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            submitted.swap(m_submitted);
+        }
+        for (auto& [database, request] : submitted) {
+            database->m_pending.push_back(std::move(request));
+        }
+
+        fds.clear();
+        polled.clear();
+        fds.push_back({m_wakeup[0], POLLIN, 0});
+
+        Clock::time_point now = Clock::now();
+        int timeout = -1;
+        size_t inFlight = 0;
+
+        for (auto& database : m_databases) {
+            for (Connection& connection : database->m_connections) {
+                // a query can complete inside StartQuery (errors always do), the
+                // connection is free again and the queue must not wait for a wakeup
+                while (connection.state == AsyncDatabase::State::Idle && !database->m_pending.empty()) {
+                    connection.request = std::move(database->m_pending.front());
+                    database->m_pending.pop_front();
+                    StartQuery(database.get(), connection);
+                }
+
+                if (connection.state == AsyncDatabase::State::Idle) {
+                    continue;
+                }
+
+                inFlight++;
+                short events = 0;
+                if (connection.wait & MYSQL_WAIT_READ) {
+                    events |= POLLIN;
+                }
+                if (connection.wait & MYSQL_WAIT_WRITE) {
+                    events |= POLLOUT;
+                }
+#ifndef _WIN32
+                // WSAPoll rejects POLLPRI
+                if (connection.wait & MYSQL_WAIT_EXCEPT) {
+                    events |= POLLPRI;
+                }
+#endif
+                if (connection.wait & MYSQL_WAIT_TIMEOUT) {
+                    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(connection.deadline - now).count();
+                    int ms = static_cast<int>(std::max<int64_t>(remaining, 0));
+                    timeout = timeout < 0 ? ms : std::min(timeout, ms);
+                }
+
+                fds.push_back({static_cast<WakeHandle>(mysql_get_socket(connection.mysql)), events, 0});
+                polled.emplace_back(database.get(), &connection);
+            }
+        }
+
+        if (inFlight > m_peakInFlight) {
+            m_peakInFlight = inFlight;
+        }
+
+#ifdef _WIN32
+        if (poll(fds.data(), static_cast<ULONG>(fds.size()), timeout) == SOCKET_ERROR) {
+            logger::error("AsyncQueryEngine: poll failed: %d", WSAGetLastError());
+        }
+#else
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) {
+            logger::error("AsyncQueryEngine: poll failed: %s", strerror(errno));
+        }
+#endif
+
+        if (fds[0].revents & POLLIN) {
+            DrainWakeup();
+        }
+
+        now = Clock::now();
+        for (size_t i = 0; i < polled.size(); i++) {
+            auto [database, connection] = polled[i];
+            short revents = fds[i + 1].revents;
+
+            int status = 0;
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                status |= MYSQL_WAIT_READ;
+            }
+            if (revents & POLLOUT) {
+                status |= MYSQL_WAIT_WRITE;
+            }
+#ifndef _WIN32
+            if (revents & POLLPRI) {
+                status |= MYSQL_WAIT_EXCEPT;
+            }
+#endif
+            if (!status && (connection->wait & MYSQL_WAIT_TIMEOUT) && now >= connection->deadline) {
+                status = MYSQL_WAIT_TIMEOUT;
+            }
+
+            if (status) {
+                Continue(database, *connection, status);
+            }
+        }
+    }
+}
+
+bool AsyncQueryEngine::Connect(AsyncDatabase* database, Connection& connection)
+{
+    if (connection.mysql) {
+        mysql_close(connection.mysql);
+    }
+
+    connection.mysql = mysql_init(NULL);
+    if (!connection.mysql) {
+        logger::error("AsyncQueryEngine: failed to initialize MySQL object for %s", database->GetName().c_str());
+        return false;
+    }
+
+    unsigned int connectTimeout = 5;
+    mysql_options(connection.mysql, MYSQL_OPT_CONNECT_TIMEOUT, &connectTimeout);
+    // a hung server fails the query instead of holding the connection and its callback forever
+    unsigned int ioTimeout = 30;
+    mysql_options(connection.mysql, MYSQL_OPT_READ_TIMEOUT, &ioTimeout);
+    mysql_options(connection.mysql, MYSQL_OPT_WRITE_TIMEOUT, &ioTimeout);
+    mysql_options(connection.mysql, MYSQL_OPT_NONBLOCK, 0);
+
+    // connecting blocks this thread, it only happens at startup and after a connection broke
+    const DatabaseConfig& config = database->m_config;
+    if (!mysql_real_connect(connection.mysql, config.host.c_str(), config.user.c_str(),
+                            config.password.c_str(), config.database.c_str(), config.port, NULL, 0)) {
+        logger::error("AsyncQueryEngine: failed to connect to %s: %s", config.database.c_str(), mysql_error(connection.mysql));
+        return false;
+    }
+
+    if (!config.initQuery.empty() && mysql_query(connection.mysql, config.initQuery.c_str()) != 0) {
+        logger::error("AsyncQueryEngine: failed to initialize connection to %s: %s", config.database.c_str(), mysql_error(connection.mysql));
+        return false;
+    }
+
+    connection.broken = false;
+    return true;
+}
+
+void AsyncQueryEngine::StartQuery(AsyncDatabase* database, Connection& connection)
+{
+    if (connection.broken && !Connect(database, connection)) {
+        // the queue fails with it rather than paying a connect timeout per query
+        std::deque<Request> failed;
+        failed.swap(database->m_pending);
+        failed.push_front(std::move(connection.request));
+        for (Request& request : failed) {
+            AsyncResult result;
+            result.m_error = "no connection to " + database->GetName();
+            m_failed++;
+            Complete(request, std::move(result));
+        }
+        return;
+    }
+
+    int error = 0;
+    connection.state = AsyncDatabase::State::Querying;
+    connection.wait = mysql_real_query_start(&error, connection.mysql, connection.request.sql.data(),
+                                             static_cast<unsigned long>(connection.request.sql.size()));
+    if (connection.wait == 0) {
+        // answered without blocking, e.g. the send failed right away
+        Continue(database, connection, 0);
+    } else if (connection.wait & MYSQL_WAIT_TIMEOUT) {
+        connection.deadline = Clock::now() + std::chrono::milliseconds(mysql_get_timeout_value_ms(connection.mysql));
+    }
+}
+
+void AsyncQueryEngine::Continue(AsyncDatabase* database, Connection& connection, int status)
+{
+    MYSQL_RES* result = nullptr;
+
+    if (connection.state == AsyncDatabase::State::Querying) {
+        int error = 0;
+        if (status) {
+            connection.wait = mysql_real_query_cont(&error, connection.mysql, status);
+            if (connection.wait) {
+                if (connection.wait & MYSQL_WAIT_TIMEOUT) {
+                    connection.deadline = Clock::now() + std::chrono::milliseconds(mysql_get_timeout_value_ms(connection.mysql));
+                }
+                return;
+            }
+        } else {
+            error = mysql_errno(connection.mysql);
+        }
+
+        if (error) {
+            Fail(database, connection);
+            return;
+        }
+
+        connection.state = AsyncDatabase::State::Storing;
+        connection.wait = mysql_store_result_start(&result, connection.mysql);
+    } else {
+        connection.wait = mysql_store_result_cont(&result, connection.mysql, status);
+    }
+
+    if (connection.wait) {
+        if (connection.wait & MYSQL_WAIT_TIMEOUT) {
+            connection.deadline = Clock::now() + std::chrono::milliseconds(mysql_get_timeout_value_ms(connection.mysql));
+        }
+        return;
+    }
+
+    if (!result && mysql_field_count(connection.mysql) != 0) {
+        Fail(database, connection);
+        return;
+    }
+
+    Finish(connection, result);
+}
+
+void AsyncQueryEngine::Finish(Connection& connection, MYSQL_RES* result)
+{
+    AsyncResult outcome;
+    outcome.m_ok = true;
+    if (result) {
+        outcome.m_result.reset(result, mysql_free_result);
+    } else {
+        outcome.m_affectedRows = mysql_affected_rows(connection.mysql);
+    }
+
+    connection.state = AsyncDatabase::State::Idle;
+    connection.wait = 0;
+
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - connection.request.queuedAt);
+    m_totalLatencyUs += latency.count();
+    m_completed++;
+
+    Complete(connection.request, std::move(outcome));
+}
+
+void AsyncQueryEngine::Fail(AsyncDatabase* database, Connection& connection)
+{
+    unsigned int error = mysql_errno(connection.mysql);
+    AsyncResult outcome;
+    outcome.m_error = mysql_error(connection.mysql);
+    logger::error("AsyncQueryEngine: query on %s failed: %s", database->GetName().c_str(), outcome.m_error.c_str());
+
+    // reconnected before its next query; the failed one isn't retried since it may have run
+    if (error == CR_SERVER_GONE_ERROR || error == CR_SERVER_LOST) {
+        connection.broken = true;
+    }
+
+    connection.state = AsyncDatabase::State::Idle;
+    connection.wait = 0;
+    m_failed++;
+
+    Complete(connection.request, std::move(outcome));
+}
+
+void AsyncQueryEngine::Complete(Request& request, AsyncResult&& result)
+{
+    std::function<void(AsyncResult&&)> complete = std::move(request.complete);
+    request = Request();
+    if (complete) {
+        complete(std::move(result));
+    }
+}
+
+void AsyncQueryEngine::LogStats() const
+{
+    uint64_t completed = m_completed.load();
+    logger::info("AsyncQueryEngine: %llu queries completed, %llu failed, avg latency %llu us, peak %zu in flight",
+                 completed, m_failed.load(), completed ? m_totalLatencyUs.load() / completed : 0ULL, m_peakInFlight.load());
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+#endif
+
+#include <mariadb/mysql.h>
+#include "db_pool.hpp" // DatabaseConfig
+
+class AsyncQueryEngine;
+
+// outcome of an async query; the stored result is freed with the last copy
+class AsyncResult {
+public:
+    bool Ok() const { return m_ok; }
+    const std::string& Error() const { return m_error; }
+
+    // nullptr on errors and for statements without a result set
+    MYSQL_RES* Get() const { return m_result.get(); }
+    uint64_t AffectedRows() const { return m_affectedRows; }
+
+private:
+    friend class AsyncQueryEngine;
+
+    bool m_ok = false;
+    std::string m_error;
+    std::shared_ptr<MYSQL_RES> m_result;
+    uint64_t m_affectedRows = 0;
+};
+
+// A logical database served by a few non-blocking connections of an AsyncQueryEngine
+// Queries are queued and handed to whichever connection is free, one in flight per
+// connection since the protocol doesn't pipeline
+class AsyncDatabase {
+public:
+    using Callback = std::function<void(const AsyncResult&)>;
+
+    // thread safe, the callback runs on the GC event loop
+    void Query(std::string sql, Callback callback);
+
+    // thread safe, for worker threads that wait on several queries at once
+    std::future<AsyncResult> Query(std::string sql);
+
+    const std::string& GetName() const { return m_config.database; }
+
+private:
+    friend class AsyncQueryEngine;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Request {
+        std::string sql;
+        std::function<void(AsyncResult&&)> complete;
+        Clock::time_point queuedAt;
+    };
+
+    enum class State { Idle, Querying, Storing };
+
+    struct Connection {
+        MYSQL* mysql = nullptr;
+        State state = State::Idle;
+        bool broken = true;
+        int wait = 0; // MYSQL_WAIT_* the client library is blocked on
+        Clock::time_point deadline;
+        Request request;
+    };
+
+    AsyncDatabase(AsyncQueryEngine* engine, const DatabaseConfig& config, size_t connections);
+
+    AsyncQueryEngine* m_engine;
+    DatabaseConfig m_config;
+
+    // engine thread only
+    std::vector<Connection> m_connections;
+    std::deque<Request> m_pending;
+};
+
+// Event driven MariaDB client
+// One thread polls the sockets of every connection and steps the client library's
+// non-blocking state machines (mysql_real_query_start/_cont, mysql_store_result_start/_cont),
+// so dozens of queries can be outstanding without a thread blocked on each
+class AsyncQueryEngine {
+public:
+    AsyncQueryEngine() = default;
+    ~AsyncQueryEngine();
+
+    AsyncQueryEngine(const AsyncQueryEngine&) = delete;
+    AsyncQueryEngine& operator=(const AsyncQueryEngine&) = delete;
+
+    // before Start, the engine owns the database
+    AsyncDatabase* AddDatabase(const DatabaseConfig& config, size_t connections);
+
+    bool Start();
+    // fails queries still queued or in flight
+    void Stop();
+
+    void LogStats() const;
+
+private:
+    friend class AsyncDatabase;
+
+    using Clock = AsyncDatabase::Clock;
+    using Connection = AsyncDatabase::Connection;
+    using Request = AsyncDatabase::Request;
+
+    void Submit(AsyncDatabase* database, Request request);
+    void Wake();
+    void Run();
+
+    bool Connect(AsyncDatabase* database, Connection& connection);
+    void StartQuery(AsyncDatabase* database, Connection& connection);
+    void Continue(AsyncDatabase* database, Connection& connection, int status);
+    void Finish(Connection& connection, MYSQL_RES* result);
+    void Fail(AsyncDatabase* database, Connection& connection);
+    void Complete(Request& request, AsyncResult&& result);
+
+    std::vector<std::unique_ptr<AsyncDatabase>> m_databases;
+
+    // a pipe, or a connected loopback socket pair on Windows where WSAPoll only takes sockets
+#ifdef _WIN32
+    using WakeHandle = SOCKET;
+    static constexpr WakeHandle InvalidWakeHandle = INVALID_SOCKET;
+#else
+    using WakeHandle = int;
+    static constexpr WakeHandle InvalidWakeHandle = -1;
+#endif
+    bool OpenWakeup();
+    void CloseWakeup();
+    void DrainWakeup();
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    WakeHandle m_wakeup[2] = {InvalidWakeHandle, InvalidWakeHandle};
+
+    std::mutex m_mutex;
+    std::vector<std::pair<AsyncDatabase*, Request>> m_submitted;
+
+    // stats
+    std::atomic<uint64_t> m_completed{0};
+    std::atomic<uint64_t> m_failed{0};
+    std::atomic<uint64_t> m_totalLatencyUs{0};
+    std::atomic<size_t> m_peakInFlight{0};
+};
@@ -0,0 +1,311 @@
+#include "stdafx.h"
+#include "ban_index.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+// edits and acknowledgements only show up with a full resync
+constexpr std::chrono::minutes BanResyncInterval{10};
+constexpr std::chrono::minutes CooldownResyncInterval{1};
+constexpr int ReadBatchSize = 1000;
+
+static MYSQL_RES* Select(MYSQL* mysql, const char* query)
+{
+    if (mysql_query(mysql, query) != 0) {
+        logger::error("BanIndex: query failed: %s", mysql_error(mysql));
+        return nullptr;
+    }
+
+    MYSQL_RES* result = mysql_store_result(mysql);
+    if (!result) {
+        logger::error("BanIndex: failed to store result: %s", mysql_error(mysql));
+    }
+    return result;
+}
+
+// STEAM_X:Y:Z, the universe digit differs between sources so only Y and Z count
+static bool ParseSteamID2(const char* steamId2, uint32_t& accountId)
+{
+    unsigned universe, low, high;
+    if (!steamId2 || sscanf(steamId2, "STEAM_%u:%u:%u", &universe, &low, &high) != 3 || low > 1) {
+        return false;
+    }
+
+    accountId = high * 2 + low;
+    return true;
+}
+
+static void AddBan(std::unordered_map<uint32_t, uint32_t>& owners,
+                   std::unordered_map<uint32_t, uint32_t>& counts,
+                   uint32_t banId, uint32_t accountId)
+{
+    if (owners.emplace(banId, accountId).second) {
+        counts[accountId]++;
+    }
+}
+
+static void RemoveBan(std::unordered_map<uint32_t, uint32_t>& owners,
+                      std::unordered_map<uint32_t, uint32_t>& counts,
+                      uint32_t banId)
+{
+    auto it = owners.find(banId);
+    if (it == owners.end()) {
+        return;
+    }
+
+    auto count = counts.find(it->second);
+    if (count != counts.end() && --count->second == 0) {
+        counts.erase(count);
+    }
+    owners.erase(it);
+}
+
+bool BanIndex::Load(MYSQL* mysql)
+{
+    bool ok = LoadBans(mysql);
+    ok &= LoadCooldowns(mysql);
+
+    LogStats();
+    return ok;
+}
+
+bool BanIndex::Refresh(MYSQL* mysql)
+{
+    Clock::time_point now = Clock::now();
+
+    bool ok;
+    if (now >= m_nextBanResync) {
+        ok = LoadBans(mysql);
+    } else {
+        ok = ReadNewBans(mysql) && ReadLiftedBans(mysql);
+    }
+
+    if (now >= m_nextCooldownResync) {
+        ok &= LoadCooldowns(mysql);
+    } else {
+        ok &= ReadNewCooldowns(mysql);
+    }
+
+    return ok;
+}
+
+bool BanIndex::IsBanned(uint32_t accountId) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_banCounts.count(accountId) != 0;
+}
+
+bool BanIndex::GetCooldown(uint32_t accountId, PlayerCooldown& cooldown) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_cooldowns.find(accountId);
+    if (it == m_cooldowns.end()) {
+        return false;
+    }
+
+    cooldown = it->second;
+    return true;
+}
+
+bool BanIndex::LoadBans(MYSQL* mysql)
+{
+    // watermarks first, rows landing while the set loads are picked up again by
+    // the next tail and adding a ban twice is a no-op
+    MYSQL_RES* result = Select(mysql,
+        "SELECT COALESCE(MAX(bid), 0), COALESCE(MAX(RemovedOn), 0) FROM sb_bans");
+    if (!result) {
+        return false;
+    }
+
+    MYSQL_ROW row = mysql_fetch_row(result);
+    uint32_t lastBanId = row && row[0] ? strtoul(row[0], nullptr, 10) : 0;
+    int64_t lastRemovedOn = row && row[1] ? strtoll(row[1], nullptr, 10) : 0;
+    mysql_free_result(result);
+
+    result = Select(mysql,
+        "SELECT bid, authid FROM sb_bans WHERE length = 0 AND RemoveType IS NULL");
+    if (!result) {
+        return false;
+    }
+
+    std::unordered_map<uint32_t, uint32_t> owners;
+    std::unordered_map<uint32_t, uint32_t> counts;
+    while ((row = mysql_fetch_row(result))) {
+        uint32_t accountId;
+        if (row[0] && ParseSteamID2(row[1], accountId)) {
+            AddBan(owners, counts, strtoul(row[0], nullptr, 10), accountId);
+        }
+    }
+    mysql_free_result(result);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_banOwners.swap(owners);
+        m_banCounts.swap(counts);
+    }
+
+    m_lastBanId = lastBanId;
+    m_lastRemovedOn = lastRemovedOn;
+    m_nextBanResync = Clock::now() + BanResyncInterval;
+    return true;
+}
+
+bool BanIndex::LoadCooldowns(MYSQL* mysql)
+{
+    MYSQL_RES* result = Select(mysql, "SELECT COALESCE(MAX(id), 0) FROM cooldowns");
+    if (!result) {
+        return false;
+    }
+
+    MYSQL_ROW row = mysql_fetch_row(result);
+    uint64_t lastCooldownId = row && row[0] ? strtoull(row[0], nullptr, 10) : 0;
+    mysql_free_result(result);
+
+    // only a player's latest cooldown counts, and only until it's acknowledged
+    result = Select(mysql,
+        "SELECT c.id, c.sid, c.cooldown_reason, c.cooldown_expire FROM cooldowns c "
+        "JOIN (SELECT sid, MAX(id) AS id FROM cooldowns GROUP BY sid) latest ON latest.id = c.id "
+        "WHERE c.acknowledged = 0");
+    if (!result) {
+        return false;
+    }
+
+    std::unordered_map<uint32_t, PlayerCooldown> cooldowns;
+    while ((row = mysql_fetch_row(result))) {
+        uint32_t accountId;
+        if (!row[0] || !ParseSteamID2(row[1], accountId)) {
+            continue;
+        }
+
+        PlayerCooldown& cooldown = cooldowns[accountId];
+        cooldown.id = strtoull(row[0], nullptr, 10);
+        cooldown.reason = row[2] ? strtoul(row[2], nullptr, 10) : 0;
+        cooldown.expire = row[3] ? atol(row[3]) : 0;
+    }
+    mysql_free_result(result);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cooldowns.swap(cooldowns);
+    }
+
+    m_lastCooldownId = lastCooldownId;
+    m_nextCooldownResync = Clock::now() + CooldownResyncInterval;
+    return true;
+}
+
+bool BanIndex::ReadNewBans(MYSQL* mysql)
+{
+    char query[256];
+    snprintf(query, sizeof(query),
+             "SELECT bid, authid, length, RemoveType FROM sb_bans WHERE bid > %u ORDER BY bid LIMIT %d",
+             m_lastBanId, ReadBatchSize);
+
+    MYSQL_RES* result = Select(mysql, query);
+    if (!result) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result))) {
+        if (!row[0]) {
+            continue;
+        }
+
+        uint32_t banId = strtoul(row[0], nullptr, 10);
+        m_lastBanId = std::max(m_lastBanId, banId);
+
+        uint32_t accountId;
+        bool permanent = row[2] && atoi(row[2]) == 0 && !row[3];
+        if (permanent && ParseSteamID2(row[1], accountId)) {
+            AddBan(m_banOwners, m_banCounts, banId, accountId);
+        }
+    }
+    mysql_free_result(result);
+    return true;
+}
+
+bool BanIndex::ReadLiftedBans(MYSQL* mysql)
+{
+    // RemovedOn has second resolution, the last second is read again so an unban
+    // committed later in the same second isn't missed; removing twice is a no-op
+    char query[256];
+    snprintf(query, sizeof(query),
+             "SELECT bid, RemovedOn FROM sb_bans WHERE RemovedOn >= %lld AND RemoveType IS NOT NULL",
+             static_cast<long long>(m_lastRemovedOn));
+
+    MYSQL_RES* result = Select(mysql, query);
+    if (!result) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result))) {
+        if (!row[0] || !row[1]) {
+            continue;
+        }
+
+        RemoveBan(m_banOwners, m_banCounts, strtoul(row[0], nullptr, 10));
+        m_lastRemovedOn = std::max<int64_t>(m_lastRemovedOn, strtoll(row[1], nullptr, 10));
+    }
+    mysql_free_result(result);
+    return true;
+}
+
+bool BanIndex::ReadNewCooldowns(MYSQL* mysql)
+{
+    char query[256];
+    snprintf(query, sizeof(query),
+             "SELECT id, sid, cooldown_reason, cooldown_expire, acknowledged FROM cooldowns "
+             "WHERE id > %llu ORDER BY id LIMIT %d",
+             static_cast<unsigned long long>(m_lastCooldownId), ReadBatchSize);
+
+    MYSQL_RES* result = Select(mysql, query);
+    if (!result) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result))) {
+        if (!row[0]) {
+            continue;
+        }
+
+        uint64_t id = strtoull(row[0], nullptr, 10);
+        m_lastCooldownId = std::max(m_lastCooldownId, id);
+
+        uint32_t accountId;
+        if (!ParseSteamID2(row[1], accountId)) {
+            continue;
+        }
+
+        // a newer row replaces the player's cooldown, acknowledged or not
+        bool acknowledged = row[4] && atoi(row[4]) != 0;
+        if (acknowledged) {
+            m_cooldowns.erase(accountId);
+            continue;
+        }
+
+        PlayerCooldown& cooldown = m_cooldowns[accountId];
+        cooldown.id = id;
+        cooldown.reason = row[2] ? strtoul(row[2], nullptr, 10) : 0;
+        cooldown.expire = row[3] ? atol(row[3]) : 0;
+    }
+    mysql_free_result(result);
+    return true;
+}
+
+void BanIndex::LogStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    logger::info("BanIndex: %zu banned players (%zu permanent bans), %zu pending cooldowns",
+                 m_banCounts.size(), m_banOwners.size(), m_cooldowns.size());
+}
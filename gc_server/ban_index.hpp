@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <unordered_map>
+
+#include <mariadb/mysql.h>
+
+// latest cooldown of a player that hasn't been acknowledged yet
+struct PlayerCooldown {
+    uint64_t id;
+    uint32_t reason;
+    time_t expire;
+};
+
+// Permanent bans (sb_bans) and pending cooldowns (cooldowns) of classiccounter kept in memory
+// Loaded once at startup, then tailed by primary key for new rows and by RemovedOn for
+// lifted bans. Cooldowns get acknowledged in place and bans can be edited, neither leaves
+// a trail to tail, so both tables are resynced in full every now and then.
+// Lookups are thread safe, Load and Refresh are meant to be driven from a single strand
+class BanIndex {
+public:
+    bool Load(MYSQL* mysql);
+    bool Refresh(MYSQL* mysql);
+
+    bool IsBanned(uint32_t accountId) const;
+    bool GetCooldown(uint32_t accountId, PlayerCooldown& cooldown) const;
+
+    void LogStats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    bool LoadBans(MYSQL* mysql);
+    bool LoadCooldowns(MYSQL* mysql);
+    bool ReadNewBans(MYSQL* mysql);
+    bool ReadLiftedBans(MYSQL* mysql);
+    bool ReadNewCooldowns(MYSQL* mysql);
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint32_t, uint32_t> m_banOwners; // bid -> account id, active permanent bans
+    std::unordered_map<uint32_t, uint32_t> m_banCounts; // account id -> active permanent bans
+    std::unordered_map<uint32_t, PlayerCooldown> m_cooldowns;
+
+    // refresh strand only
+    uint32_t m_lastBanId = 0;
+    int64_t m_lastRemovedOn = 0;
+    uint64_t m_lastCooldownId = 0;
+    Clock::time_point m_nextBanResync;
+    Clock::time_point m_nextCooldownResync;
+};
@@ -0,0 +1,95 @@
+#include "stdafx.h"
+#include "buffer_pool.hpp"
+#include "logger.hpp"
+
+BufferPool::BufferPool(const char* name, size_t buffersPerClass)
+    : m_name(name), m_buffersPerClass(buffersPerClass)
+{
+}
+
+BufferPool::~BufferPool()
+{
+    for (auto& list : m_free) {
+        for (std::vector<uint8_t>* buffer : list) {
+            delete buffer;
+        }
+    }
+}
+
+size_t BufferPool::ClassOf(size_t size)
+{
+    size_t sizeClass = 0;
+    while ((MinClassSize << sizeClass) < size) {
+        sizeClass++;
+    }
+    return sizeClass;
+}
+
+BufferPool::Buffer BufferPool::Acquire(size_t size)
+{
+    if (size > MaxClassSize) {
+        m_oversize++;
+        return Buffer(new std::vector<uint8_t>(size), Releaser{this});
+    }
+
+    size_t sizeClass = ClassOf(size);
+    std::vector<uint8_t>* buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& list = m_free[sizeClass];
+        if (!list.empty()) {
+            buffer = list.back();
+            list.pop_back();
+        }
+    }
+
+    if (buffer) {
+        m_hits++;
+    } else {
+        // full class capacity up front, resizing within the class never reallocates
+        m_misses++;
+        buffer = new std::vector<uint8_t>();
+        buffer->reserve(MinClassSize << sizeClass);
+    }
+
+    buffer->resize(size);
+    return Buffer(buffer, Releaser{this});
+}
+
+void BufferPool::Release(std::vector<uint8_t>* buffer)
+{
+    size_t capacity = buffer->capacity();
+    if (capacity >= MinClassSize && capacity <= MaxClassSize) {
+        // the class the capacity fully covers, a resize can't have grown it past that
+        size_t sizeClass = ClassOf(capacity);
+        if ((MinClassSize << sizeClass) > capacity) {
+            sizeClass--;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& list = m_free[sizeClass];
+        if (list.size() < m_buffersPerClass) {
+            list.push_back(buffer);
+            return;
+        }
+    }
+
+    delete buffer;
+}
+
+void BufferPool::LogStats() const
+{
+    size_t pooled = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& list : m_free) {
+            pooled += list.size();
+        }
+    }
+
+    uint64_t hits = m_hits.load();
+    uint64_t misses = m_misses.load();
+    logger::info("BufferPool %s: %zu pooled, %llu hits, %llu misses (%.1f%% hit rate), %llu oversize",
+                 m_name, pooled, hits, misses, hits + misses ? 100.0 * hits / (hits + misses) : 0.0,
+                 m_oversize.load());
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Recycled byte buffers in power of two size classes
+// A buffer goes back to its class when the handle is destroyed, so the pool has to
+// outlive every buffer it hands out. Sizes above the largest class are allocated
+// and freed as usual. Thread safe
+class BufferPool {
+    struct Releaser {
+        BufferPool* pool;
+        void operator()(std::vector<uint8_t>* buffer) const { pool->Release(buffer); }
+    };
+
+public:
+    using Buffer = std::unique_ptr<std::vector<uint8_t>, Releaser>;
+
+    static constexpr size_t MinClassSize = 256;
+    static constexpr size_t ClassCount = 9; // 256 B .. 64 KiB
+    static constexpr size_t MaxClassSize = MinClassSize << (ClassCount - 1);
+
+    explicit BufferPool(const char* name, size_t buffersPerClass = 32);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // buffer of exactly size bytes, contents are unspecified
+    Buffer Acquire(size_t size);
+
+    void LogStats() const;
+
+private:
+    static size_t ClassOf(size_t size);
+    void Release(std::vector<uint8_t>* buffer);
+
+    const char* m_name;
+    const size_t m_buffersPerClass;
+
+    mutable std::mutex m_mutex;
+    std::array<std::vector<std::vector<uint8_t>*>, ClassCount> m_free;
+
+    // stats
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+    std::atomic<uint64_t> m_oversize{0};
+};
@@ -0,0 +1,338 @@
+#include "stdafx.h"
+#include "db_pool.hpp"
+#include "db_statements.hpp"
+#include "logger.hpp"
+
+#include <mariadb/errmsg.h>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+// idle connections older than this are pinged before being handed out
+constexpr std::chrono::seconds StaleAfter{30};
+
+DatabasePool::Connection::Connection(Connection&& other) noexcept
+    : m_pool(other.m_pool)
+    , m_connection(other.m_connection)
+{
+    other.m_pool = nullptr;
+    other.m_connection = nullptr;
+}
+
+DatabasePool::Connection& DatabasePool::Connection::operator=(Connection&& other) noexcept
+{
+    if (this != &other) {
+        Release();
+        m_pool = other.m_pool;
+        m_connection = other.m_connection;
+        other.m_pool = nullptr;
+        other.m_connection = nullptr;
+    }
+    return *this;
+}
+
+DatabasePool::Connection::~Connection()
+{
+    Release();
+}
+
+MYSQL* DatabasePool::Connection::Get() const
+{
+    return m_connection ? m_connection->mysql : nullptr;
+}
+
+void DatabasePool::Connection::Release()
+{
+    if (m_connection) {
+        m_pool->Return(m_connection);
+        m_connection = nullptr;
+        m_pool = nullptr;
+    }
+}
+
+DatabasePool::DatabasePool(const DatabaseConfig& config, size_t minConnections, size_t maxConnections)
+    : m_config(config)
+    , m_minConnections(minConnections)
+    , m_maxConnections(std::max<size_t>(maxConnections, 1))
+{
+}
+
+DatabasePool::~DatabasePool()
+{
+    Close();
+}
+
+bool DatabasePool::Open()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = false;
+    }
+
+    size_t opened = 0;
+    for (size_t i = 0; i < m_minConnections; i++) {
+        PooledConnection* connection = CreateConnection();
+        if (!connection) {
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_total++;
+        m_idle.push_back(connection);
+        opened++;
+    }
+
+    if (opened == 0 && m_minConnections > 0) {
+        logger::error("DatabasePool: couldn't open any connection to %s", m_config.database.c_str());
+        return false;
+    }
+
+    logger::info("Connected to %s DB successfully! (%zu connections, max %zu)",
+                 m_config.database.c_str(), opened, m_maxConnections);
+    return true;
+}
+
+void DatabasePool::Close()
+{
+    std::vector<PooledConnection*> idle;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        idle.swap(m_idle);
+        m_total -= idle.size();
+    }
+    m_available.notify_all();
+
+    // checked out connections are destroyed when their handle returns them
+    for (PooledConnection* connection : idle) {
+        Destroy(connection);
+    }
+}
+
+DatabasePool::Connection DatabasePool::Acquire(std::chrono::milliseconds timeout)
+{
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + timeout;
+    bool waited = false;
+    PooledConnection* connection = nullptr;
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while (!m_closed) {
+            if (!m_idle.empty()) {
+                // most recently used first, it's the least likely to be stale
+                connection = m_idle.back();
+                m_idle.pop_back();
+                break;
+            }
+
+            if (m_total < m_maxConnections) {
+                // grow, the connect happens outside the lock
+                m_total++;
+                lock.unlock();
+                connection = CreateConnection();
+                lock.lock();
+                if (!connection) {
+                    m_total--;
+                    m_available.notify_one();
+                    return Connection();
+                }
+                break;
+            }
+
+            waited = true;
+            if (m_available.wait_until(lock, deadline) == std::cv_status::timeout && m_idle.empty()) {
+                m_timeouts++;
+                logger::error("DatabasePool: timed out waiting for a %s connection (%zu in use)",
+                              m_config.database.c_str(), m_total);
+                return Connection();
+            }
+        }
+    }
+
+    if (!connection) {
+        return Connection(); // closed
+    }
+
+    if (!EnsureHealthy(connection)) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_total--;
+        }
+        m_available.notify_one();
+        Destroy(connection);
+        return Connection();
+    }
+
+    uint64_t waitUs = duration_cast<microseconds>(Clock::now() - start).count();
+    m_acquired++;
+    if (waited) {
+        m_waited++;
+    }
+    m_totalWaitUs += waitUs;
+    uint64_t maxWaitUs = m_maxWaitUs.load();
+    while (waitUs > maxWaitUs && !m_maxWaitUs.compare_exchange_weak(maxWaitUs, waitUs)) {}
+
+    return Connection(this, connection);
+}
+
+void DatabasePool::Return(PooledConnection* connection)
+{
+    // remember lost connections so the next checkout reconnects right away
+    unsigned int error = mysql_errno(connection->mysql);
+    if (error == CR_SERVER_GONE_ERROR || error == CR_SERVER_LOST) {
+        connection->broken = true;
+    }
+    connection->lastUsed = Clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_closed) {
+            m_idle.push_back(connection);
+            connection = nullptr;
+        } else {
+            m_total--;
+        }
+    }
+    m_available.notify_one();
+
+    if (connection) {
+        Destroy(connection);
+    }
+}
+
+void DatabasePool::HealthCheck()
+{
+    std::vector<PooledConnection*> idle;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_closed) {
+            return;
+        }
+        idle.swap(m_idle);
+    }
+
+    // pinged outside the lock, Acquire can still grow the pool meanwhile
+    std::vector<PooledConnection*> healthy;
+    for (PooledConnection* connection : idle) {
+        connection->broken = connection->broken || mysql_ping(connection->mysql) != 0;
+        if (EnsureHealthy(connection)) {
+            connection->lastUsed = Clock::now();
+            healthy.push_back(connection);
+        } else {
+            Destroy(connection);
+        }
+    }
+
+    size_t missing = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_total -= idle.size() - healthy.size();
+        m_idle.insert(m_idle.end(), healthy.begin(), healthy.end());
+        if (m_total < m_minConnections) {
+            missing = m_minConnections - m_total;
+            m_total += missing;
+        }
+    }
+    m_available.notify_all();
+
+    for (size_t i = 0; i < missing; i++) {
+        PooledConnection* connection = CreateConnection();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (connection && !m_closed) {
+            m_idle.push_back(connection);
+            m_available.notify_one();
+        } else {
+            m_total--;
+            if (connection) {
+                Destroy(connection);
+            }
+        }
+    }
+}
+
+DatabasePool::PooledConnection* DatabasePool::CreateConnection()
+{
+    PooledConnection* connection = new PooledConnection();
+    if (!Connect(connection)) {
+        Destroy(connection);
+        return nullptr;
+    }
+    return connection;
+}
+
+bool DatabasePool::Connect(PooledConnection* connection)
+{
+    if (connection->mysql) {
+        DbStatementCache::Forget(connection->mysql);
+        mysql_close(connection->mysql);
+    }
+
+    connection->mysql = mysql_init(NULL);
+    if (connection->mysql == NULL) {
+        logger::error("Failed to initialize MySQL object for %s", m_config.database.c_str());
+        return false;
+    }
+
+    // reconnects are handled here, not by the client library, so a dead
+    // server doesn't block a worker for the default connect timeout
+    unsigned int connectTimeout = 5;
+    mysql_options(connection->mysql, MYSQL_OPT_CONNECT_TIMEOUT, &connectTimeout);
+
+    if (!mysql_real_connect(connection->mysql, m_config.host.c_str(), m_config.user.c_str(),
+                            m_config.password.c_str(), m_config.database.c_str(), m_config.port, NULL, 0)) {
+        logger::error("Failed to connect to %s: %s", m_config.database.c_str(), mysql_error(connection->mysql));
+        return false;
+    }
+
+    if (!m_config.initQuery.empty() && mysql_query(connection->mysql, m_config.initQuery.c_str()) != 0) {
+        logger::error("Failed to initialize connection to %s: %s", m_config.database.c_str(), mysql_error(connection->mysql));
+        return false;
+    }
+
+    connection->broken = false;
+    connection->lastUsed = Clock::now();
+    return true;
+}
+
+void DatabasePool::Destroy(PooledConnection* connection)
+{
+    if (connection->mysql) {
+        DbStatementCache::Forget(connection->mysql);
+        mysql_close(connection->mysql);
+    }
+    delete connection;
+}
+
+bool DatabasePool::EnsureHealthy(PooledConnection* connection)
+{
+    if (!connection->broken && Clock::now() - connection->lastUsed > StaleAfter) {
+        connection->broken = mysql_ping(connection->mysql) != 0;
+    }
+
+    if (!connection->broken) {
+        return true;
+    }
+
+    logger::warning("DatabasePool: reconnecting to %s", m_config.database.c_str());
+    m_reconnects++;
+    return Connect(connection);
+}
+
+void DatabasePool::LogStats() const
+{
+    size_t total, idle;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        total = m_total;
+        idle = m_idle.size();
+    }
+
+    uint64_t acquired = m_acquired.load();
+    logger::info("DatabasePool %s: %zu connections (%zu idle), %llu checkouts, %llu waited, %llu timeouts, "
+                 "avg wait %llu us, max wait %llu us, %llu reconnects",
+                 m_config.database.c_str(), total, idle, acquired, m_waited.load(), m_timeouts.load(),
+                 acquired ? m_totalWaitUs.load() / acquired : 0, m_maxWaitUs.load(), m_reconnects.load());
+}
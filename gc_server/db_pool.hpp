@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <mariadb/mysql.h>
+
+struct DatabaseConfig {
+    std::string host;
+    std::string user;
+    std::string password;
+    std::string database;
+    unsigned int port = 3306;
+    std::string initQuery; // run on every new connection, e.g. to set session variables
+};
+
+// Connection pool for one logical database
+// Connections are checked out through RAII handles and returned on destruction.
+// Stale connections are pinged before reuse and reconnected when the server went away
+class DatabasePool {
+    struct PooledConnection;
+
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // checked out connection, goes back to the pool when destroyed
+    class Connection {
+    public:
+        Connection() = default;
+        Connection(Connection&& other) noexcept;
+        Connection& operator=(Connection&& other) noexcept;
+        Connection(const Connection&) = delete;
+        Connection& operator=(const Connection&) = delete;
+        ~Connection();
+
+        MYSQL* Get() const;
+        operator MYSQL*() const { return Get(); }
+        explicit operator bool() const { return m_connection != nullptr; }
+
+        void Release();
+
+    private:
+        friend class DatabasePool;
+        Connection(DatabasePool* pool, PooledConnection* connection)
+            : m_pool(pool), m_connection(connection) {}
+
+        DatabasePool* m_pool = nullptr;
+        PooledConnection* m_connection = nullptr;
+    };
+
+    DatabasePool(const DatabaseConfig& config, size_t minConnections, size_t maxConnections);
+    ~DatabasePool();
+
+    // opens the minimum number of connections, false if none could be opened
+    bool Open();
+    void Close();
+
+    // empty handle on timeout or when no connection could be made
+    Connection Acquire(std::chrono::milliseconds timeout = std::chrono::seconds(5));
+
+    // pings idle connections, reconnects broken ones and tops the pool up to
+    // its minimum size; meant to be called periodically off the loop thread
+    void HealthCheck();
+
+    const std::string& GetName() const { return m_config.database; }
+    void LogStats() const;
+
+private:
+    struct PooledConnection {
+        MYSQL* mysql = nullptr;
+        Clock::time_point lastUsed;
+        bool broken = false;
+    };
+
+    PooledConnection* CreateConnection();
+    bool Connect(PooledConnection* connection);
+    void Destroy(PooledConnection* connection);
+    bool EnsureHealthy(PooledConnection* connection);
+    void Return(PooledConnection* connection);
+
+    DatabaseConfig m_config;
+    size_t m_minConnections;
+    size_t m_maxConnections;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_available;
+    std::vector<PooledConnection*> m_idle;
+    size_t m_total = 0; // idle + checked out + being created
+    bool m_closed = false;
+
+    // stats
+    std::atomic<uint64_t> m_acquired{0};
+    std::atomic<uint64_t> m_waited{0};
+    std::atomic<uint64_t> m_timeouts{0};
+    std::atomic<uint64_t> m_totalWaitUs{0};
+    std::atomic<uint64_t> m_maxWaitUs{0};
+    std::atomic<uint64_t> m_reconnects{0};
+};
@@ -0,0 +1,179 @@
+#include "stdafx.h"
+#include "db_statements.hpp"
+#include "logger.hpp"
+
+#include <cstring>
+
+std::mutex DbStatementCache::s_mutex;
+std::unordered_map<MYSQL*, DbStatementCache::StatementMap> DbStatementCache::s_statements;
+
+DbStatement::DbStatement(MYSQL_STMT* stmt)
+    : m_stmt(stmt)
+{
+    // sized once, the binds point into m_params
+    unsigned long count = mysql_stmt_param_count(m_stmt);
+    m_binds.resize(count);
+    m_params.resize(count);
+    memset(m_binds.data(), 0, m_binds.size() * sizeof(MYSQL_BIND));
+}
+
+DbStatement::~DbStatement()
+{
+    mysql_stmt_close(m_stmt);
+}
+
+void DbStatement::BindUInt64(unsigned int index, uint64_t value)
+{
+    if (index >= m_params.size()) {
+        logger::error("DbStatement: parameter %u out of range", index);
+        return;
+    }
+
+    m_params[index].integer = value;
+
+    MYSQL_BIND& bind = m_binds[index];
+    bind.buffer_type = MYSQL_TYPE_LONGLONG;
+    bind.buffer = &m_params[index].integer;
+    bind.is_unsigned = 1;
+    bind.length = nullptr;
+}
+
+void DbStatement::BindString(unsigned int index, std::string_view value)
+{
+    if (index >= m_params.size()) {
+        logger::error("DbStatement: parameter %u out of range", index);
+        return;
+    }
+
+    Param& param = m_params[index];
+    param.text.assign(value.data(), value.size());
+    param.length = static_cast<unsigned long>(param.text.size());
+
+    MYSQL_BIND& bind = m_binds[index];
+    bind.buffer_type = MYSQL_TYPE_STRING;
+    bind.buffer = param.text.data();
+    bind.buffer_length = param.length;
+    bind.length = &param.length;
+}
+
+bool DbStatement::Execute()
+{
+    FreeResult();
+
+    if (!m_binds.empty() && mysql_stmt_bind_param(m_stmt, m_binds.data()) != 0) {
+        logger::error("DbStatement: failed to bind parameters: %s", mysql_stmt_error(m_stmt));
+        return false;
+    }
+
+    if (mysql_stmt_execute(m_stmt) != 0) {
+        logger::error("DbStatement: execute failed: %s", mysql_stmt_error(m_stmt));
+        return false;
+    }
+
+    if (mysql_stmt_field_count(m_stmt) > 0) {
+        if (mysql_stmt_store_result(m_stmt) != 0) {
+            logger::error("DbStatement: failed to store result: %s", mysql_stmt_error(m_stmt));
+            return false;
+        }
+        m_hasResult = true;
+    }
+
+    return true;
+}
+
+bool DbStatement::BindResult(MYSQL_BIND* columns)
+{
+    if (mysql_stmt_bind_result(m_stmt, columns) != 0) {
+        logger::error("DbStatement: failed to bind result: %s", mysql_stmt_error(m_stmt));
+        return false;
+    }
+    return true;
+}
+
+bool DbStatement::Fetch()
+{
+    if (!m_hasResult) {
+        return false;
+    }
+
+    int status = mysql_stmt_fetch(m_stmt);
+    if (status == 0 || status == MYSQL_DATA_TRUNCATED) {
+        // truncated strings are clamped by the caller using the column length
+        return true;
+    }
+
+    if (status != MYSQL_NO_DATA) {
+        logger::error("DbStatement: fetch failed: %s", mysql_stmt_error(m_stmt));
+    }
+    return false;
+}
+
+void DbStatement::FreeResult()
+{
+    if (m_hasResult) {
+        mysql_stmt_free_result(m_stmt);
+        m_hasResult = false;
+    }
+}
+
+uint64_t DbStatement::AffectedRows() const
+{
+    return mysql_stmt_affected_rows(m_stmt);
+}
+
+const char* DbStatement::Error() const
+{
+    return mysql_stmt_error(m_stmt);
+}
+
+DbStatement* DbStatementCache::Get(MYSQL* mysql, const char* sql)
+{
+    if (!mysql) {
+        return nullptr;
+    }
+
+    // a connection is only used by one thread at a time, the lock just
+    // protects the maps themselves
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        StatementMap& statements = s_statements[mysql];
+        auto it = statements.find(sql);
+        if (it != statements.end()) {
+            return it->second.get();
+        }
+    }
+
+    MYSQL_STMT* stmt = mysql_stmt_init(mysql);
+    if (!stmt) {
+        logger::error("DbStatementCache: mysql_stmt_init failed: %s", mysql_error(mysql));
+        return nullptr;
+    }
+
+    if (mysql_stmt_prepare(stmt, sql, static_cast<unsigned long>(strlen(sql))) != 0) {
+        logger::error("DbStatementCache: failed to prepare \"%s\": %s", sql, mysql_stmt_error(stmt));
+        mysql_stmt_close(stmt);
+        return nullptr;
+    }
+
+    auto statement = std::make_unique<DbStatement>(stmt);
+    DbStatement* result = statement.get();
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_statements[mysql][sql] = std::move(statement);
+    return result;
+}
+
+void DbStatementCache::Forget(MYSQL* mysql)
+{
+    StatementMap statements;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto it = s_statements.find(mysql);
+        if (it == s_statements.end()) {
+            return;
+        }
+        statements.swap(it->second);
+        s_statements.erase(it);
+    }
+    // statements are closed here, before the connection itself goes away
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <mariadb/mysql.h>
+
+// One server side prepared statement with typed parameters
+// Parameter values are copied into the statement, results are bound by the caller
+// and filled by the binary protocol, so nothing is formatted or parsed as text
+class DbStatement {
+public:
+    explicit DbStatement(MYSQL_STMT* stmt);
+    ~DbStatement();
+
+    DbStatement(const DbStatement&) = delete;
+    DbStatement& operator=(const DbStatement&) = delete;
+
+    void BindUInt64(unsigned int index, uint64_t value);
+    void BindString(unsigned int index, std::string_view value);
+
+    // runs the statement and buffers its result set client side, so other
+    // queries can run on the same connection while rows are fetched
+    bool Execute();
+
+    // columns must stay valid until the result is freed
+    bool BindResult(MYSQL_BIND* columns);
+
+    // false when there are no more rows (or on error)
+    bool Fetch();
+    void FreeResult();
+
+    uint64_t AffectedRows() const;
+    const char* Error() const;
+
+private:
+    struct Param {
+        uint64_t integer = 0;
+        std::string text;
+        unsigned long length = 0;
+    };
+
+    MYSQL_STMT* m_stmt;
+    std::vector<MYSQL_BIND> m_binds;
+    std::vector<Param> m_params;
+    bool m_hasResult = false;
+};
+
+// Prepared statements cached per connection
+// Each SQL string is prepared once on every connection that runs it; the pool
+// forgets a connection's statements when it is reconnected or closed
+class DbStatementCache {
+public:
+    // sql must have static storage duration (a string literal), it is used as the key;
+    // nullptr if the statement couldn't be prepared
+    static DbStatement* Get(MYSQL* mysql, const char* sql);
+
+    static void Forget(MYSQL* mysql);
+
+private:
+    using StatementMap = std::unordered_map<std::string_view, std::unique_ptr<DbStatement>>;
+
+    static std::mutex s_mutex;
+    static std::unordered_map<MYSQL*, StatementMap> s_statements;
+};
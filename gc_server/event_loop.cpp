@@ -0,0 +1,65 @@
+#include "stdafx.h"
+#include "event_loop.hpp"
+
+EventLoop* EventLoop::GetInstance()
+{
+    static EventLoop instance;
+    return &instance;
+}
+
+void EventLoop::Attach()
+{
+    m_loopThread = std::this_thread::get_id();
+}
+
+bool EventLoop::IsLoopThread() const
+{
+    return std::this_thread::get_id() == m_loopThread;
+}
+
+void EventLoop::Post(Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+        m_woken = true;
+    }
+    m_wakeup.notify_one();
+}
+
+void EventLoop::Wake()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_woken = true;
+    }
+    m_wakeup.notify_one();
+}
+
+void EventLoop::Stop()
+{
+    // only touches the atomic so it can be called from a signal handler
+    m_stopping.store(true, std::memory_order_relaxed);
+}
+
+size_t EventLoop::RunPending()
+{
+    std::deque<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        tasks.swap(m_tasks);
+    }
+
+    for (auto& task : tasks) {
+        task();
+    }
+    return tasks.size();
+}
+
+bool EventLoop::WaitUntil(Clock::time_point deadline)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    bool woken = m_wakeup.wait_until(lock, deadline, [this] { return m_woken || IsStopping(); });
+    m_woken = false;
+    return woken;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Main GC loop primitives
+// ISteamGameServerNetworking exposes no pollable descriptor, so inbound data is
+// detected by draining IsDataAvailable; between drains the loop thread sleeps on
+// a condition variable until the next deadline or until another thread posts work
+class EventLoop {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Task = std::function<void()>;
+
+    static EventLoop* GetInstance();
+
+    // binds the loop to the calling thread
+    void Attach();
+    bool IsLoopThread() const;
+
+    // thread safe, wakes the loop thread
+    void Post(Task task);
+    void Wake();
+
+    // async-signal-safe, the loop notices on its next wakeup
+    void Stop();
+    bool IsStopping() const { return m_stopping.load(std::memory_order_relaxed); }
+
+    // runs tasks posted so far, returns how many ran
+    size_t RunPending();
+
+    // sleeps until deadline or until woken, returns true if woken early
+    bool WaitUntil(Clock::time_point deadline);
+
+private:
+    EventLoop() = default;
+
+    std::thread::id m_loopThread;
+    std::atomic<bool> m_stopping{false};
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::deque<Task> m_tasks;
+    bool m_woken = false;
+};
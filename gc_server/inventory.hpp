@@ -11,6 +11,8 @@
 class KeyValue;
 
 using ItemMap = std::unordered_map<uint64_t, CSOEconItem>;
+// csgo_items.row_version of each item, see ItemBlobCache
+using ItemVersions = std::unordered_map<uint64_t, uint32_t>;
 
 class Inventory
 {
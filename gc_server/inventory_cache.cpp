@@ -0,0 +1,167 @@
+#include "stdafx.h"
+#include "inventory_cache.hpp"
+#include "item_blob_cache.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+
+InventoryCache* InventoryCache::GetInstance()
+{
+    static InventoryCache instance;
+    return &instance;
+}
+
+void InventoryCache::Admit(uint64_t steamId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_admitted.insert(steamId);
+}
+
+bool InventoryCache::Set(uint64_t steamId, ItemMap items, ItemVersions versions)
+{
+    auto entry = std::make_shared<Entry>();
+    for (const auto& pair : items) {
+        entry->nextPosition = std::max(entry->nextPosition, pair.second.inventory() + 1);
+    }
+    entry->items = std::move(items);
+    entry->versions = std::move(versions);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_admitted.count(steamId)) {
+        return false;
+    }
+    m_entries[steamId] = std::move(entry);
+    return true;
+}
+
+void InventoryCache::Drop(uint64_t steamId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_admitted.erase(steamId);
+    m_entries.erase(steamId);
+}
+
+bool InventoryCache::IsLoaded(uint64_t steamId) const
+{
+    return Find(steamId) != nullptr;
+}
+
+bool InventoryCache::GetItem(uint64_t steamId, uint64_t itemId, CSOEconItem& item)
+{
+    std::shared_ptr<Entry> entry = Find(steamId);
+    if (entry) {
+        std::lock_guard<std::mutex> lock(entry->mutex);
+        auto it = entry->items.find(itemId);
+        if (it != entry->items.end()) {
+            item = it->second;
+            m_hits++;
+            return true;
+        }
+    }
+
+    m_misses++;
+    return false;
+}
+
+bool InventoryCache::ForEachItem(uint64_t steamId, const std::function<void(const CSOEconItem&)>& visit)
+{
+    std::shared_ptr<Entry> entry = Find(steamId);
+    if (!entry) {
+        m_misses++;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    for (const auto& pair : entry->items) {
+        visit(pair.second);
+    }
+
+    m_hits++;
+    return true;
+}
+
+bool InventoryCache::WithItems(uint64_t steamId, const std::function<void(const ItemMap&, const ItemVersions&)>& visit)
+{
+    std::shared_ptr<Entry> entry = Find(steamId);
+    if (!entry) {
+        m_misses++;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    visit(entry->items, entry->versions);
+
+    m_hits++;
+    return true;
+}
+
+void InventoryCache::Store(uint64_t steamId, const CSOEconItem& item, uint32_t version)
+{
+    std::shared_ptr<Entry> entry = Find(steamId);
+    if (!entry) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    entry->items[item.id()] = item;
+
+    auto known = entry->versions.find(item.id());
+    if (known != entry->versions.end() && known->second != version) {
+        ItemBlobCache::GetInstance()->Invalidate(item.id());
+    }
+    entry->versions[item.id()] = version;
+
+    // rows placed outside the GC (item feed, other writers) move the mark too
+    entry->nextPosition = std::max(entry->nextPosition, item.inventory() + 1);
+    m_writes++;
+}
+
+void InventoryCache::Remove(uint64_t steamId, uint64_t itemId)
+{
+    std::shared_ptr<Entry> entry = Find(steamId);
+    if (!entry) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    entry->items.erase(itemId);
+    entry->versions.erase(itemId);
+    ItemBlobCache::GetInstance()->Invalidate(itemId);
+    m_writes++;
+}
+
+bool InventoryCache::ReservePositions(uint64_t steamId, uint32_t count, uint32_t& firstPosition)
+{
+    std::shared_ptr<Entry> entry = Find(steamId);
+    if (!entry) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    firstPosition = entry->nextPosition;
+    entry->nextPosition += count;
+    m_positions += count;
+    return true;
+}
+
+std::shared_ptr<InventoryCache::Entry> InventoryCache::Find(uint64_t steamId) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(steamId);
+    return it != m_entries.end() ? it->second : nullptr;
+}
+
+void InventoryCache::LogStats() const
+{
+    size_t players;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        players = m_entries.size();
+    }
+
+    uint64_t hits = m_hits.load();
+    uint64_t misses = m_misses.load();
+    logger::info("InventoryCache: %zu players, %llu hits, %llu misses (%.1f%% hit rate), %llu writes, %llu positions",
+                 players, hits, misses, hits + misses ? 100.0 * hits / (hits + misses) : 0.0, m_writes.load(),
+                 m_positions.load());
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "inventory.hpp" // ItemMap, ItemVersions
+
+// Items of online players kept in memory
+// Filled at login, SOCache and item lookups are served from here instead of csgo_items.
+// Handlers write to MySQL first and then store the row they read back (write-through),
+// changes made outside the GC arrive through the item feed. The polling fallback only
+// sees new items, without the outbox outside updates and deletes aren't picked up
+// until the next login. Thread safe, every player
+// has their own lock so workers on different strands don't contend.
+// Also hands out inventory positions: the high-water mark is seeded from the items
+// at login and advanced in memory, the position is persisted with the row it's given to
+class InventoryCache {
+public:
+    static InventoryCache* GetInstance();
+
+    // marks the player online, from the loop thread when the session is created.
+    // Set is ignored for anyone else, so a load that finishes after the session
+    // expired (and was dropped) doesn't leave an entry behind
+    void Admit(uint64_t steamId);
+    // replaces whatever was cached for the player, false when they aren't admitted
+    bool Set(uint64_t steamId, ItemMap items, ItemVersions versions);
+    void Drop(uint64_t steamId);
+    bool IsLoaded(uint64_t steamId) const;
+
+    // false when the player isn't cached or doesn't own the item
+    bool GetItem(uint64_t steamId, uint64_t itemId, CSOEconItem& item);
+
+    // visits every item under the player's lock, false when the player isn't cached
+    bool ForEachItem(uint64_t steamId, const std::function<void(const CSOEconItem&)>& visit);
+    // hands out the whole map under the player's lock, for visitors that need every
+    // item at once (two-pass encoding), false when the player isn't cached
+    bool WithItems(uint64_t steamId, const std::function<void(const ItemMap&, const ItemVersions&)>& visit);
+
+    // no-ops for players that aren't cached, version is the row's row_version.
+    // Both drop the item's serialized bytes from ItemBlobCache once it changed
+    void Store(uint64_t steamId, const CSOEconItem& item, uint32_t version);
+    void Remove(uint64_t steamId, uint64_t itemId);
+
+    // reserves count consecutive positions, false when the player isn't cached.
+    // A reservation that's never written just leaves a gap
+    bool ReservePositions(uint64_t steamId, uint32_t count, uint32_t& firstPosition);
+
+    void LogStats() const;
+
+private:
+    struct Entry {
+        std::mutex mutex;
+        ItemMap items;
+        ItemVersions versions;
+        uint32_t nextPosition = FirstPosition;
+    };
+
+    // position 1 is reserved for the nametag
+    static constexpr uint32_t FirstPosition = 2;
+
+    std::shared_ptr<Entry> Find(uint64_t steamId) const;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint64_t, std::shared_ptr<Entry>> m_entries;
+    std::unordered_set<uint64_t> m_admitted;
+
+    // stats
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+    std::atomic<uint64_t> m_writes{0};
+    std::atomic<uint64_t> m_positions{0};
+};
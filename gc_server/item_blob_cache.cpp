@@ -0,0 +1,89 @@
+#include "stdafx.h"
+#include "item_blob_cache.hpp"
+#include "logger.hpp"
+
+ItemBlobCache* ItemBlobCache::GetInstance()
+{
+    static ItemBlobCache instance;
+    return &instance;
+}
+
+ItemBlobCache::Blob ItemBlobCache::Get(uint64_t itemId, uint32_t version)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_index.find(itemId);
+    if (it == m_index.end()) {
+        m_misses++;
+        return nullptr;
+    }
+
+    if (it->second->version != version) {
+        Erase(it);
+        m_stale++;
+        m_misses++;
+        return nullptr;
+    }
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    m_hits++;
+    return it->second->blob;
+}
+
+ItemBlobCache::Blob ItemBlobCache::Put(uint64_t itemId, uint32_t version, const CSOEconItem& item)
+{
+    // serialized outside the lock, only the list update is shared
+    Blob blob = std::make_shared<const std::string>(item.SerializeAsString());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_index.find(itemId);
+    if (it != m_index.end()) {
+        Erase(it);
+    }
+
+    m_entries.push_front({itemId, version, blob});
+    m_index[itemId] = m_entries.begin();
+    m_bytes += blob->size();
+
+    while (m_bytes > CapacityBytes && !m_entries.empty()) {
+        Erase(m_index.find(m_entries.back().itemId));
+        m_evictions++;
+    }
+
+    return blob;
+}
+
+void ItemBlobCache::Invalidate(uint64_t itemId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_index.find(itemId);
+    if (it != m_index.end()) {
+        Erase(it);
+        m_invalidations++;
+    }
+}
+
+void ItemBlobCache::Erase(std::unordered_map<uint64_t, std::list<Entry>::iterator>::iterator it)
+{
+    m_bytes -= it->second->blob->size();
+    m_entries.erase(it->second);
+    m_index.erase(it);
+}
+
+void ItemBlobCache::LogStats() const
+{
+    size_t entries, bytes;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        entries = m_entries.size();
+        bytes = m_bytes;
+    }
+
+    uint64_t hits = m_hits.load();
+    uint64_t misses = m_misses.load();
+    logger::info("ItemBlobCache: %zu items in %zu bytes, %llu hits, %llu misses (%.1f%% hit rate), %llu stale, %llu evicted, %llu invalidated",
+                 entries, bytes, hits, misses, hits + misses ? 100.0 * hits / (hits + misses) : 0.0,
+                 m_stale.load(), m_evictions.load(), m_invalidations.load());
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "base_gcmessages.pb.h"
+
+// Serialized CSOEconItem bytes, keyed by item id and csgo_items.row_version
+// Every UPDATE of a row bumps its version (trigger), so bytes of an older version
+// are never handed out; writes through InventoryCache also drop them right away.
+// Process wide and independent of sessions, a player reconnecting gets their
+// SOCache assembled from these instead of serializing every item again.
+// Bounded LRU by payload bytes. Thread safe
+class ItemBlobCache {
+public:
+    using Blob = std::shared_ptr<const std::string>;
+
+    static ItemBlobCache* GetInstance();
+
+    // nullptr on a miss or when the cached bytes are of another version
+    Blob Get(uint64_t itemId, uint32_t version);
+
+    // serializes the item and keeps the bytes, returns them either way
+    Blob Put(uint64_t itemId, uint32_t version, const CSOEconItem& item);
+
+    void Invalidate(uint64_t itemId);
+
+    void LogStats() const;
+
+private:
+    static constexpr size_t CapacityBytes = 32 * 1024 * 1024;
+
+    struct Entry {
+        uint64_t itemId;
+        uint32_t version;
+        Blob blob;
+    };
+
+    void Erase(std::unordered_map<uint64_t, std::list<Entry>::iterator>::iterator it);
+
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_entries; // most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> m_index;
+    size_t m_bytes = 0;
+
+    // stats
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+    std::atomic<uint64_t> m_stale{0};
+    std::atomic<uint64_t> m_evictions{0};
+    std::atomic<uint64_t> m_invalidations{0};
+};
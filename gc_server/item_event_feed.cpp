@@ -0,0 +1,170 @@
+#include "stdafx.h"
+#include "item_event_feed.hpp"
+#include "db_statements.hpp"
+#include "logger.hpp"
+
+#include <cstring>
+
+// how long a hole in the event ids is waited on before it's skipped
+constexpr std::chrono::seconds GapTimeout{2};
+constexpr uint64_t ReadBatchSize = 1000;
+
+static constexpr char SqlLastEventId[] =
+    "SELECT COALESCE(MAX(event_id), 0), @@auto_increment_increment FROM csgo_item_events";
+
+static constexpr char SqlReadEvents[] =
+    "SELECT event_id, item_id, owner_account_id, action, external "
+    "FROM csgo_item_events WHERE event_id > ? ORDER BY event_id ASC LIMIT ?";
+
+static constexpr char SqlPruneEvents[] =
+    "DELETE FROM csgo_item_events WHERE created_at < NOW() - INTERVAL 1 DAY";
+
+bool ItemEventFeed::Start(MYSQL* mysql)
+{
+    DbStatement* stmt = DbStatementCache::Get(mysql, SqlLastEventId);
+    if (!stmt || !stmt->Execute()) {
+        return false;
+    }
+
+    uint64_t lastEventId = 0, idStep = 1;
+    MYSQL_BIND columns[2];
+    memset(columns, 0, sizeof(columns));
+    columns[0].buffer_type = MYSQL_TYPE_LONGLONG;
+    columns[0].buffer = &lastEventId;
+    columns[0].is_unsigned = 1;
+    columns[1].buffer_type = MYSQL_TYPE_LONGLONG;
+    columns[1].buffer = &idStep;
+    columns[1].is_unsigned = 1;
+
+    bool found = stmt->BindResult(columns) && stmt->Fetch();
+    stmt->FreeResult();
+    if (!found) {
+        return false;
+    }
+
+    m_lastEventId = lastEventId;
+    m_idStep = std::max<uint64_t>(idStep, 1);
+    m_started = true;
+    logger::info("ItemEventFeed: tailing csgo_item_events from event %llu", m_lastEventId);
+    return true;
+}
+
+// one batch of events after the given id, in event order
+static bool ReadBatch(MYSQL* mysql, uint64_t after, std::vector<ItemEvent>& events)
+{
+    DbStatement* stmt = DbStatementCache::Get(mysql, SqlReadEvents);
+    if (!stmt) {
+        return false;
+    }
+
+    stmt->BindUInt64(0, after);
+    stmt->BindUInt64(1, ReadBatchSize);
+    if (!stmt->Execute()) {
+        return false;
+    }
+
+    uint64_t eventId = 0, itemId = 0;
+    uint32_t owner = 0;
+    my_bool ownerNull = 0;
+    uint8_t action = 0, external = 0;
+
+    MYSQL_BIND columns[5];
+    memset(columns, 0, sizeof(columns));
+    columns[0].buffer_type = MYSQL_TYPE_LONGLONG;
+    columns[0].buffer = &eventId;
+    columns[0].is_unsigned = 1;
+    columns[1].buffer_type = MYSQL_TYPE_LONGLONG;
+    columns[1].buffer = &itemId;
+    columns[1].is_unsigned = 1;
+    columns[2].buffer_type = MYSQL_TYPE_LONG;
+    columns[2].buffer = &owner;
+    columns[2].is_unsigned = 1;
+    columns[2].is_null = &ownerNull;
+    columns[3].buffer_type = MYSQL_TYPE_TINY;
+    columns[3].buffer = &action;
+    columns[3].is_unsigned = 1;
+    columns[4].buffer_type = MYSQL_TYPE_TINY;
+    columns[4].buffer = &external;
+    columns[4].is_unsigned = 1;
+
+    if (!stmt->BindResult(columns)) {
+        stmt->FreeResult();
+        return false;
+    }
+
+    while (stmt->Fetch()) {
+        ItemEvent& event = events.emplace_back();
+        event.eventId = eventId;
+        event.itemId = itemId;
+        event.ownerAccountId = ownerNull ? 0 : owner;
+        event.action = static_cast<ItemEventAction>(action);
+        event.external = external != 0;
+    }
+
+    stmt->FreeResult();
+    return true;
+}
+
+bool ItemEventFeed::Read(MYSQL* mysql, std::vector<ItemEvent>& events)
+{
+    std::vector<ItemEvent> batch;
+    if (!ReadBatch(mysql, m_lastEventId, batch)) {
+        return false;
+    }
+
+    for (const ItemEvent& event : batch) {
+        if (event.eventId != m_lastEventId + m_idStep) {
+            // a hole, give the transaction that owns it a moment to commit
+            Clock::time_point now = Clock::now();
+            if (m_gapAt != m_lastEventId) {
+                m_gapAt = m_lastEventId;
+                m_gapSince = now;
+            }
+            if (now - m_gapSince < GapTimeout) {
+                break;
+            }
+            logger::warning("ItemEventFeed: skipping missing events %llu-%llu", m_lastEventId + m_idStep, event.eventId - 1);
+        }
+
+        events.push_back(event);
+        m_lastEventId = event.eventId;
+    }
+    return true;
+}
+
+bool ItemEventFeed::ReadRange(MYSQL* mysql, uint64_t after, uint64_t until, std::vector<ItemEvent>& events) const
+{
+    // the tail already moved past these, holes in the range were waited on back then
+    while (after < until) {
+        std::vector<ItemEvent> batch;
+        if (!ReadBatch(mysql, after, batch)) {
+            return false;
+        }
+
+        for (const ItemEvent& event : batch) {
+            if (event.eventId > until) {
+                return true;
+            }
+            events.push_back(event);
+            after = event.eventId;
+        }
+
+        if (batch.size() < ReadBatchSize) {
+            break;
+        }
+    }
+    return true;
+}
+
+void ItemEventFeed::Prune(MYSQL* mysql)
+{
+    DbStatement* stmt = DbStatementCache::Get(mysql, SqlPruneEvents);
+    if (!stmt || !stmt->Execute()) {
+        return;
+    }
+
+    uint64_t pruned = stmt->AffectedRows();
+    if (pruned > 0) {
+        logger::info("ItemEventFeed: pruned %llu old events", pruned);
+    }
+}
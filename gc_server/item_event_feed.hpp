@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <mariadb/mysql.h>
+#include "steam/steam_api.h"
+
+enum class ItemEventAction : uint8_t {
+    Insert = 1,
+    Update = 2,
+    Delete = 3,
+};
+
+struct ItemEvent {
+    uint64_t eventId;
+    uint64_t itemId;
+    uint32_t ownerAccountId; // the previous owner for deletes, 0 when there is none
+    ItemEventAction action;
+    bool external; // written by something other than the GC (website, trades, drops)
+};
+
+// an online session that new and changed items are routed to
+struct ItemWatch {
+    uint64_t steamId;
+    SNetSocket_t socket;
+    uint64_t lastItemId; // advanced past every item found for this player
+    bool notified = false;
+};
+
+// Change feed for csgo_items
+// Triggers on csgo_items append to the csgo_item_events outbox (see SchemaMigrations),
+// the GC tails it by event id. Connections of the GC set @gc_writer so its own writes
+// can be told apart. Not thread safe, meant to be driven from a single strand
+class ItemEventFeed {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // starts tailing from the current end of the outbox
+    bool Start(MYSQL* mysql);
+    bool IsStarted() const { return m_started; }
+
+    // appends events after the last one read, returns false on query errors
+    bool Read(MYSQL* mysql, std::vector<ItemEvent>& events);
+    // appends events in (after, until] again without moving the tail, for
+    // a session that wasn't being watched when they were first read
+    bool ReadRange(MYSQL* mysql, uint64_t after, uint64_t until, std::vector<ItemEvent>& events) const;
+
+    // drops events older than a day
+    void Prune(MYSQL* mysql);
+
+    uint64_t GetLastEventId() const { return m_lastEventId; }
+
+private:
+    uint64_t m_lastEventId = 0;
+    uint64_t m_idStep = 1; // auto_increment_increment, more than 1 on some clusters
+    bool m_started = false;
+
+    // event ids are handed out at insert but become visible at commit, so a
+    // hole may still be filled by a transaction in flight; wait a little for it
+    uint64_t m_gapAt = 0;
+    Clock::time_point m_gapSince;
+};
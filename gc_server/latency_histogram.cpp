@@ -0,0 +1,55 @@
+#include "stdafx.h"
+#include "latency_histogram.hpp"
+#include "logger.hpp"
+
+void LatencyHistogram::Record(Clock::duration duration)
+{
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+
+    // bucket n holds [2^(n-1), 2^n) microseconds, bucket 0 anything under 1us
+    size_t bucket = 0;
+    while (bucket < BucketCount - 1 && (us >> bucket) != 0) {
+        bucket++;
+    }
+
+    m_buckets[bucket]++;
+    m_count++;
+    m_totalUs += us;
+
+    uint64_t max = m_maxUs.load();
+    while (us > max && !m_maxUs.compare_exchange_weak(max, us)) {
+    }
+}
+
+std::chrono::microseconds LatencyHistogram::Percentile(double fraction) const
+{
+    uint64_t count = m_count.load();
+    if (count == 0) {
+        return std::chrono::microseconds(0);
+    }
+
+    uint64_t target = static_cast<uint64_t>(fraction * count);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BucketCount; bucket++) {
+        seen += m_buckets[bucket].load();
+        if (seen > target) {
+            return std::chrono::microseconds(bucket == 0 ? 1 : uint64_t(1) << bucket);
+        }
+    }
+    return std::chrono::microseconds(m_maxUs.load());
+}
+
+void LatencyHistogram::Log(const char* name) const
+{
+    uint64_t count = m_count.load();
+    if (count == 0) {
+        return;
+    }
+
+    logger::info("%s: %llu samples, avg %lluus, p50 <%lldus, p90 <%lldus, p99 <%lldus, max %lluus",
+                 name, count, m_totalUs.load() / count,
+                 static_cast<long long>(Percentile(0.5).count()),
+                 static_cast<long long>(Percentile(0.9).count()),
+                 static_cast<long long>(Percentile(0.99).count()),
+                 m_maxUs.load());
+}
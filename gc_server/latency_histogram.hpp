@@ -0,0 +1,31 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Lock-free latency distribution with power of two microsecond buckets
+// Cheap enough to record on every request, percentiles are accurate to a factor
+// of two which is plenty to spot a p99 regression
+class LatencyHistogram {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void Record(Clock::duration duration);
+
+    uint64_t Count() const { return m_count.load(); }
+    // upper bound of the bucket holding the given fraction of samples (0.5, 0.99)
+    std::chrono::microseconds Percentile(double fraction) const;
+
+    // "<name>: n, avg, p50, p90, p99, max"
+    void Log(const char* name) const;
+
+private:
+    static constexpr size_t BucketCount = 32;
+
+    std::array<std::atomic<uint64_t>, BucketCount> m_buckets{};
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<uint64_t> m_totalUs{0};
+    std::atomic<uint64_t> m_maxUs{0};
+};
@@ -4,9 +4,13 @@
 #include <ctime>
 #include <sys/stat.h>
 #include <string>
+#include <mutex>
 
 namespace logger {
     bool colors_disabled = false;
+
+    // handlers log from worker threads, keep lines and files from interleaving
+    static std::mutex log_mutex;
     
     void disable_colors() {
         colors_disabled = true;
@@ -22,7 +26,7 @@ namespace logger {
     }
     
     const char* get_time_str() {
-        static char time_str[9];
+        static thread_local char time_str[9];
         time_t now = time(nullptr);
         struct tm* tm_info = localtime(&now);
         strftime(time_str, sizeof(time_str), "%H:%M:%S", tm_info);
@@ -54,6 +58,7 @@ namespace logger {
         vsnprintf(buffer, sizeof(buffer), format, ap);
         va_end(ap);
         
+        std::lock_guard<std::mutex> lock(log_mutex);
         mkdir_logs();
         
         // terminal output
@@ -78,6 +83,7 @@ namespace logger {
         vsnprintf(buffer, sizeof(buffer), format, ap);
         va_end(ap);
         
+        std::lock_guard<std::mutex> lock(log_mutex);
         mkdir_logs();
         
         // terminal output
@@ -109,6 +115,7 @@ namespace logger {
         vsnprintf(buffer, sizeof(buffer), format, ap);
         va_end(ap);
         
+        std::lock_guard<std::mutex> lock(log_mutex);
         mkdir_logs();
         
         // terminal output
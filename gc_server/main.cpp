@@ -1,7 +1,11 @@
 #include "stdafx.h"
 #include "main.hpp"
 #include "platform.hpp"
+#include "event_loop.hpp"
 
+#include <algorithm>
+#include <csignal>
+#include <thread>
 #include <dlfcn.h>
 #define STEAM_API_EXPORTS
 #include <steam/steam_gameserver.h>
@@ -19,8 +23,33 @@ uint16 get_game_port() {
     return env_port ? (uint16)atoi(env_port) : 27016;
 }
 
+// Event loop timing - GC_CALLBACK_INTERVAL_MS and GC_POLL_INTERVAL_MS
+std::chrono::milliseconds get_env_ms(const char* name, int fallback) {
+    const char* env_value = getenv(name);
+    int value = env_value ? atoi(env_value) : fallback;
+    return std::chrono::milliseconds(value > 0 ? value : fallback);
+}
+
 const char* BIND_IP = get_bind_ip();
 const uint16 GAME_PORT = get_game_port();
+const std::chrono::milliseconds CALLBACK_INTERVAL = get_env_ms("GC_CALLBACK_INTERVAL_MS", 10);
+const std::chrono::milliseconds POLL_INTERVAL = get_env_ms("GC_POLL_INTERVAL_MS", 1);
+
+// Worker threads for database-bound handlers - GC_WORKER_THREADS
+size_t get_worker_threads() {
+    const char* env_threads = getenv("GC_WORKER_THREADS");
+    if (env_threads && atoi(env_threads) > 0) {
+        return (size_t)atoi(env_threads);
+    }
+    unsigned int cores = std::thread::hardware_concurrency();
+    return std::clamp<size_t>(cores, 2, 8);
+}
+
+const size_t WORKER_THREADS = get_worker_threads();
+
+void handle_shutdown_signal(int) {
+    EventLoop::GetInstance()->Stop();
+}
 
 // Convert IP string to uint32 in host byte order
 uint32 ip_string_to_uint32(const char* ip_str) {
@@ -38,7 +67,7 @@ uint32 ip_string_to_uint32(const char* ip_str) {
     return 0;
 }
 
-int main() {
+int main(int argc, char** argv) {
 #ifdef _WIN32
     if (!platform::win32_enable_vt_mode()) {
         printf("Couldn't enable virtual terminal mode! Continuing with colors disabled!");
@@ -54,6 +83,11 @@ int main() {
     setenv("SteamAppId", "730", 0);
 #endif
 
+    // maintenance commands, run without Steam
+    if (argc > 1 && strcmp(argv[1], "--rebuild-counters") == 0) {
+        return GCNetwork::RebuildCounters() ? 0 : 1;
+    }
+
     uint32 bind_ip = ip_string_to_uint32(BIND_IP);
     
     logger::info("Initializing Steam Game Server on %s:%d", BIND_IP, GAME_PORT);
@@ -74,9 +108,12 @@ int main() {
         (publicIP.m_unIPv4 >> 8) & 0xFF,
         publicIP.m_unIPv4 & 0xFF);
 
-    m_network.Init(BIND_IP, GAME_PORT);
-	while (true) {
-        m_network.Update();
-	}
-	return 1;
+    signal(SIGINT, handle_shutdown_signal);
+    signal(SIGTERM, handle_shutdown_signal);
+
+    m_network.Init(BIND_IP, GAME_PORT, WORKER_THREADS);
+    m_network.Run(CALLBACK_INTERVAL, POLL_INTERVAL);
+
+    logger::info("Shutting down");
+    return 0;
 }
\ No newline at end of file
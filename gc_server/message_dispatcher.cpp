@@ -0,0 +1,123 @@
+#include "stdafx.h"
+#include "message_dispatcher.hpp"
+#include "steam_network_message.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+MessageDispatcher::Entry& MessageDispatcher::AddEntry(uint32_t type, const char* name, bool requiresSession)
+{
+    if (m_entries.count(type)) {
+        logger::warning("MessageDispatcher: handler for %s (%u) registered twice, replacing", name, type);
+    }
+
+    Entry& entry = m_entries[type];
+    entry = Entry();
+    entry.name = name;
+    entry.requiresSession = requiresSession;
+    return entry;
+}
+
+void MessageDispatcher::RegisterRaw(uint32_t type, const char* name, bool requiresSession, RawHandler handler)
+{
+    Entry& entry = AddEntry(type, name, requiresSession);
+    entry.rawInvoke = std::move(handler);
+}
+
+bool MessageDispatcher::Dispatch(const MessageContext& context)
+{
+    auto it = m_entries.find(context.type);
+    if (it == m_entries.end()) {
+        m_unknown.count++;
+        m_unknown.bytes += context.size;
+        logger::error("Unknown message type: %u", context.type);
+        return false;
+    }
+
+    Entry& entry = it->second;
+    entry.stats.count++;
+    entry.stats.bytes += context.size;
+
+    logger::info("Received %s", entry.name.c_str());
+
+    if (entry.requiresSession && context.steamId == 0) {
+        entry.stats.rejected++;
+        logger::error("%s: No valid session for this socket", entry.name.c_str());
+        return true;
+    }
+
+    Clock::time_point start = Clock::now();
+
+    if (entry.request) {
+        entry.request->Clear();
+
+        NetworkMessageView netMsg(context.data, context.size);
+        if (!netMsg.ParseTo(entry.request.get())) {
+            entry.stats.rejected++;
+            logger::error("%s: Failed to parse request", entry.name.c_str());
+            return true;
+        }
+
+        entry.invoke(context, entry.request.get());
+    } else {
+        entry.rawInvoke(context);
+    }
+
+    Clock::duration elapsed = Clock::now() - start;
+    entry.stats.totalTime += elapsed;
+    entry.stats.maxTime = std::max(entry.stats.maxTime, elapsed);
+    return true;
+}
+
+void MessageDispatcher::RecordWorkerTime(uint32_t type, Clock::duration queued, Clock::duration ran)
+{
+    auto it = m_entries.find(type);
+    if (it == m_entries.end()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_workerStatsMutex);
+    WorkerStats& stats = it->second.workerStats;
+    stats.count++;
+    stats.totalQueued += queued;
+    stats.totalTime += ran;
+    stats.maxTime = std::max(stats.maxTime, ran);
+}
+
+void MessageDispatcher::LogStats() const
+{
+    std::lock_guard<std::mutex> lock(m_workerStatsMutex);
+
+    for (const auto& pair : m_entries) {
+        const Stats& stats = pair.second.stats;
+        uint64_t handled = stats.count - stats.rejected;
+        if (handled == 0) {
+            continue;
+        }
+
+        long long avgUs = duration_cast<microseconds>(stats.totalTime).count() / (long long)handled;
+        logger::info("Dispatch: %s count %llu, bytes %llu, rejected %llu, avg %lld us, max %lld us",
+                     pair.second.name.c_str(),
+                     stats.count,
+                     stats.bytes,
+                     stats.rejected,
+                     avgUs,
+                     (long long)duration_cast<microseconds>(stats.maxTime).count());
+
+        const WorkerStats& worker = pair.second.workerStats;
+        if (worker.count) {
+            logger::info("Dispatch: %s on workers, avg queue %lld us, avg %lld us, max %lld us",
+                         pair.second.name.c_str(),
+                         (long long)duration_cast<microseconds>(worker.totalQueued).count() / (long long)worker.count,
+                         (long long)duration_cast<microseconds>(worker.totalTime).count() / (long long)worker.count,
+                         (long long)duration_cast<microseconds>(worker.maxTime).count());
+        }
+    }
+
+    if (m_unknown.count) {
+        logger::info("Dispatch: unknown types count %llu, bytes %llu", m_unknown.count, m_unknown.bytes);
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <google/protobuf/message_lite.h>
+#include "steam/steam_api.h"
+
+// what a handler gets besides its parsed request
+struct MessageContext {
+    SNetSocket_t socket;
+    uint64_t steamId; // 0 when the socket has no session
+    uint32_t type;
+    const uint8_t* data; // full frame, header included
+    uint32_t size;
+    std::chrono::steady_clock::time_point receivedAt; // read off the socket, before any worker queueing
+};
+
+// Maps k_EMsgGC_CC_* ids to typed handlers
+// Each registered type owns one request instance that is cleared and re-parsed for
+// every message, and keeps counters, byte totals and handler latency for profiling
+class MessageDispatcher {
+public:
+    using Clock = std::chrono::steady_clock;
+    using RawHandler = std::function<void(const MessageContext&)>;
+
+    template<typename T>
+    using Handler = std::function<void(const MessageContext&, T&)>;
+
+    // handler receives the payload parsed into T
+    template<typename T>
+    void Register(uint32_t type, const char* name, bool requiresSession, Handler<T> handler) {
+        Entry& entry = AddEntry(type, name, requiresSession);
+        entry.request = std::make_unique<T>();
+        entry.invoke = [handler = std::move(handler)](const MessageContext& context, google::protobuf::MessageLite* request) {
+            handler(context, *static_cast<T*>(request));
+        };
+    }
+
+    // handler parses the frame itself (or has nothing to parse)
+    void RegisterRaw(uint32_t type, const char* name, bool requiresSession, RawHandler handler);
+
+    // returns false for unknown types
+    bool Dispatch(const MessageContext& context);
+
+    // thread safe, for handlers that finish their work on a worker thread
+    void RecordWorkerTime(uint32_t type, Clock::duration queued, Clock::duration ran);
+
+    void LogStats() const;
+
+private:
+    struct Stats {
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+        uint64_t rejected = 0; // parse failures and missing sessions
+        Clock::duration totalTime{0};
+        Clock::duration maxTime{0};
+    };
+
+    struct WorkerStats {
+        uint64_t count = 0;
+        Clock::duration totalQueued{0};
+        Clock::duration totalTime{0};
+        Clock::duration maxTime{0};
+    };
+
+    struct Entry {
+        std::string name;
+        bool requiresSession = false;
+        std::unique_ptr<google::protobuf::MessageLite> request;
+        std::function<void(const MessageContext&, google::protobuf::MessageLite*)> invoke;
+        RawHandler rawInvoke;
+        Stats stats;
+        WorkerStats workerStats; // guarded by m_workerStatsMutex
+    };
+
+    Entry& AddEntry(uint32_t type, const char* name, bool requiresSession);
+
+    // registered at startup only, so workers may look entries up without locking
+    std::unordered_map<uint32_t, Entry> m_entries;
+    Stats m_unknown;
+    mutable std::mutex m_workerStatsMutex;
+};
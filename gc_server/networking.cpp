@@ -4,11 +4,19 @@
 #include "networking_users.hpp"
 #include "networking_matchmaking.hpp"
 #include "matchmaking_manager.hpp"
+#include "event_loop.hpp"
+#include "inventory_cache.hpp"
+#include "profile_cache.hpp"
+#include "item_blob_cache.hpp"
+#include "write_behind.hpp"
+#include "schema_migrations.hpp"
 #include <sstream>
+#include <thread>
 
 #include <steam/steam_api.h>
 #include "logger.hpp"
 #include "steam_network_message.hpp"
+#include "request_arena.hpp"
 #include <steam/steam_gameserver.h>
 
 void ip_to_str(char* ip, int ipsize, uint32_t uip)
@@ -22,11 +30,11 @@ void ip_to_str(char* ip, int ipsize, uint32_t uip)
 
 SNetListenSocket_t listen_socket;
 
+// strand for jobs that aren't tied to one player
+constexpr uint64_t SystemStrand = 0;
+
 GCNetwork::GCNetwork()
     : m_SocketStatusCallback()
-    , m_mysql1(NULL)
-    , m_mysql2(NULL)
-    , m_mysql3(NULL)
 {
     if (!GCNetwork_Inventory::Init()) {
         logger::error("Failed to initialize inventory system in GCNetwork constructor");
@@ -54,46 +62,86 @@ GCNetwork::~GCNetwork()
     SteamGameServerNetworking()->DestroyListenSocket(listen_socket, true);
 }
 
-bool GCNetwork::InitDatabases() 
+static DatabaseConfig MakeDatabaseConfig(const char* database)
 {
-    // Initialize MySQL objects
-    m_mysql1 = mysql_init(NULL);
-    m_mysql2 = mysql_init(NULL);
-    m_mysql3 = mysql_init(NULL);
+    DatabaseConfig config;
+    config.host = "localhost";
+    config.user = "gc";
+    config.password = "61lol61w";
+    config.database = database;
+    config.port = 3306;
+    // lets the outbox triggers tell the GC's own writes apart
+    config.initQuery = "SET @gc_writer = 1";
+    return config;
+}
 
-    if (m_mysql1 == NULL || m_mysql2 == NULL || m_mysql3 == NULL) {
-        logger::error("Failed to initialize MySQL objects");
-        return false;
-    }
+bool GCNetwork::InitDatabases(size_t workerThreads) 
+{
+    // a worker holds at most one connection per database at a time
+    size_t maxConnections = workerThreads;
 
-    // 1ST DB CONNECTION
     // used for checking players bans, whitelist, cooldowns
-    if (!mysql_real_connect(m_mysql1, "localhost", "gc", "61lol61w", "classiccounter", 3306, NULL, 0)) {
-        logger::error("Failed to connect to database1: %s", mysql_error(m_mysql1));
-        return false;
+    m_classiccounterDb = std::make_unique<DatabasePool>(MakeDatabaseConfig("classiccounter"), 1, maxConnections);
+    // used for inventory, equips, commends, reports
+    m_inventoryDb = std::make_unique<DatabasePool>(MakeDatabaseConfig("ollum_inventory"), 2, maxConnections);
+    // used for rank, wins
+    m_rankedDb = std::make_unique<DatabasePool>(MakeDatabaseConfig("ollum_ranked"), 1, maxConnections);
+
+    bool ok = m_classiccounterDb->Open();
+    ok &= m_inventoryDb->Open();
+    ok &= m_rankedDb->Open();
+
+    m_asyncInventory = m_asyncDb.AddDatabase(MakeDatabaseConfig("ollum_inventory"), 2);
+    m_asyncRanked = m_asyncDb.AddDatabase(MakeDatabaseConfig("ollum_ranked"), 2);
+    ok &= m_asyncDb.Start();
+
+    // schema changes land before any handler queries the new columns
+    if (ok) {
+        DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+        ok = inventory && SchemaMigrations::Run(inventory, "ollum_inventory", SchemaMigrations::Inventory());
     }
-    logger::info("Connected to classiccounter DB successfully!");
 
-    // 2ND DB CONNECTION
-    // used for inventory, equips, commends, reports
-    if (!mysql_real_connect(m_mysql2, "localhost", "gc", "61lol61w", "ollum_inventory", 3306, NULL, 0)) {
-        logger::error("Failed to connect to database2: %s", mysql_error(m_mysql2));
-        mysql_close(m_mysql1);
-        return false;
+    // hellos read bans from memory, they have to be there before the first one
+    if (ok) {
+        DatabasePool::Connection classiccounter = m_classiccounterDb->Acquire();
+        ok = classiccounter && m_banIndex.Load(classiccounter);
     }
-    logger::info("Connected to ollum_inventory DB successfully!");
 
-    // 3RD DB CONNECTION
-    // used for rank, wins
-    if (!mysql_real_connect(m_mysql3, "localhost", "gc", "61lol61w", "ollum_ranked", 3306, NULL, 0)) {
-        logger::error("Failed to connect to database3: %s", mysql_error(m_mysql3));
-        mysql_close(m_mysql1);
-        mysql_close(m_mysql2);
+    // writes a previous run didn't get to are applied with the first flush
+    const char* journal = getenv("GC_WRITE_JOURNAL");
+    WriteBehindQueue::GetInstance()->Open(journal ? journal : "gc_write_behind.journal");
+
+    m_workers.Start(workerThreads);
+
+    // before any session exists, so no item can fall between a login and the first poll
+    m_workers.Submit(SystemStrand, [this] {
+        DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+        if (inventory) {
+            EnsureItemWatermark(inventory);
+            StartItemFeed(inventory);
+        }
+    });
+
+    return ok;
+}
+
+bool GCNetwork::RebuildCounters()
+{
+    DatabasePool inventoryDb(MakeDatabaseConfig("ollum_inventory"), 1, 1);
+    if (!inventoryDb.Open()) {
         return false;
     }
-    logger::info("Connected to ollum_ranked DB successfully!");
 
-    return true;
+    bool ok;
+    {
+        DatabasePool::Connection inventory = inventoryDb.Acquire();
+        ok = inventory &&
+             SchemaMigrations::Run(inventory, "ollum_inventory", SchemaMigrations::Inventory()) &&
+             SchemaMigrations::RebuildPlayerCounters(inventory);
+    }
+
+    inventoryDb.Close();
+    return ok;
 }
 
 bool GCNetwork::ExecuteQuery(MYSQL* connection, const char* query) {
@@ -105,21 +153,47 @@ bool GCNetwork::ExecuteQuery(MYSQL* connection, const char* query) {
 }
 
 void GCNetwork::CloseDatabases() {
-    if (m_mysql1) {
-        mysql_close(m_mysql1);
-        m_mysql1 = NULL;
+    if (m_databasesClosed) {
+        return;
     }
-    if (m_mysql2) {
-        mysql_close(m_mysql2);
-        m_mysql2 = NULL;
+    m_databasesClosed = true;
+
+    // finish queued handlers before the pools go away
+    m_workers.Stop();
+    m_asyncDb.Stop();
+
+    // handlers are done enqueueing, whatever can't be applied stays in the journal
+    WriteBehindQueue* writeBehind = WriteBehindQueue::GetInstance();
+    if (m_inventoryDb) {
+        DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+        if (inventory) {
+            writeBehind->FlushAll(inventory);
+        }
     }
-    if (m_mysql3) {
-        mysql_close(m_mysql3);
-        m_mysql3 = NULL;
+    writeBehind->Close();
+
+    for (DatabasePool* pool : {m_classiccounterDb.get(), m_inventoryDb.get(), m_rankedDb.get()}) {
+        if (pool) {
+            pool->Close();
+        }
     }
 }
 
-void GCNetwork::Init(const char* bind_ip, uint16 port) 
+void GCNetwork::Defer(const MessageContext& context, WorkerPool::Task job)
+{
+    // sessionless requests are still kept in order per socket
+    uint64_t key = context.steamId ? context.steamId : context.socket;
+    uint32_t type = context.type;
+    MessageDispatcher::Clock::time_point queuedAt = MessageDispatcher::Clock::now();
+
+    m_workers.Submit(key, [this, type, queuedAt, job = std::move(job)] {
+        MessageDispatcher::Clock::time_point start = MessageDispatcher::Clock::now();
+        job();
+        m_dispatcher.RecordWorkerTime(type, start - queuedAt, MessageDispatcher::Clock::now() - start);
+    });
+}
+
+void GCNetwork::Init(const char* bind_ip, uint16 port, size_t workerThreads) 
 {
     // Convert IP string to SteamIPAddress_t
     SteamIPAddress_t steam_ip;
@@ -142,6 +216,16 @@ void GCNetwork::Init(const char* bind_ip, uint16 port)
         }
     }
     
+    if (const char* maxMessageSize = getenv("GC_MAX_MESSAGE_SIZE")) {
+        uint32_t size = strtoul(maxMessageSize, nullptr, 10);
+        if (size >= sizeof(uint32_t)) {
+            m_maxMessageSize = size;
+        }
+    }
+    logger::info("Accepting messages up to %u bytes", m_maxMessageSize);
+
+    RegisterHandlers();
+
     listen_socket = SteamGameServerNetworking()->CreateListenSocket(0, steam_ip, port, true);
     m_SocketStatusCallback.Register(this, &GCNetwork::SocketStatusCallback);
 
@@ -161,26 +245,13 @@ void GCNetwork::Init(const char* bind_ip, uint16 port)
     }
 
     // init db connections
-    if (!InitDatabases()) {
+    if (!InitDatabases(workerThreads)) {
         logger::error("Failed to initialize databases");
     }
 }
 
-void GCNetwork::ReadAuthTicket(SNetSocket_t p2psocket, void* message, uint32 msgsize, MYSQL* classiccounter_db, MYSQL* inventory_db, MYSQL* ranked_db) 
+void GCNetwork::ReadAuthTicket(SNetSocket_t p2psocket, const CMsgGC_CC_GCWelcome& welcomeMsg) 
 { 
-    logger::info("Starting ReadAuthTicket - Raw message size: %u", msgsize);
-    const uint8_t* bytes = static_cast<const uint8_t*>(message);
-    logger::info("First 8 bytes: %02x %02x %02x %02x %02x %02x %02x %02x",
-        bytes[0], bytes[1], bytes[2], bytes[3], bytes[4], bytes[5], bytes[6], bytes[7]);
-
-    NetworkMessage netMsg(message, msgsize);
-
-    CMsgGC_CC_GCWelcome welcomeMsg;
-    if (!netMsg.ParseTo(&welcomeMsg)) {
-        logger::error("Failed to parse welcome message");
-        return;
-    }
-
     logger::info("Parsed welcome message - Steam ID: %llu, Ticket Size: %u", 
                 welcomeMsg.steam_id(), welcomeMsg.auth_ticket_size());
 
@@ -229,27 +300,55 @@ void GCNetwork::ReadAuthTicket(SNetSocket_t p2psocket, void* message, uint32 msg
         {
             // update existing one
             it->second.isAuthenticated = true;
-            it->second.socket = p2psocket;
+            BindSessionSocket(it->second, p2psocket);
             it->second.updateActivity();
-           
-            // init lastCheckedItemId
-            if (!it->second.itemIdInitialized) {
-                it->second.lastCheckedItemId = GCNetwork_Inventory::GetLatestItemIdForUser(steamID, inventory_db);
-                it->second.itemIdInitialized = true;
-            }
         } else {
             // create new session
             ClientSessions session(CSteamID(static_cast<uint64>(steamID)));
             session.isAuthenticated = true;
-            session.socket = p2psocket;
-            session.lastCheckedItemId = GCNetwork_Inventory::GetLatestItemIdForUser(steamID, inventory_db);
-            session.itemIdInitialized = true;
-            m_activeSessions.insert(std::make_pair(steamID, session));
+            auto inserted = m_activeSessions.insert(std::make_pair(steamID, session));
+            BindSessionSocket(inserted.first->second, p2psocket);
+            it = inserted.first;
         }
-       
-        auto logIt = m_activeSessions.find(steamID);
-        logger::info("Created/updated session for %llu with lastCheckedItemId %llu, total sessions: %zu",
-                    steamID, logIt->second.lastCheckedItemId, m_activeSessions.size());
+
+        // load the inventory and init lastCheckedItemId, this runs on the player's
+        // strand so it completes before any inventory request that follows the auth
+        if (!it->second.itemIdInitialized) {
+            // CleanupSessions drops the player on this thread too, a load
+            // still running when the session expires won't be cached
+            InventoryCache::GetInstance()->Admit(steamID);
+
+            // the poller/feed skips the session until it's initialized, whatever it
+            // reads past this point in the meantime is replayed for the session below
+            uint64_t replayFrom = m_itemCursor.load();
+            m_workers.Submit(steamID, [this, steamID, replayFrom] {
+                DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                if (!inventory) {
+                    return;
+                }
+
+                // the inventory is cached for the rest of the session, its highest
+                // id is the starting point for new item notifications
+                uint64_t latestItemId = 0;
+                if (!GCNetwork_Inventory::LoadInventory(steamID, inventory, latestItemId)) {
+                    latestItemId = GCNetwork_Inventory::GetLatestItemIdForUser(steamID, inventory);
+                }
+
+                EventLoop::GetInstance()->Post([this, steamID, latestItemId, replayFrom] {
+                    auto it = m_activeSessions.find(steamID);
+                    if (it != m_activeSessions.end() && !it->second.itemIdInitialized) {
+                        it->second.lastCheckedItemId = latestItemId;
+                        it->second.itemIdInitialized = true;
+                        logger::info("Initialized session for %llu with lastCheckedItemId %llu",
+                                    steamID, latestItemId);
+                        ReplayItems(steamID, it->second.socket, latestItemId, replayFrom);
+                    }
+                });
+            });
+        }
+
+        logger::info("Created/updated session for %llu, total sessions: %zu",
+                    steamID, m_activeSessions.size());
     
         auto response = Messages::CreateAuthConfirm(res);
         response.WriteToSocket(p2psocket, true);
@@ -281,24 +380,90 @@ void GCNetwork::CleanupSessions()
     for (auto& id : sessionsToRemove)
     {
         logger::info("Removing expired session for %llu", id);
-        m_activeSessions.erase(id);
+        InventoryCache::GetInstance()->Drop(id);
+        auto it = m_activeSessions.find(id);
+        BindSessionSocket(it->second, k_HSteamNetConnection_Invalid);
+        m_activeSessions.erase(it);
     }
 }
 
 uint64_t GCNetwork::GetSessionSteamId(SNetSocket_t socket) {
-    for (auto& pair : m_activeSessions) {
-        if (pair.second.socket == socket) {
-            return pair.first;
-        }
+    auto it = m_socketSessions.find(socket);
+    return it != m_socketSessions.end() ? it->second : 0;
+}
+
+void GCNetwork::BindSessionSocket(ClientSessions& session, SNetSocket_t socket)
+{
+    // keep the socket -> steamid index in sync with the session
+    auto it = m_socketSessions.find(session.socket);
+    if (it != m_socketSessions.end() && it->second == session.steamID.ConvertToUint64()) {
+        m_socketSessions.erase(it);
+    }
+
+    session.socket = socket;
+    if (socket != k_HSteamNetConnection_Invalid) {
+        m_socketSessions[socket] = session.steamID.ConvertToUint64();
     }
-    return 0;
 }
 
-void GCNetwork::CheckNewItemsForActiveSessions() 
+bool GCNetwork::EnsureItemWatermark(MYSQL* inventory_db)
+{
+    if (m_itemWatermarkReady) {
+        return true;
+    }
+
+    // sessions initialize their own watermark at login, so only items
+    // created from here on need to be looked at
+    if (!GCNetwork_Inventory::GetLatestItemId(m_itemWatermark, inventory_db)) {
+        return false;
+    }
+
+    m_itemWatermarkReady = true;
+    m_itemCursor = m_itemWatermark;
+    logger::info("New item poller starting at item id %llu", m_itemWatermark);
+    return true;
+}
+
+void GCNetwork::ReplayItems(uint64_t steamId, SNetSocket_t socket, uint64_t lastItemId, uint64_t replayFrom)
 {
+    if (socket == k_HSteamNetConnection_Invalid) {
+        return;
+    }
+
+    // runs on the SystemStrand after every poll that didn't watch the session yet and
+    // before any that does, so the range up to the current cursor is covered exactly once
+    std::vector<ItemWatch> watches{{steamId, socket, lastItemId}};
+    m_workers.Submit(SystemStrand, [this, watches = std::move(watches), replayFrom]() mutable {
+        uint64_t until = m_itemFeedActive ? m_itemFeed.GetLastEventId() : m_itemWatermark;
+        if (replayFrom >= until || (!m_itemFeedActive && !m_itemWatermarkReady)) {
+            return;
+        }
+
+        DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+        if (!inventory) {
+            return;
+        }
+
+        if (m_itemFeedActive) {
+            std::vector<ItemEvent> events;
+            if (!m_itemFeed.ReadRange(inventory, replayFrom, until, events) || events.empty()) {
+                return;
+            }
+            GCNetwork_Inventory::SendItemEvents(events, watches, inventory);
+        } else {
+            uint64_t watermark = replayFrom;
+            GCNetwork_Inventory::SendNewItemsSince(watermark, watches, inventory, until);
+        }
+
+        ApplyItemWatches(watches);
+    });
+}
+
+std::vector<ItemWatch> GCNetwork::SnapshotItemWatches()
+{
+    std::vector<ItemWatch> watches;
     for (auto& pair : m_activeSessions) {
         auto& session = pair.second;
-        uint64_t steamId = session.steamID.ConvertToUint64();
         
         // Skip if not authenticated, not initialized, or no valid socket
         if (!session.isAuthenticated || 
@@ -306,17 +471,138 @@ void GCNetwork::CheckNewItemsForActiveSessions()
             session.socket == k_HSteamNetConnection_Invalid) {
             continue;
         }
-        
-        // Check for new items and update the session's lastCheckedItemId if found
-        if (GCNetwork_Inventory::CheckAndSendNewItemsSince(
-                session.socket, 
-                steamId, 
-                session.lastCheckedItemId, 
-                m_mysql2)) {
+
+        watches.push_back({pair.first, session.socket, session.lastCheckedItemId});
+    }
+    return watches;
+}
+
+void GCNetwork::ApplyItemWatches(const std::vector<ItemWatch>& watches)
+{
+    // called on a worker, the new watermarks are applied back on the loop thread
+    for (const auto& watch : watches) {
+        if (!watch.notified) {
+            continue;
+        }
+
+        EventLoop::GetInstance()->Post([this, watch] {
+            auto it = m_activeSessions.find(watch.steamId);
+            if (it == m_activeSessions.end()) {
+                return;
+            }
+
+            it->second.lastCheckedItemId = std::max(it->second.lastCheckedItemId, watch.lastItemId);
             // Update the session's last activity time if items were found and sent
-            session.updateActivity();
+            it->second.updateActivity();
+        });
+    }
+}
+
+void GCNetwork::CheckNewItemsForActiveSessions() 
+{
+    // the outbox feed covers it
+    if (m_itemFeedActive) {
+        return;
+    }
+
+    std::vector<ItemWatch> watches = SnapshotItemWatches();
+    if (watches.empty()) {
+        return;
+    }
+
+    // one range scan for every session, on a worker
+    m_workers.Submit(SystemStrand, [this, watches = std::move(watches)]() mutable {
+        DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+        if (!inventory) {
+            return;
+        }
+
+        if (!EnsureItemWatermark(inventory)) {
+            return;
         }
+
+        size_t rows = GCNetwork_Inventory::SendNewItemsSince(m_itemWatermark, watches, inventory);
+        m_itemCursor = m_itemWatermark;
+        if (rows == 0) {
+            return;
+        }
+
+        ApplyItemWatches(watches);
+    });
+}
+
+void GCNetwork::StartItemFeed(MYSQL* inventory_db)
+{
+    if (!m_itemFeed.Start(inventory_db)) {
+        // the poller only sees ids past its watermark, so cached inventories miss
+        // updates, deletes and trades made outside the GC until the next login
+        logger::warning("Item outbox unavailable, polling csgo_items for new items instead");
+        logger::warning("Without the outbox, items changed, deleted or traded outside the GC "
+                        "stay stale in the inventory cache until the player logs in again");
+        return;
     }
+
+    m_itemCursor = m_itemFeed.GetLastEventId();
+    m_itemFeedActive = true;
+}
+
+void GCNetwork::PollItemEvents()
+{
+    // one read in flight at a time, a slow database shouldn't pile them up
+    if (!m_itemFeedActive || m_itemFeedQueued) {
+        return;
+    }
+    m_itemFeedQueued = true;
+
+    // the tail is read even with nobody online so the feed doesn't fall behind
+    m_workers.Submit(SystemStrand, [this, watches = SnapshotItemWatches()]() mutable {
+        DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+        if (inventory) {
+            std::vector<ItemEvent> events;
+            bool read = m_itemFeed.Read(inventory, events);
+            m_itemCursor = m_itemFeed.GetLastEventId();
+            if (read && !events.empty()) {
+                GCNetwork_Inventory::SendItemEvents(events, watches, inventory);
+                ApplyItemWatches(watches);
+            }
+        }
+
+        EventLoop::GetInstance()->Post([this] { m_itemFeedQueued = false; });
+    });
+}
+
+void GCNetwork::RefreshBanIndex()
+{
+    if (m_banIndexQueued) {
+        return;
+    }
+    m_banIndexQueued = true;
+
+    m_workers.Submit(SystemStrand, [this] {
+        DatabasePool::Connection classiccounter = m_classiccounterDb->Acquire();
+        if (classiccounter) {
+            m_banIndex.Refresh(classiccounter);
+        }
+
+        EventLoop::GetInstance()->Post([this] { m_banIndexQueued = false; });
+    });
+}
+
+void GCNetwork::FlushWriteBehind()
+{
+    if (m_writeBehindQueued) {
+        return;
+    }
+    m_writeBehindQueued = true;
+
+    m_workers.Submit(SystemStrand, [this] {
+        DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+        if (inventory) {
+            WriteBehindQueue::GetInstance()->Flush(inventory);
+        }
+
+        EventLoop::GetInstance()->Post([this] { m_writeBehindQueued = false; });
+    });
 }
 
 void SendHeartbeat(SNetSocket_t p2psocket) {
@@ -324,404 +610,445 @@ void SendHeartbeat(SNetSocket_t p2psocket) {
     message.WriteToSocket(p2psocket, true);
 }
 
-void GCNetwork::Update() 
+void GCNetwork::Run(std::chrono::milliseconds callbackInterval, std::chrono::milliseconds pollInterval)
 {
-    // cleanup sessions
-    static int updateCounter = 0;
-    static int itemCheckCounter = 0;
-    static int matchmakingCounter = 0;
-    
-    if (++updateCounter >= 1000) {
-        CleanupSessions();
-        updateCounter = 0;
-    }
-    
-    // check for new items every 5 seconds
-    if (++itemCheckCounter >= 250) {
-        CheckNewItemsForActiveSessions();
-        itemCheckCounter = 0;
-    }
-    
-    // DISABLED: update matchmaking every frame
-    // if (++matchmakingCounter >= 50) { // Update every ~1 second at 20 ticks/sec
-    //     MatchmakingManager::GetInstance()->Update();
-    //     matchmakingCounter = 0;
-    // }
+    EventLoop* loop = EventLoop::GetInstance();
+    loop->Attach();
 
-    SteamGameServer_RunCallbacks();
+    logger::info("Entering event loop (callbacks every %lld ms, socket poll every %lld ms)",
+                 (long long)callbackInterval.count(), (long long)pollInterval.count());
 
-    SNetSocket_t p2psocket;
-    uint32_t msgsize;
+    SchedulePeriodicJobs(callbackInterval);
 
-    while (SteamGameServerNetworking()->IsDataAvailable(listen_socket, &msgsize, &p2psocket)) {
-        std::vector<uint8_t> buffer(msgsize);
-        
-        if (!SteamGameServerNetworking()->RetrieveDataFromSocket(
-            p2psocket, buffer.data(), msgsize, &msgsize)) {
-            continue;
-        }
+    while (!loop->IsStopping()) {
+        m_scheduler.RunDue(EventLoop::Clock::now());
 
-        // get raw 32-bit type
-        uint32_t raw_type;
-        memcpy(&raw_type, buffer.data(), sizeof(uint32_t));
+        size_t handled = Update();
+        handled += loop->RunPending();
 
-        // unmask dat bitch
-        constexpr uint32_t CCProtoMask = 0x90000000;
-        uint32_t real_type = raw_type & ~CCProtoMask;
+        // keep draining while there is traffic, otherwise sleep until the
+        // next scheduled job or socket poll, whichever comes first
+        if (handled == 0) {
+            EventLoop::Clock::time_point pollDeadline = EventLoop::Clock::now() + pollInterval;
+            loop->WaitUntil(std::min(m_scheduler.NextDeadline(), pollDeadline));
+        }
+    }
 
-        logger::info("Received message - Raw: %08X, Unmasked: %u (0x%X)", 
-                    raw_type, real_type, real_type);
+    // handlers and async callbacks post into the loop, so they are stopped
+    // here while it still exists rather than from the destructor of m_network
+    CloseDatabases();
+    loop->RunPending();
 
-        switch (real_type) {
-            case k_EMsgGC_CC_GCWelcome:
-                logger::info("Received GCWelcome");
-                this->ReadAuthTicket(p2psocket, buffer.data(), msgsize, m_mysql1, m_mysql2, m_mysql3);
-                break;
-
-            case k_EMsgGC_CC_GCConfirmAuth:
-                logger::info("Received GCConfirmAuth");
-                break;
-
-            case k_EMsgGC_CC_CL2GC_BuildMatchmakingHelloRequest:
-                logger::info("Received BuildMatchmakingHelloRequest");
-                {
-                    NetworkMessage netMsg(buffer.data(), msgsize);
-                    CMsgGC_CC_CL2GC_BuildMatchmakingHelloRequest request;
-                    if (netMsg.ParseTo(&request)) {
-                        CMsgGC_CC_GC2CL_BuildMatchmakingHello response;
-                        GCNetwork_Users::BuildMatchmakingHello(response, request.steam_id(), m_mysql1, m_mysql2, m_mysql3);
-                        NetworkMessage matchmakingMsg = NetworkMessage::FromProto(response, k_EMsgGC_CC_GC2CL_BuildMatchmakingHello);
-                        matchmakingMsg.WriteToSocket(p2psocket, true);
-                    }
-                }
-                break;
-
-            case k_EMsgGC_CC_CL2GC_SOCacheSubscribedRequest:
-                logger::info("Received SOCacheSubscribedRequest");
-                {
-                    NetworkMessage netMsg(buffer.data(), msgsize);
-                    CMsgGC_CC_CL2GC_SOCacheSubscribedRequest request;
-                    if (netMsg.ParseTo(&request)) {
-                        GCNetwork_Inventory::SendSOCache(p2psocket, request.steam_id(), m_mysql2);
-                    }
-                }
-                break;
-
-            case k_EMsgGC_CC_GCHeartbeat:
-                logger::info("Received GCHeartbeat");
-                SendHeartbeat(p2psocket);
-                break;
-
-            // INVENTORY ACTIONS
-
-            case k_EMsgGC_CC_CL2GC_ItemAcknowledged:
-                logger::info("Received ItemAcknowledged");
-                {
-                    NetworkMessage netMsg(buffer.data(), msgsize);
-                    CMsgGC_CC_CL2GC_ItemAcknowledged request;
-                    if (netMsg.ParseTo(&request)) {
-                        uint64_t steamId = GetSessionSteamId(p2psocket);
-                        if (steamId != 0) {
-                            GCNetwork_Inventory::ProcessClientAcknowledgment(p2psocket, steamId, request, m_mysql2);
-                        } else {
-                            logger::error("ItemAcknowledged: No valid session for this socket");
-                        }
-                    }
-                }
-                break;
-
-            case k_EMsgGC_CC_CL2GC_UnlockCrate:
-                logger::info("Received UnlockCrate request");
-                {
-                    NetworkMessage netMsg(buffer.data(), msgsize);
-                    CMsgGC_CC_CL2GC_UnlockCrate request;
-                    if (netMsg.ParseTo(&request)) {
-                        uint64_t steamId = GetSessionSteamId(p2psocket);
-                        if (steamId != 0) {
-                            uint64_t crateItemId = request.crate_id();
-                            bool success = GCNetwork_Inventory::HandleUnboxCrate(p2psocket, steamId, crateItemId, m_mysql2);
-                            
-                            if (success) {
-                                logger::info("Successfully processed crate unlock for user %llu, crate %llu", 
-                                            steamId, crateItemId);
-                            } else {
-                                logger::error("Failed to process crate unlock for user %llu, crate %llu", 
-                                            steamId, crateItemId);
-                            }
-                        } else {
-                            logger::error("UnlockCrate: No valid session for this socket");
-                        }
-                    } else {
-                        logger::error("UnlockCrate: Failed to parse request");
-                    }
-                }
-                break;
-
-            case k_EMsgGC_CC_CL2GC_AdjustItemEquippedState:
-                logger::info("Received AdjustItemEquippedState request");
-                {
-                    NetworkMessage netMsg(buffer.data(), msgsize);
-                    CMsgGC_CC_CL2GC_AdjustItemEquippedState request;
-                    if (netMsg.ParseTo(&request)) {
-                        uint64_t steamId = GetSessionSteamId(p2psocket);
-                        if (steamId != 0) {
-                            uint64_t itemId = request.item_id();
-                            uint32_t classId = request.new_class();
-                            uint32_t slotId = request.new_slot();
-                            
-                            logger::info("AdjustItemEquippedState: User %llu wants to equip item %llu in class %u slot %u",
-                                        steamId, itemId, classId, slotId);
-                            
-                            bool success;
-                            success = GCNetwork_Inventory::EquipItem(p2psocket, steamId, itemId, classId, slotId, m_mysql2);
-                        }
+    logger::info("Event loop stopped");
+}
+
+void GCNetwork::SchedulePeriodicJobs(std::chrono::milliseconds callbackInterval)
+{
+    using namespace std::chrono_literals;
+
+    // steam callbacks on a fixed cadence, independent of traffic
+    m_scheduler.Schedule("steam_callbacks", callbackInterval, 0ms,
+        [] { SteamGameServer_RunCallbacks(); }, true);
+
+    m_scheduler.Schedule("session_cleanup", 60s, 5s,
+        [this] { CleanupSessions(); });
+
+    // new and changed items come from the outbox; the 5 second poll is
+    // the fallback when the outbox couldn't be installed
+    m_scheduler.Schedule("item_event_feed", 250ms, 0ms,
+        [this] { PollItemEvents(); });
+
+    m_scheduler.Schedule("item_event_prune", 1h, 1min,
+        [this] {
+            if (m_itemFeedActive) {
+                m_workers.Submit(SystemStrand, [this] {
+                    DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                    if (inventory) {
+                        m_itemFeed.Prune(inventory);
                     }
+                });
+            }
+        });
+
+    m_scheduler.Schedule("ban_index_refresh", 5s, 500ms,
+        [this] { RefreshBanIndex(); });
+
+    m_scheduler.Schedule("write_behind_flush", 200ms, 0ms,
+        [this] { FlushWriteBehind(); });
+
+    m_scheduler.Schedule("new_item_check", 5s, 500ms,
+        [this] { CheckNewItemsForActiveSessions(); });
+
+    // DISABLED: update matchmaking every second
+    // m_scheduler.Schedule("matchmaking_update", 1s, 0ms,
+    //     [] { MatchmakingManager::GetInstance()->Update(); });
+
+    m_scheduler.Schedule("scheduler_stats", 5min, 0ms,
+        [this] { m_scheduler.LogStats(); });
+
+    m_scheduler.Schedule("dispatch_stats", 5min, 0ms,
+        [this] {
+            m_dispatcher.LogStats();
+            NetworkMessage::LogBufferStats();
+            m_receiveBuffers.LogStats();
+        });
+
+    m_scheduler.Schedule("worker_stats", 5min, 0ms,
+        [this] {
+            m_workers.LogStats();
+            RequestArena::LogStats();
+        });
+
+    m_scheduler.Schedule("inventory_cache_stats", 5min, 0ms,
+        [] {
+            InventoryCache::GetInstance()->LogStats();
+            ItemBlobCache::GetInstance()->LogStats();
+        });
+
+    m_scheduler.Schedule("profile_cache_stats", 5min, 0ms,
+        [] { ProfileCache::GetInstance()->LogStats(); });
+
+    m_scheduler.Schedule("unbox_stats", 5min, 0ms,
+        [] { GCNetwork_Inventory::LogUnboxStats(); });
+
+    // pings run on a worker so a dead server can't stall the loop
+    m_scheduler.Schedule("db_health_check", 30s, 2s,
+        [this] {
+            m_workers.Submit(SystemStrand, [this] {
+                m_classiccounterDb->HealthCheck();
+                m_inventoryDb->HealthCheck();
+                m_rankedDb->HealthCheck();
+            });
+        });
+
+    m_scheduler.Schedule("db_stats", 5min, 0ms,
+        [this] {
+            m_classiccounterDb->LogStats();
+            m_inventoryDb->LogStats();
+            m_rankedDb->LogStats();
+            m_asyncDb.LogStats();
+            m_banIndex.LogStats();
+            WriteBehindQueue::GetInstance()->LogStats();
+        });
+}
+
+void GCNetwork::RegisterHandlers()
+{
+    MessageDispatcher& d = m_dispatcher;
+
+    // steam auth and heartbeats stay on the loop thread, everything that touches
+    // the database is deferred to the player's strand on the worker pool
+
+    d.Register<CMsgGC_CC_GCWelcome>(k_EMsgGC_CC_GCWelcome, "GCWelcome", false,
+        [this](const MessageContext& ctx, CMsgGC_CC_GCWelcome& request) {
+            ReadAuthTicket(ctx.socket, request);
+        });
+
+    d.RegisterRaw(k_EMsgGC_CC_GCConfirmAuth, "GCConfirmAuth", false,
+        [](const MessageContext&) {});
+
+    d.Register<CMsgGC_CC_CL2GC_BuildMatchmakingHelloRequest>(k_EMsgGC_CC_CL2GC_BuildMatchmakingHelloRequest, "BuildMatchmakingHelloRequest", false,
+        [this](const MessageContext& ctx, CMsgGC_CC_CL2GC_BuildMatchmakingHelloRequest& request) {
+            // no worker needed, the lookups run concurrently on the async engine
+            // and the reply is written from the loop thread
+            GCNetwork_Users::BuildMatchmakingHello(request.steam_id(), m_banIndex, m_asyncInventory, m_asyncRanked,
+                [socket = ctx.socket](const CMsgGC_CC_GC2CL_BuildMatchmakingHello& response) {
+                    NetworkMessage matchmakingMsg = NetworkMessage::FromProto(response, k_EMsgGC_CC_GC2CL_BuildMatchmakingHello);
+                    matchmakingMsg.WriteToSocket(socket, true);
+                });
+        });
+
+    d.Register<CMsgGC_CC_CL2GC_SOCacheSubscribedRequest>(k_EMsgGC_CC_CL2GC_SOCacheSubscribedRequest, "SOCacheSubscribedRequest", false,
+        [this](const MessageContext& ctx, CMsgGC_CC_CL2GC_SOCacheSubscribedRequest& request) {
+            Defer(ctx, [this, socket = ctx.socket, steamId = request.steam_id()] {
+                DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                if (!inventory) {
+                    return;
                 }
-                break;
-
-            case k_EMsgGC_CC_DeleteItem:
-                logger::info("Received DeleteItem request");
-                {
-                    NetworkMessage netMsg(buffer.data(), msgsize);
-                    CMsgGC_CC_DeleteItem request;
-                    if (netMsg.ParseTo(&request)) {
-                        uint64_t steamId = GetSessionSteamId(p2psocket);
-                        if (steamId != 0) {
-                            uint64_t itemId = request.item_id();
-                            GCNetwork_Inventory::DeleteItem(p2psocket, steamId, itemId, m_mysql2);
-                        } else {
-                            logger::error("DeleteItem: No valid session for this socket");
-                        }
-                    }
+
+                GCNetwork_Inventory::SendSOCache(socket, steamId, inventory);
+            });
+        });
+
+    d.RegisterRaw(k_EMsgGC_CC_GCHeartbeat, "GCHeartbeat", false,
+        [](const MessageContext& ctx) {
+            SendHeartbeat(ctx.socket);
+        });
+
+    // INVENTORY ACTIONS
+
+    d.Register<CMsgGC_CC_CL2GC_ItemAcknowledged>(k_EMsgGC_CC_CL2GC_ItemAcknowledged, "ItemAcknowledged", true,
+        [this](const MessageContext& ctx, CMsgGC_CC_CL2GC_ItemAcknowledged& request) {
+            Defer(ctx, [this, socket = ctx.socket, steamId = ctx.steamId, request = std::move(request)] {
+                DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                if (!inventory) {
+                    return;
                 }
-                break;
-
-            case k_EMsgGC_CC_CL2GC_NameItem:
-                logger::info("Received NameItem request");
-                {
-                    NetworkMessage netMsg(buffer.data(), msgsize);
-                    CMsgGC_CC_CL2GC_NameItem request;
-                    if (netMsg.ParseTo(&request)) {
-                        uint64_t steamId = GetSessionSteamId(p2psocket);
-                        if (steamId != 0) {
-                            uint64_t itemId = request.item_id();
-                            std::string name = request.name();
-                            
-                            logger::info("NameItem: User %llu wants to name item %llu to '%s'",
-                                        steamId, itemId, name.c_str());
-                            
-                            bool success = GCNetwork_Inventory::HandleNameItem(
-                                p2psocket, steamId, itemId, name, m_mysql2);
-                        }
-                    }
+
+                GCNetwork_Inventory::ProcessClientAcknowledgment(socket, steamId, request, inventory);
+            });
+        });
+
+    d.Register<CMsgGC_CC_CL2GC_UnlockCrate>(k_EMsgGC_CC_CL2GC_UnlockCrate, "UnlockCrate", true,
+        [this](const MessageContext& ctx, CMsgGC_CC_CL2GC_UnlockCrate& request) {
+            Defer(ctx, [this, socket = ctx.socket, steamId = ctx.steamId, crateItemId = request.crate_id(),
+                        receivedAt = ctx.receivedAt] {
+                DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                if (!inventory) {
+                    return;
                 }
-                break;
-            
-            case k_EMsgGC_CC_CL2GC_NameBaseItem:
-                logger::info("Received NameBaseItem request");
-                {
-                    NetworkMessage netMsg(buffer.data(), msgsize);
-                    CMsgGC_CC_CL2GC_NameBaseItem request;
-                    if (netMsg.ParseTo(&request)) {
-                        uint64_t steamId = GetSessionSteamId(p2psocket);
-                        if (steamId != 0) {
-                            uint32_t defIndex = request.defindex();
-                            std::string name = request.name();
-                            
-                            logger::info("NameBaseItem: User %llu wants to create base item %u with name '%s'",
-                                        steamId, defIndex, name.c_str());
-                            
-                            bool success = GCNetwork_Inventory::HandleNameBaseItem(
-                                p2psocket, steamId, defIndex, name, m_mysql2);
-                        }
-                    }
+
+                bool success = GCNetwork_Inventory::HandleUnboxCrate(socket, steamId, crateItemId, receivedAt, inventory);
+
+                if (success) {
+                    logger::info("Successfully processed crate unlock for user %llu, crate %llu",
+                                steamId, crateItemId);
+                } else {
+                    logger::error("Failed to process crate unlock for user %llu, crate %llu",
+                                steamId, crateItemId);
                 }
-                break;
-            
-            case k_EMsgGC_CC_CL2GC_RemoveItemName:
-                logger::info("Received RemoveItemName request");
-                {
-                    NetworkMessage netMsg(buffer.data(), msgsize);
-                    CMsgGC_CC_CL2GC_RemoveItemName request;
-                    if (netMsg.ParseTo(&request)) {
-                        uint64_t steamId = GetSessionSteamId(p2psocket);
-                        if (steamId != 0) {
-                            uint64_t itemId = request.item_id();
-                            
-                            logger::info("RemoveItemName: User %llu wants to remove name from item %llu",
-                                        steamId, itemId);
-                            
-                            bool success = GCNetwork_Inventory::HandleRemoveItemName(
-                                p2psocket, steamId, itemId, m_mysql2);
-                        }
-                    }
+            });
+        });
+
+    d.Register<CMsgGC_CC_CL2GC_AdjustItemEquippedState>(k_EMsgGC_CC_CL2GC_AdjustItemEquippedState, "AdjustItemEquippedState", true,
+        [this](const MessageContext& ctx, CMsgGC_CC_CL2GC_AdjustItemEquippedState& request) {
+            logger::info("AdjustItemEquippedState: User %llu wants to equip item %llu in class %u slot %u",
+                        ctx.steamId, request.item_id(), request.new_class(), request.new_slot());
+
+            Defer(ctx, [this, socket = ctx.socket, steamId = ctx.steamId, itemId = request.item_id(),
+                        classId = request.new_class(), slotId = request.new_slot()] {
+                DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                if (!inventory) {
+                    return;
                 }
-                break;
-
-            case k_EMsgGC_CC_CL2GC_ApplySticker:
-                logger::info("Received ApplySticker request");
-                {
-                    NetworkMessage netMsg(buffer.data(), msgsize);
-                    CMsgGC_CC_CL2GC_ApplySticker request;
-                    if (netMsg.ParseTo(&request)) {
-                        uint64_t steamId = GetSessionSteamId(p2psocket);
-                        if (steamId != 0) {
-                            bool isApplying = request.has_sticker_item_id() && request.sticker_item_id() > 0;
-                            
-                            logger::info("ApplySticker: User %llu is %s sticker, item: %llu, sticker: %llu, slot: %u", 
-                                        steamId, 
-                                        isApplying ? "applying" : "scraping",
-                                        request.has_item_item_id() ? request.item_item_id() : 0,
-                                        request.has_sticker_item_id() ? request.sticker_item_id() : 0,
-                                        request.has_sticker_slot() ? request.sticker_slot() : 0);
-                            
-                            bool success = GCNetwork_Inventory::ProcessStickerAction(
-                                p2psocket, steamId, request, m_mysql2);
-                        }
-                    }
+
+                GCNetwork_Inventory::EquipItem(socket, steamId, itemId, classId, slotId, inventory);
+            });
+        });
+
+    d.Register<CMsgGC_CC_DeleteItem>(k_EMsgGC_CC_DeleteItem, "DeleteItem", true,
+        [this](const MessageContext& ctx, CMsgGC_CC_DeleteItem& request) {
+            Defer(ctx, [this, socket = ctx.socket, steamId = ctx.steamId, itemId = request.item_id()] {
+                DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                if (!inventory) {
+                    return;
                 }
-                break;
-
-
-
-            // OTHERS
-
-            /*case k_EMsgGC_CC_CL2GC_StorePurchaseInit:
-                logger::info("Received StorePurchaseInit request");
-                {
-                    NetworkMessage netMsg(buffer.data(), msgsize);
-                    CMsgGC_CC_CL2GC_StorePurchaseInit request;
-                    if (netMsg.ParseTo(&request)) {
-                        uint64_t steamId = GetSessionSteamId(p2psocket);
-                        if (steamId != 0) {
-                            logger::info("StorePurchaseInit: User %llu is making a purchase with %d items", 
-                                        steamId, request.line_items_size());
-                            
-                            bool success = GCNetwork_Inventory::HandleStorePurchaseInit(
-                                p2psocket, steamId, request, m_mysql2);
-                                
-                            if (success) {
-                                logger::info("Successfully processed store purchase for user %llu", steamId);
-                            } else {
-                                logger::error("Failed to process store purchase for user %llu", steamId);
-                            }
-                        } else {
-                            logger::error("StorePurchaseInit: No valid session for this socket");
-                        }
-                    } else {
-                        logger::error("StorePurchaseInit: Failed to parse request");
-                    }
+
+                GCNetwork_Inventory::DeleteItem(socket, steamId, itemId, inventory);
+            });
+        });
+
+    d.Register<CMsgGC_CC_CL2GC_NameItem>(k_EMsgGC_CC_CL2GC_NameItem, "NameItem", true,
+        [this](const MessageContext& ctx, CMsgGC_CC_CL2GC_NameItem& request) {
+            logger::info("NameItem: User %llu wants to name item %llu to '%s'",
+                        ctx.steamId, request.item_id(), request.name().c_str());
+
+            Defer(ctx, [this, socket = ctx.socket, steamId = ctx.steamId, itemId = request.item_id(), name = request.name()] {
+                DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                if (!inventory) {
+                    return;
                 }
-                break;*/
 
-            case k_EMsgGC_CC_CL2GC_ClientCommendPlayerQuery:
-                logger::info("Received commendation query request");
-                {
-                    uint64_t querySenderId = GetSessionSteamId(p2psocket);
-                    GCNetwork_Users::HandleCommendPlayerQuery(p2psocket, buffer.data(), msgsize, querySenderId, m_mysql2);
+                GCNetwork_Inventory::HandleNameItem(socket, steamId, itemId, name, inventory);
+            });
+        });
+
+    d.Register<CMsgGC_CC_CL2GC_NameBaseItem>(k_EMsgGC_CC_CL2GC_NameBaseItem, "NameBaseItem", true,
+        [this](const MessageContext& ctx, CMsgGC_CC_CL2GC_NameBaseItem& request) {
+            logger::info("NameBaseItem: User %llu wants to create base item %u with name '%s'",
+                        ctx.steamId, request.defindex(), request.name().c_str());
+
+            Defer(ctx, [this, socket = ctx.socket, steamId = ctx.steamId, defIndex = request.defindex(), name = request.name()] {
+                DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                if (!inventory) {
+                    return;
                 }
-                break;
-
-            case k_EMsgGC_CC_CL2GC_ClientCommendPlayer:
-                logger::info("Received commendation request");
-                {
-                    uint64_t senderSteamId = GetSessionSteamId(p2psocket);
-                    if (senderSteamId != 0) {
-                        GCNetwork_Users::HandleCommendPlayer(p2psocket, buffer.data(), msgsize, senderSteamId, m_mysql2);
-                    } else {
-                        logger::error("CommendPlayer: No valid session for this socket");
-                    }
+
+                GCNetwork_Inventory::HandleNameBaseItem(socket, steamId, defIndex, name, inventory);
+            });
+        });
+
+    d.Register<CMsgGC_CC_CL2GC_RemoveItemName>(k_EMsgGC_CC_CL2GC_RemoveItemName, "RemoveItemName", true,
+        [this](const MessageContext& ctx, CMsgGC_CC_CL2GC_RemoveItemName& request) {
+            logger::info("RemoveItemName: User %llu wants to remove name from item %llu",
+                        ctx.steamId, request.item_id());
+
+            Defer(ctx, [this, socket = ctx.socket, steamId = ctx.steamId, itemId = request.item_id()] {
+                DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                if (!inventory) {
+                    return;
                 }
-                break;
-                
-            case k_EMsgGC_CC_CL2GC_ClientReportPlayer:
-                logger::info("Received player report request");
-                {
-                    uint64_t senderSteamId = GetSessionSteamId(p2psocket);
-                    if (senderSteamId != 0) {
-                        GCNetwork_Users::HandlePlayerReport(p2psocket, buffer.data(), msgsize, senderSteamId, m_mysql2);
-                    } else {
-                        logger::error("ReportPlayer: No valid session for this socket");
-                    }
+
+                GCNetwork_Inventory::HandleRemoveItemName(socket, steamId, itemId, inventory);
+            });
+        });
+
+    d.Register<CMsgGC_CC_CL2GC_ApplySticker>(k_EMsgGC_CC_CL2GC_ApplySticker, "ApplySticker", true,
+        [this](const MessageContext& ctx, CMsgGC_CC_CL2GC_ApplySticker& request) {
+            bool isApplying = request.has_sticker_item_id() && request.sticker_item_id() > 0;
+
+            logger::info("ApplySticker: User %llu is %s sticker, item: %llu, sticker: %llu, slot: %u",
+                        ctx.steamId,
+                        isApplying ? "applying" : "scraping",
+                        request.has_item_item_id() ? request.item_item_id() : 0,
+                        request.has_sticker_item_id() ? request.sticker_item_id() : 0,
+                        request.has_sticker_slot() ? request.sticker_slot() : 0);
+
+            Defer(ctx, [this, socket = ctx.socket, steamId = ctx.steamId, request = std::move(request)] {
+                DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                if (!inventory) {
+                    return;
                 }
-                break;
-
-            case k_EMsgGC_CC_CL2GC_ViewPlayersProfileRequest:
-                logger::info("Received view profile request");
-                GCNetwork_Users::ViewPlayersProfile(p2psocket, buffer.data(), msgsize, m_mysql1, m_mysql2, m_mysql3);
-                break;
-
-            // MATCHMAKING MESSAGES
-            // DISABLED: Matchmaking
-            /*case k_EMsgGCCStrike15_v2_MatchmakingClient2GCHello:
-                logger::info("Received MatchmakingClient2GCHello");
-                {
-                    uint64_t steamId = GetSessionSteamId(p2psocket);
-                    if (steamId != 0) {
-                        GCNetwork_Matchmaking::HandleMatchmakingClient2GCHello(p2psocket, buffer.data(), msgsize, steamId, m_mysql3);
-                    } else {
-                        logger::error("MatchmakingClient2GCHello: No valid session for this socket");
-                    }
+
+                GCNetwork_Inventory::ProcessStickerAction(socket, steamId, request, inventory);
+            });
+        });
+
+    // OTHERS
+
+    /*d.Register<CMsgGC_CC_CL2GC_StorePurchaseInit>(k_EMsgGC_CC_CL2GC_StorePurchaseInit, "StorePurchaseInit", true,
+        [this](const MessageContext& ctx, CMsgGC_CC_CL2GC_StorePurchaseInit& request) {
+            logger::info("StorePurchaseInit: User %llu is making a purchase with %d items",
+                        ctx.steamId, request.line_items_size());
+
+            Defer(ctx, [this, socket = ctx.socket, steamId = ctx.steamId, request = std::move(request)] {
+                DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                if (!inventory) {
+                    return;
                 }
-                break;*/
-
-            /*case k_EMsgGCCStrike15_v2_MatchmakingStart:
-                logger::info("Received MatchmakingStart");
-                {
-                    uint64_t steamId = GetSessionSteamId(p2psocket);
-                    if (steamId != 0) {
-                        GCNetwork_Matchmaking::HandleMatchmakingStart(p2psocket, buffer.data(), msgsize, steamId, m_mysql3);
-                    } else {
-                        logger::error("MatchmakingStart: No valid session for this socket");
-                    }
+
+                if (GCNetwork_Inventory::HandleStorePurchaseInit(socket, steamId, request, inventory)) {
+                    logger::info("Successfully processed store purchase for user %llu", steamId);
+                } else {
+                    logger::error("Failed to process store purchase for user %llu", steamId);
                 }
-                break;*/
-
-            /*case k_EMsgGCCStrike15_v2_MatchmakingStop:
-                logger::info("Received MatchmakingStop");
-                {
-                    uint64_t steamId = GetSessionSteamId(p2psocket);
-                    if (steamId != 0) {
-                        GCNetwork_Matchmaking::HandleMatchmakingStop(p2psocket, buffer.data(), msgsize, steamId);
-                    } else {
-                        logger::error("MatchmakingStop: No valid session for this socket");
-                    }
+            });
+        });*/
+
+    d.Register<CMsgGC_CC_ClientCommendPlayer>(k_EMsgGC_CC_CL2GC_ClientCommendPlayerQuery, "ClientCommendPlayerQuery", false,
+        [this](const MessageContext& ctx, CMsgGC_CC_ClientCommendPlayer& request) {
+            Defer(ctx, [this, socket = ctx.socket, steamId = ctx.steamId, request = std::move(request)] {
+                DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                if (!inventory) {
+                    return;
                 }
-                break;*/
-
-            // Matchmaking accept/decline temporarily disabled - enum values not in current protobuf schema
-            // case k_EMsgGCCStrike15_v2_MatchmakingClient2GCAccept:
-            // case k_EMsgGCCStrike15_v2_MatchmakingClient2GCDecline:
-
-            /*case k_EMsgGCCStrike15_v2_MatchmakingServerMatchEnd:
-                logger::info("Received MatchmakingServerMatchEnd");
-                {
-                    uint64_t steamId = GetSessionSteamId(p2psocket);
-                    if (steamId != 0) {
-                        GCNetwork_Matchmaking::HandleMatchEnd(p2psocket, buffer.data(), msgsize, steamId, m_mysql3);
-                    } else {
-                        logger::error("MatchEnd: No valid session for this socket");
-                    }
+
+                GCNetwork_Users::HandleCommendPlayerQuery(socket, request, steamId, inventory);
+            });
+        });
+
+    d.Register<CMsgGC_CC_ClientCommendPlayer>(k_EMsgGC_CC_CL2GC_ClientCommendPlayer, "ClientCommendPlayer", true,
+        [this](const MessageContext& ctx, CMsgGC_CC_ClientCommendPlayer& request) {
+            Defer(ctx, [this, socket = ctx.socket, steamId = ctx.steamId, request = std::move(request)] {
+                DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                if (!inventory) {
+                    return;
                 }
-                break;*/
-
-            /*case k_EMsgGCCStrike15_v2_MatchmakingServerRoundStats:
-                logger::info("Received MatchmakingServerRoundStats");
-                {
-                    uint64_t steamId = GetSessionSteamId(p2psocket);
-                    if (steamId != 0) {
-                        GCNetwork_Matchmaking::HandleMatchRoundStats(p2psocket, buffer.data(), msgsize, steamId);
-                    } else {
-                        logger::error("RoundStats: No valid session for this socket");
-                    }
+
+                GCNetwork_Users::HandleCommendPlayer(socket, request, steamId, inventory);
+            });
+        });
+
+    d.Register<CMsgGC_CC_CL2GC_ClientReportPlayer>(k_EMsgGC_CC_CL2GC_ClientReportPlayer, "ClientReportPlayer", true,
+        [this](const MessageContext& ctx, CMsgGC_CC_CL2GC_ClientReportPlayer& request) {
+            Defer(ctx, [this, socket = ctx.socket, steamId = ctx.steamId, request = std::move(request)] {
+                DatabasePool::Connection inventory = m_inventoryDb->Acquire();
+                if (!inventory) {
+                    return;
                 }
-                break;*/
 
-            default:
-                logger::error("Unknown message type: %u", real_type);
-                break;
+                GCNetwork_Users::HandlePlayerReport(socket, request, steamId, inventory);
+            });
+        });
+
+    d.Register<CMsgGC_CC_CL2GC_ViewPlayersProfileRequest>(k_EMsgGC_CC_CL2GC_ViewPlayersProfileRequest, "ViewPlayersProfileRequest", false,
+        [this](const MessageContext& ctx, CMsgGC_CC_CL2GC_ViewPlayersProfileRequest& request) {
+            GCNetwork_Users::ViewPlayersProfile(ctx.socket, request, m_asyncInventory, m_asyncRanked);
+        });
+
+    // MATCHMAKING MESSAGES
+    // DISABLED: Matchmaking, these handlers still take the raw frame and would
+    // have to copy it before being deferred to a worker
+    /*d.RegisterRaw(k_EMsgGCCStrike15_v2_MatchmakingClient2GCHello, "MatchmakingClient2GCHello", true,
+        [this](const MessageContext& ctx) {
+            GCNetwork_Matchmaking::HandleMatchmakingClient2GCHello(ctx.socket, (void*)ctx.data, ctx.size, ctx.steamId, m_rankedDb->Acquire());
+        });
+
+    d.RegisterRaw(k_EMsgGCCStrike15_v2_MatchmakingStart, "MatchmakingStart", true,
+        [this](const MessageContext& ctx) {
+            GCNetwork_Matchmaking::HandleMatchmakingStart(ctx.socket, (void*)ctx.data, ctx.size, ctx.steamId, m_rankedDb->Acquire());
+        });
+
+    d.RegisterRaw(k_EMsgGCCStrike15_v2_MatchmakingStop, "MatchmakingStop", true,
+        [](const MessageContext& ctx) {
+            GCNetwork_Matchmaking::HandleMatchmakingStop(ctx.socket, (void*)ctx.data, ctx.size, ctx.steamId);
+        });
+
+    // Matchmaking accept/decline temporarily disabled - enum values not in current protobuf schema
+    // k_EMsgGCCStrike15_v2_MatchmakingClient2GCAccept
+    // k_EMsgGCCStrike15_v2_MatchmakingClient2GCDecline
+
+    d.RegisterRaw(k_EMsgGCCStrike15_v2_MatchmakingServerMatchEnd, "MatchmakingServerMatchEnd", true,
+        [this](const MessageContext& ctx) {
+            GCNetwork_Matchmaking::HandleMatchEnd(ctx.socket, (void*)ctx.data, ctx.size, ctx.steamId, m_rankedDb->Acquire());
+        });
+
+    d.RegisterRaw(k_EMsgGCCStrike15_v2_MatchmakingServerRoundStats, "MatchmakingServerRoundStats", true,
+        [](const MessageContext& ctx) {
+            GCNetwork_Matchmaking::HandleMatchRoundStats(ctx.socket, (void*)ctx.data, ctx.size, ctx.steamId);
+        });*/
+}
+
+size_t GCNetwork::Update() 
+{
+    SNetSocket_t p2psocket;
+    uint32_t msgsize;
+    size_t handled = 0;
+
+    while (SteamGameServerNetworking()->IsDataAvailable(listen_socket, &msgsize, &p2psocket)) {
+        if (msgsize > m_maxMessageSize) {
+            // a partial read still takes the message off the socket
+            uint8_t discard[sizeof(uint32_t)];
+            SteamGameServerNetworking()->RetrieveDataFromSocket(p2psocket, discard, sizeof(discard), &msgsize);
+            logger::warning("Dropping %u byte message, limit is %u", msgsize, m_maxMessageSize);
+            continue;
+        }
+
+        BufferPool::Buffer buffer = m_receiveBuffers.Acquire(msgsize);
+
+        if (!SteamGameServerNetworking()->RetrieveDataFromSocket(
+            p2psocket, buffer->data(), msgsize, &msgsize)) {
+            continue;
+        }
+        handled++;
+
+        if (msgsize < sizeof(uint32_t)) {
+            logger::error("Dropping %u byte message, too small for a type", msgsize);
+            continue;
         }
+
+        // get raw 32-bit type
+        uint32_t raw_type;
+        memcpy(&raw_type, buffer->data(), sizeof(uint32_t));
+
+        // unmask dat bitch
+        uint32_t real_type = raw_type & ~CCProtoMask;
+
+        logger::info("Received message - Raw: %08X, Unmasked: %u (0x%X)", 
+                    raw_type, real_type, real_type);
+
+        MessageContext context;
+        context.socket = p2psocket;
+        context.steamId = GetSessionSteamId(p2psocket);
+        context.type = real_type;
+        context.data = buffer->data();
+        context.size = msgsize;
+        context.receivedAt = MessageDispatcher::Clock::now();
+
+        m_dispatcher.Dispatch(context);
     }
+
+    return handled;
 }
 
 // WHITELIST DISABLED - Function no longer used
@@ -779,14 +1106,14 @@ void GCNetwork::SocketStatusCallback(SocketStatusCallback_t* pParam)
     if (it != m_activeSessions.end()) 
     {
         // update session
-        it->second.socket = pParam->m_hSocket;
+        BindSessionSocket(it->second, pParam->m_hSocket);
         it->second.updateActivity();
     }
     else
     {
         // create session
         ClientSessions newSession(pParam->m_steamIDRemote);
-        newSession.socket = pParam->m_hSocket;
-        m_activeSessions.insert(std::make_pair(steamId, newSession));
+        auto inserted = m_activeSessions.insert(std::make_pair(steamId, newSession));
+        BindSessionSocket(inserted.first->second, pParam->m_hSocket);
     }
 }
\ No newline at end of file
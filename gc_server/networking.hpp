@@ -3,15 +3,31 @@
 
 #include "steam/steam_api.h"
 #include <mariadb/mysql.h>
+#include "cc_gcmessages.pb.h"
 
+#include <atomic>
+#include <chrono>
 #include <ctime> // time_t
 #include <map> // std::map
+#include <memory>
+#include <unordered_map>
 
 #include "networking_users.hpp"
+#include "item_event_feed.hpp"
+#include "timer_scheduler.hpp"
+#include "message_dispatcher.hpp"
+#include "worker_pool.hpp"
+#include "db_pool.hpp"
+#include "async_db.hpp"
+#include "ban_index.hpp"
+#include "buffer_pool.hpp"
 
 constexpr int NetMessageSendFlags = 8; //k_nSteamNetworkingSend_Reliable
 constexpr int NetMessageChannel = 7;
 
+// client messages are small, GC_MAX_MESSAGE_SIZE overrides
+constexpr uint32_t DefaultMaxMessageSize = 64 * 1024;
+
 class ClientSessions {
 	public:
 		CSteamID steamID;
@@ -44,16 +60,68 @@ private:
 
 	// client sessions
 	std::map<uint64, ClientSessions> m_activeSessions;
+	std::unordered_map<SNetSocket_t, uint64> m_socketSessions;
 	uint64_t GetSessionSteamId(SNetSocket_t socket);
+	void BindSessionSocket(ClientSessions& session, SNetSocket_t socket);
+
+	// message handlers
+	MessageDispatcher m_dispatcher;
+	void RegisterHandlers();
+
+	// db connection pools
+	std::unique_ptr<DatabasePool> m_classiccounterDb;
+	std::unique_ptr<DatabasePool> m_inventoryDb;
+	std::unique_ptr<DatabasePool> m_rankedDb;
+
+	// non-blocking connections for lookups that fan out, owned by m_asyncDb
+	AsyncQueryEngine m_asyncDb;
+	AsyncDatabase* m_asyncInventory = nullptr;
+	AsyncDatabase* m_asyncRanked = nullptr;
 
-	// db connections
-	MYSQL* m_mysql1; // classiccounter
-	MYSQL* m_mysql2; // inventory
-	MYSQL* m_mysql3; // ranked
+	// db-bound handlers, one strand per player
+	WorkerPool m_workers;
+	void Defer(const MessageContext& context, WorkerPool::Task job);
 	
 	// matchmaking
 	class MatchmakingManager* m_matchmakingManager;
 
+	// batched new item poller, only touched from the SystemStrand
+	uint64_t m_itemWatermark = 0;
+	bool m_itemWatermarkReady = false;
+	bool EnsureItemWatermark(MYSQL* inventory_db);
+
+	// how far the poller (item id) or the feed (event id) got, published by the
+	// SystemStrand; a login replays from the value it saw before loading the inventory
+	std::atomic<uint64_t> m_itemCursor{0};
+	void ReplayItems(uint64_t steamId, SNetSocket_t socket, uint64_t lastItemId, uint64_t replayFrom);
+
+	// outbox change feed, replaces the poller once its schema is installed
+	ItemEventFeed m_itemFeed; // SystemStrand only
+	std::atomic<bool> m_itemFeedActive{false};
+	bool m_itemFeedQueued = false;
+	void StartItemFeed(MYSQL* inventory_db);
+	void PollItemEvents();
+
+	// permanent bans and cooldowns of classiccounter, refreshed on the SystemStrand
+	BanIndex m_banIndex;
+	bool m_banIndexQueued = false;
+	void RefreshBanIndex();
+
+	// applies WriteBehindQueue batches on the SystemStrand
+	bool m_writeBehindQueued = false;
+	void FlushWriteBehind();
+
+	std::vector<ItemWatch> SnapshotItemWatches();
+	void ApplyItemWatches(const std::vector<ItemWatch>& watches);
+
+	// inbound frames are read into pooled buffers, anything above the limit is dropped
+	BufferPool m_receiveBuffers{"receive"};
+	uint32_t m_maxMessageSize = DefaultMaxMessageSize;
+
+	// periodic jobs, driven by Run()
+	TimerScheduler m_scheduler;
+	void SchedulePeriodicJobs(std::chrono::milliseconds callbackInterval);
+
 	// whitelist - DISABLED (all Steam-authenticated users allowed)
 	// bool m_maintenanceMode = false;
     // std::vector<uint64_t> m_maintenanceAllowlist = {};
@@ -62,16 +130,24 @@ private:
 public:
 	GCNetwork();
 	~GCNetwork();
-	void Init(const char* bind_ip = "0.0.0.0", uint16 port = 21818);
-	void Update();
+	void Init(const char* bind_ip = "0.0.0.0", uint16 port = 21818, size_t workerThreads = 4);
+
+	// event loop, returns once EventLoop::Stop() is called
+	void Run(std::chrono::milliseconds callbackInterval, std::chrono::milliseconds pollInterval);
+	// drains pending socket data, returns the number of messages handled
+	size_t Update();
 
-    void ReadAuthTicket(SNetSocket_t p2psocket, void* message, uint32 msgsize, 
-		MYSQL* classiccounter_db, MYSQL* inventory_db, MYSQL* ranked_db);
+    void ReadAuthTicket(SNetSocket_t p2psocket, const CMsgGC_CC_GCWelcome& welcomeMsg);
 	
 	// db methods
-	bool InitDatabases();
+	bool InitDatabases(size_t workerThreads);
 	bool ExecuteQuery(MYSQL* connection, const char* query);
+	// end of Run, again from the destructor if Run never got that far
 	void CloseDatabases();
+	bool m_databasesClosed = false;
+
+	// --rebuild-counters, recomputes the commend counters and exits
+	static bool RebuildCounters();
 
 	// client sessions
 	void CleanupSessions();
@@ -3,6 +3,14 @@
 #include "gc_const_csgo.hpp"
 #include "keyvalue_english.hpp"
 #include "logger.hpp"
+#include "db_statements.hpp"
+#include "inventory_cache.hpp"
+#include "profile_cache.hpp"
+#include "item_blob_cache.hpp"
+#include "write_behind.hpp"
+#include "latency_histogram.hpp"
+#include "request_arena.hpp"
+#include "socache_encoder.hpp"
 #include "gcsystemmsgs.pb.h"
 #include "econ_gcmessages.pb.h"
 #include <ctime>
@@ -13,9 +21,107 @@
 #include <regex>
 #include <cstdlib>
 #include <cctype>
+#include <algorithm>
+#include <map>
+#include <optional>
 
 ItemSchema *g_itemSchema = nullptr;
 
+// column list shared by every query that builds a CSOEconItem, see ItemRow
+#define ITEM_COLUMNS                                         \
+    "id, item_id, floatval, rarity, quality, tradable, "     \
+    "stattrak, stattrak_kills, "                             \
+    "sticker_1, sticker_1_wear, sticker_2, sticker_2_wear, " \
+    "sticker_3, sticker_3_wear, sticker_4, sticker_4_wear, " \
+    "sticker_5, sticker_5_wear, nametag, pattern_index, "    \
+    "equipped_ct, equipped_t, acknowledged, acquired_by, "   \
+    "def_index, paint_index, item_kind, row_version"
+
+#define ITEM_SELECT_COLUMNS "SELECT " ITEM_COLUMNS " FROM csgo_items "
+
+static constexpr char SqlSelectItemsByOwner[] =
+    ITEM_SELECT_COLUMNS "WHERE owner_account_id = ?";
+
+static constexpr char SqlSelectItemById[] =
+    ITEM_SELECT_COLUMNS "WHERE id = ? AND owner_account_id = ?";
+
+// new items of every owner, routed to online sessions in memory
+static constexpr char SqlSelectNewItems[] =
+    "SELECT " ITEM_COLUMNS ", owner_account_id FROM csgo_items WHERE id > ? ORDER BY id ASC LIMIT ?";
+
+static constexpr char SqlSelectLatestItemIdGlobal[] =
+    "SELECT MAX(id) FROM csgo_items";
+
+#define ID_PARAMS_16 "?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?"
+
+// fixed arity so it can be prepared once, unused slots are bound to 0
+constexpr size_t ItemsByIdBatch = 16;
+static constexpr char SqlSelectItemsByIds[] =
+    "SELECT " ITEM_COLUMNS ", owner_account_id FROM csgo_items "
+    "WHERE id IN (" ID_PARAMS_16 ")";
+
+// wider variant for acknowledgements, a whole drop burst is read back in one query
+constexpr size_t AcknowledgeBatch = 64;
+static constexpr char SqlSelectAcknowledgedItems[] =
+    ITEM_SELECT_COLUMNS "WHERE owner_account_id = ? AND id IN ("
+    ID_PARAMS_16 ", " ID_PARAMS_16 ", " ID_PARAMS_16 ", " ID_PARAMS_16 ")";
+
+static constexpr char SqlSelectLatestItemId[] =
+    "SELECT MAX(id) FROM csgo_items WHERE owner_account_id = ?";
+
+// crate opening, request to reply and the DELETE + INSERT transaction on its own
+static LatencyHistogram s_unboxLatency;
+static LatencyHistogram s_unboxTransactionLatency;
+
+MYSQL_BIND *ItemRow::Bind()
+{
+    memset(binds, 0, sizeof(binds));
+
+    int column = 0;
+    auto bind = [&](enum_field_types type, void *buffer, unsigned long size)
+    {
+        MYSQL_BIND &b = binds[column];
+        b.buffer_type = type;
+        b.buffer = buffer;
+        b.buffer_length = size;
+        b.is_null = &isNull[column];
+        b.length = &lengths[column];
+        column++;
+    };
+
+    bind(MYSQL_TYPE_LONGLONG, &id, sizeof(id));
+    binds[0].is_unsigned = 1;
+    bind(MYSQL_TYPE_STRING, itemId, sizeof(itemId));
+    bind(MYSQL_TYPE_FLOAT, &floatval, sizeof(floatval));
+    bind(MYSQL_TYPE_LONG, &rarity, sizeof(rarity));
+    bind(MYSQL_TYPE_LONG, &quality, sizeof(quality));
+    bind(MYSQL_TYPE_LONG, &tradable, sizeof(tradable));
+    bind(MYSQL_TYPE_LONG, &stattrak, sizeof(stattrak));
+    bind(MYSQL_TYPE_LONG, &stattrakKills, sizeof(stattrakKills));
+    for (int i = 0; i < 5; i++)
+    {
+        bind(MYSQL_TYPE_LONG, &stickers[i], sizeof(stickers[i]));
+        bind(MYSQL_TYPE_FLOAT, &stickerWear[i], sizeof(stickerWear[i]));
+    }
+    bind(MYSQL_TYPE_STRING, nametag, sizeof(nametag));
+    bind(MYSQL_TYPE_LONG, &patternIndex, sizeof(patternIndex));
+    bind(MYSQL_TYPE_LONG, &equippedCt, sizeof(equippedCt));
+    bind(MYSQL_TYPE_LONG, &equippedT, sizeof(equippedT));
+    bind(MYSQL_TYPE_LONG, &acknowledged, sizeof(acknowledged));
+    bind(MYSQL_TYPE_STRING, acquiredBy, sizeof(acquiredBy));
+    bind(MYSQL_TYPE_LONG, &defIndex, sizeof(defIndex));
+    bind(MYSQL_TYPE_LONG, &paintIndex, sizeof(paintIndex));
+    bind(MYSQL_TYPE_TINY, &itemKind, sizeof(itemKind));
+    bind(MYSQL_TYPE_LONG, &rowVersion, sizeof(rowVersion));
+    bind(MYSQL_TYPE_LONG, &ownerAccountId, sizeof(ownerAccountId));
+    for (int i = 24; i < ColumnCount; i++)
+    {
+        binds[i].is_unsigned = 1;
+    }
+
+    return binds;
+}
+
 bool GCNetwork_Inventory::Init()
 {
     if (g_itemSchema != nullptr)
@@ -140,28 +246,21 @@ bool GCNetwork_Inventory::ParseItemId(const std::string &item_id, uint32_t &def_
  * @param row MySQL row containing sticker data
  * @param sticker_index Index of the sticker position (0-4)
  */
-void GCNetwork_Inventory::AddStickerAttributes(CSOEconItem *item, MYSQL_ROW &row, int sticker_index)
+void GCNetwork_Inventory::AddStickerAttributes(CSOEconItem *item, const ItemRow &row, int sticker_index)
 {
     int sticker_col = 8 + (sticker_index * 2);
     int sticker_wear_col = sticker_col + 1;
 
-    if (row[sticker_col] && atoi(row[sticker_col]) > 0)
+    if (!row.isNull[sticker_col] && row.stickers[sticker_index] > 0)
     {
         uint32_t sticker_id_attr = 113 + (sticker_index * 4);
         uint32_t sticker_wear_attr = sticker_id_attr + 1;
 
         // sticker_id
-        AddUint32Attribute(item, sticker_id_attr, atoi(row[sticker_col]));
+        AddUint32Attribute(item, sticker_id_attr, row.stickers[sticker_index]);
 
         // sticker_wear
-        if (row[sticker_wear_col] && strlen(row[sticker_wear_col]) > 0)
-        {
-            AddFloatAttribute(item, sticker_wear_attr, std::stof(row[sticker_wear_col]));
-        }
-        else
-        {
-            AddFloatAttribute(item, sticker_wear_attr, 0.0f);
-        }
+        AddFloatAttribute(item, sticker_wear_attr, row.isNull[sticker_wear_col] ? 0.0f : row.stickerWear[sticker_index]);
     }
 }
 
@@ -409,86 +508,29 @@ std::vector<uint32_t> GCNetwork_Inventory::GetDefindexFromItemSlot(uint32_t slot
  */
 void GCNetwork_Inventory::SendSOCache(SNetSocket_t p2psocket, uint64_t steamId, MYSQL *inventory_db)
 {
-    CMsgSOCacheSubscribed cacheMsg;
+    // every object is serialized once, straight into the send buffer, see SOCacheEncoder.
+    // Helper messages live on the thread's arena and are dropped in one go
+    RequestArena arena;
+    SOCacheEncoder encoder(steamId, InventoryVersion);
 
-    cacheMsg.set_version(InventoryVersion);
-    cacheMsg.mutable_owner_soid()->set_type(SoIdTypeSteamId);
-    cacheMsg.mutable_owner_soid()->set_id(steamId);
+    // CSOEconItem, the inventory itself is added at the end so cached items are only
+    // referenced while the player's lock is held
+    size_t itemType = encoder.AddType(SOTypeItem);
 
-    // CSOEconItem
+    // everyone gets a nametag
     {
-        CMsgSOCacheSubscribed_SubscribedType *object = cacheMsg.add_objects();
-        object->set_type_id(SOTypeItem);
-
-        // everyone gets a nametag
-        {
-            auto nametag = CSOEconItem();
-            nametag.set_id(1);
-            nametag.set_account_id(steamId & 0xFFFFFFFF);
-            nametag.set_def_index(1200);
-            nametag.set_inventory(1);
-            nametag.set_level(1);
-            nametag.set_quality(0);
-            nametag.set_flags(0);
-            nametag.set_origin(kEconItemOrigin_Purchased);
-            nametag.set_rarity(1);
-
-            object->add_object_data(nametag.SerializeAsString());
-        }
-
-        char query[1024];
-        snprintf(query, sizeof(query),
-                 "SELECT id, item_id, floatval, rarity, quality, tradable, "
-                 "stattrak, stattrak_kills, "
-                 "sticker_1, sticker_1_wear, sticker_2, sticker_2_wear, "
-                 "sticker_3, sticker_3_wear, sticker_4, sticker_4_wear, "
-                 "sticker_5, sticker_5_wear, nametag, pattern_index, "
-                 "equipped_ct, equipped_t, acknowledged, acquired_by "
-                 "FROM csgo_items "
-                 "WHERE owner_steamid2 = '%s'",
-                 GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
-
-        logger::info("SendSOCache: Executing query: %s", query);
-
-        if (mysql_query(inventory_db, query) != 0)
-        {
-            logger::error("SendSOCache: MySQL query failed: %s", mysql_error(inventory_db));
-            return;
-        }
-
-        MYSQL_RES *result = mysql_store_result(inventory_db);
-        if (!result)
-        {
-            logger::error("SendSOCache: Failed to store MySQL result");
-            return;
-        }
-
-        MYSQL_ROW row;
-        while ((row = mysql_fetch_row(result)))
-        {
-            if (!row[1])
-            {
-                logger::error("SendSOCache: Item ID is NULL in database row");
-                continue;
-            }
+        CSOEconItem *nametag = arena.Create<CSOEconItem>();
+        nametag->set_id(1);
+        nametag->set_account_id(steamId & 0xFFFFFFFF);
+        nametag->set_def_index(1200);
+        nametag->set_inventory(1);
+        nametag->set_level(1);
+        nametag->set_quality(0);
+        nametag->set_flags(0);
+        nametag->set_origin(kEconItemOrigin_Purchased);
+        nametag->set_rarity(1);
 
-            try
-            {
-                CSOEconItem *item = CreateItemFromDatabaseRow(steamId, row);
-                if (item)
-                {
-                    object->add_object_data(item->SerializeAsString());
-                    delete item; // Clean up
-                }
-            }
-            catch (const std::exception &e)
-            {
-                logger::error("SendSOCache: Exception while processing item: %s", e.what());
-                continue;
-            }
-        }
-
-        mysql_free_result(result);
+        encoder.AddObject(itemType, *nametag);
     }
 
     // SOTypeDefaultEquippedDefinitionInstanceClient
@@ -524,8 +566,7 @@ void GCNetwork_Inventory::SendSOCache(SNetSocket_t p2psocket, uint64_t steamId,
         }
 
         {
-            CMsgSOCacheSubscribed_SubscribedType *object = cacheMsg.add_objects();
-            object->set_type_id(SOTypeDefaultEquippedDefinitionInstanceClient);
+            size_t equipType = encoder.AddType(SOTypeDefaultEquippedDefinitionInstanceClient);
 
             MYSQL_ROW default_equips_row = mysql_fetch_row(default_equips_result);
             if (default_equips_row)
@@ -535,71 +576,65 @@ void GCNetwork_Inventory::SendSOCache(SNetSocket_t p2psocket, uint64_t steamId,
                 // USP-S for CT (def_index 61, slot 2)
                 if (atoi(default_equips_row[1]) == 1) // default_usp_ct
                 {
-                    auto defaultEquip = new CSOEconDefaultEquippedDefinitionInstanceClient();
+                    auto defaultEquip = arena.Create<CSOEconDefaultEquippedDefinitionInstanceClient>();
                     defaultEquip->set_account_id(account_id);
                     defaultEquip->set_item_definition(61);
                     defaultEquip->set_class_id(CLASS_CT);
                     defaultEquip->set_slot_id(2);
-                    object->add_object_data(defaultEquip->SerializeAsString());
-                    delete defaultEquip;
+                    encoder.AddObject(equipType, *defaultEquip);
                 }
 
                 // M4A1-S for CT (def_index 60, slot 15)
                 if (atoi(default_equips_row[2]) == 1) // default_m4a1s_ct
                 {
-                    auto defaultEquip = new CSOEconDefaultEquippedDefinitionInstanceClient();
+                    auto defaultEquip = arena.Create<CSOEconDefaultEquippedDefinitionInstanceClient>();
                     defaultEquip->set_account_id(account_id);
                     defaultEquip->set_item_definition(60);
                     defaultEquip->set_class_id(CLASS_CT);
                     defaultEquip->set_slot_id(15);
-                    object->add_object_data(defaultEquip->SerializeAsString());
-                    delete defaultEquip;
+                    encoder.AddObject(equipType, *defaultEquip);
                 }
 
                 // R8 Revolver
                 if (atoi(default_equips_row[3]) == 1) // default_r8_ct
                 {
-                    auto defaultEquip = new CSOEconDefaultEquippedDefinitionInstanceClient();
+                    auto defaultEquip = arena.Create<CSOEconDefaultEquippedDefinitionInstanceClient>();
                     defaultEquip->set_account_id(account_id);
                     defaultEquip->set_item_definition(64);
                     defaultEquip->set_class_id(CLASS_CT);
                     defaultEquip->set_slot_id(6);
-                    object->add_object_data(defaultEquip->SerializeAsString());
-                    delete defaultEquip;
+                    encoder.AddObject(equipType, *defaultEquip);
                 }
 
                 if (atoi(default_equips_row[4]) == 1) // default_r8_t
                 {
-                    auto defaultEquip = new CSOEconDefaultEquippedDefinitionInstanceClient();
+                    auto defaultEquip = arena.Create<CSOEconDefaultEquippedDefinitionInstanceClient>();
                     defaultEquip->set_account_id(account_id);
                     defaultEquip->set_item_definition(64);
                     defaultEquip->set_class_id(CLASS_T);
                     defaultEquip->set_slot_id(6);
-                    object->add_object_data(defaultEquip->SerializeAsString());
-                    delete defaultEquip;
+                    encoder.AddObject(equipType, *defaultEquip);
                 }
 
                 // CZ75-Auto
                 if (atoi(default_equips_row[5]) == 1) // default_cz75_ct
                 {
-                    auto defaultEquip = new CSOEconDefaultEquippedDefinitionInstanceClient();
+                    auto defaultEquip = arena.Create<CSOEconDefaultEquippedDefinitionInstanceClient>();
                     defaultEquip->set_account_id(account_id);
                     defaultEquip->set_item_definition(63);
                     defaultEquip->set_class_id(CLASS_CT);
                     defaultEquip->set_slot_id(5);
-                    object->add_object_data(defaultEquip->SerializeAsString());
-                    delete defaultEquip;
+                    encoder.AddObject(equipType, *defaultEquip);
                 }
 
                 if (atoi(default_equips_row[6]) == 1) // default_cz75_t
                 {
-                    auto defaultEquip = new CSOEconDefaultEquippedDefinitionInstanceClient();
+                    auto defaultEquip = arena.Create<CSOEconDefaultEquippedDefinitionInstanceClient>();
                     defaultEquip->set_account_id(account_id);
                     defaultEquip->set_item_definition(63);
                     defaultEquip->set_class_id(CLASS_T);
                     defaultEquip->set_slot_id(5);
-                    object->add_object_data(defaultEquip->SerializeAsString());
-                    delete defaultEquip;
+                    encoder.AddObject(equipType, *defaultEquip);
                 }
             }
         }
@@ -609,47 +644,82 @@ void GCNetwork_Inventory::SendSOCache(SNetSocket_t p2psocket, uint64_t steamId,
 
     // PersonaData
     {
-        CSOPersonaDataPublic personaData;
-        personaData.set_player_level(1); // todo: fetch from db
-        personaData.set_elevated_state(true);
+        CSOPersonaDataPublic *personaData = arena.Create<CSOPersonaDataPublic>();
+        personaData->set_player_level(1); // todo: fetch from db
+        personaData->set_elevated_state(true);
 
-        CMsgSOCacheSubscribed_SubscribedType *object = cacheMsg.add_objects();
-        object->set_type_id(SOTypePersonaDataPublic);
-        object->add_object_data(personaData.SerializeAsString());
+        encoder.AddObject(encoder.AddType(SOTypePersonaDataPublic), *personaData);
     }
 
     // GameAccountClient (if (!server))
     {
-        CSOEconGameAccountClient accountClient;
-        accountClient.set_additional_backpack_slots(0);
-        accountClient.set_bonus_xp_timestamp_refresh(static_cast<uint32_t>(time(nullptr)));
-        accountClient.set_bonus_xp_usedflags(16); // caught cheater lobbies, overwatch bonus etc
-        accountClient.set_elevated_state(ElevatedStatePrime);
-        accountClient.set_elevated_timestamp(ElevatedStatePrime); // is this actually 5???
+        CSOEconGameAccountClient *accountClient = arena.Create<CSOEconGameAccountClient>();
+        accountClient->set_additional_backpack_slots(0);
+        accountClient->set_bonus_xp_timestamp_refresh(static_cast<uint32_t>(time(nullptr)));
+        accountClient->set_bonus_xp_usedflags(16); // caught cheater lobbies, overwatch bonus etc
+        accountClient->set_elevated_state(ElevatedStatePrime);
+        accountClient->set_elevated_timestamp(ElevatedStatePrime); // is this actually 5???
 
-        CMsgSOCacheSubscribed_SubscribedType *object = cacheMsg.add_objects();
-        object->set_type_id(SOTypeGameAccountClient);
-        object->add_object_data(accountClient.SerializeAsString());
+        encoder.AddObject(encoder.AddType(SOTypeGameAccountClient), *accountClient);
     }
 
-    NetworkMessage responseMsg = NetworkMessage::FromProto(cacheMsg, k_EMsgGC_CC_GC2CL_SOCacheSubscribed);
+    // byte for byte check against serializing a CMsgSOCacheSubscribed, costs a second encode
+    static const bool verifyEncoder = getenv("GC_VERIFY_SOCACHE_ENCODER") != nullptr;
+
+    // items are serialized once per row version, later SOCaches copy the bytes
+    ItemBlobCache *blobs = ItemBlobCache::GetInstance();
+
+    std::optional<NetworkMessage> responseMsg;
+    auto encode = [&](const ItemMap &items, const ItemVersions &versions)
+    {
+        for (const auto &pair : items)
+        {
+            auto version = versions.find(pair.first);
+            if (version == versions.end())
+            {
+                encoder.AddObject(itemType, pair.second);
+                continue;
+            }
+
+            ItemBlobCache::Blob blob = blobs->Get(pair.first, version->second);
+            if (!blob)
+            {
+                blob = blobs->Put(pair.first, version->second, pair.second);
+            }
+            else if (verifyEncoder && *blob != pair.second.SerializeAsString())
+            {
+                logger::error("SendSOCache: Cached bytes of item %llu (version %u) don't match the item",
+                              pair.first, version->second);
+            }
+
+            encoder.AddSerialized(itemType, std::move(blob));
+        }
 
-    // Log total objects and serialized size of cached objects
-    logger::info("SendSOCache: Sending SOCache - Total objects: %d", cacheMsg.objects_size());
+        responseMsg.emplace(encoder.Encode(k_EMsgGC_CC_GC2CL_SOCacheSubscribed));
+        if (verifyEncoder)
+        {
+            encoder.Verify(*responseMsg);
+        }
+    };
 
-    // Log individual object details
-    for (int i = 0; i < cacheMsg.objects_size(); i++)
+    // online players are served from memory, anyone else straight from the database
+    if (!InventoryCache::GetInstance()->WithItems(steamId, encode))
     {
-        const auto &obj = cacheMsg.objects(i);
-        logger::info("Object %d - Type: %u, Data count: %d, Object size: %d",
-                     i, obj.type_id(), obj.object_data_size(),
-                     obj.ByteSizeLong());
+        ItemMap items;
+        ItemVersions versions;
+        uint64_t latestItemId;
+        if (!ReadItemsByOwner(steamId, inventory_db, items, versions, latestItemId))
+        {
+            return;
+        }
+
+        encode(items, versions);
     }
 
-    uint32_t totalSize = responseMsg.GetTotalSize();
-    logger::info("SendSOCache: Total message size: %u bytes", totalSize);
+    logger::info("SendSOCache: Sending SOCache - %zu types, %zu objects, %u bytes",
+                 encoder.TypeCount(), encoder.ObjectCount(), responseMsg->GetTotalSize());
 
-    responseMsg.WriteToSocket(p2psocket, true);
+    responseMsg->WriteToSocket(p2psocket, true);
 
     logger::info("SendSOCache: Sent SOCache for steamid %llu", steamId);
 }
@@ -658,36 +728,62 @@ void GCNetwork_Inventory::SendSOCache(SNetSocket_t p2psocket, uint64_t steamId,
  * Helper function to create a fully populated CSOEconItem from database row
  *
  * @param steamId The steam ID of the item's owner
- * @param row MySQL row containing the item data
+ * @param row Item row fetched through a prepared statement
  * @param overrideAcknowledged Optional value to override the acknowledged/inventory position
  * @return Pointer to a new CSOEconItem object (caller must manage memory)
  */
 CSOEconItem *GCNetwork_Inventory::CreateItemFromDatabaseRow(
     uint64_t steamId,
-    MYSQL_ROW &row,
+    const ItemRow &row,
     int overrideAcknowledged)
 {
-    if (!row)
+    CSOEconItem *item = new CSOEconItem();
+    if (!FillItemFromDatabaseRow(item, steamId, row, overrideAcknowledged))
     {
-        logger::error("CreateItemFromDatabaseRow: NULL row pointer");
+        delete item;
         return nullptr;
     }
 
+    return item;
+}
+
+/**
+ * Populates an existing CSOEconItem from a database row, so callers can build items
+ * in place (map entries, arena messages) instead of allocating one per row
+ *
+ * @param item The item to fill, cleared first
+ * @param steamId The steam ID of the item's owner
+ * @param row Item row fetched through a prepared statement
+ * @param overrideAcknowledged Optional value to override the acknowledged/inventory position
+ * @return True if the row could be turned into an item
+ */
+bool GCNetwork_Inventory::FillItemFromDatabaseRow(
+    CSOEconItem *item,
+    uint64_t steamId,
+    const ItemRow &row,
+    int overrideAcknowledged)
+{
     try
     {
-        CSOEconItem *item = new CSOEconItem();
+        item->Clear();
 
-        // Parse item_id and get def_index and paint_index
+        // def_index and paint_index are stored by a trigger, item_id is only parsed
+        // for rows it couldn't make sense of
         uint32_t def_index, paint_index;
-        if (!row[1] || !ParseItemId(row[1], def_index, paint_index))
+        bool typed = !row.isNull[24] && !row.isNull[25];
+        if (typed)
         {
-            logger::error("CreateItemFromDatabaseRow: Failed to parse item_id: %s", row[1] ? row[1] : "null");
-            delete item;
-            return nullptr;
+            def_index = row.defIndex;
+            paint_index = row.paintIndex;
+        }
+        else if (row.isNull[1] || !ParseItemId(std::string(row.ItemId()), def_index, paint_index))
+        {
+            logger::error("CreateItemFromDatabaseRow: Failed to parse item_id: %s", row.isNull[1] ? "null" : std::string(row.ItemId()).c_str());
+            return false;
         }
 
         // Base properties
-        item->set_id(row[0] ? strtoull(row[0], nullptr, 10) : 0);
+        item->set_id(row.isNull[0] ? 0 : row.id);
         item->set_account_id(steamId & 0xFFFFFFFF);
         item->set_def_index(def_index);
 
@@ -698,49 +794,43 @@ CSOEconItem *GCNetwork_Inventory::CreateItemFromDatabaseRow(
         }
         else
         {
-            item->set_inventory(row[22] ? static_cast<uint32_t>(atoi(row[22])) : 0);
+            item->set_inventory(row.isNull[22] ? 0 : static_cast<uint32_t>(row.acknowledged));
         }
 
         item->set_level(1);
-        item->set_quality(row[4] ? static_cast<uint32_t>(atoi(row[4])) : 0);
+        item->set_quality(row.isNull[4] ? 0 : static_cast<uint32_t>(row.quality));
         item->set_flags(0);
 
         // Item origin
         int originType = kEconItemOrigin_FoundInCrate;
-        if (row[23])
+        std::string_view acquiredBy = row.AcquiredBy();
+        if (acquiredBy == "trade")
         {
-            std::string acquiredBy = row[23];
-            if (acquiredBy == "trade")
-            {
-                originType = kEconItemOrigin_Traded;
-            }
-            else if (acquiredBy == "trade_up")
-            {
-                originType = kEconItemOrigin_Crafted;
-            }
-            else if (acquiredBy == "ingame_drop")
-            {
-                originType = kEconItemOrigin_Drop;
-            }
-            else if (acquiredBy == "purchased")
-            {
-                originType = kEconItemOrigin_Purchased;
-            }
-            else if (acquiredBy == "0" || acquiredBy.empty())
-            {
-                originType = kEconItemOrigin_FoundInCrate;
-            }
+            originType = kEconItemOrigin_Traded;
+        }
+        else if (acquiredBy == "trade_up")
+        {
+            originType = kEconItemOrigin_Crafted;
+        }
+        else if (acquiredBy == "ingame_drop")
+        {
+            originType = kEconItemOrigin_Drop;
+        }
+        else if (acquiredBy == "purchased")
+        {
+            originType = kEconItemOrigin_Purchased;
         }
         item->set_origin(originType);
 
         // Custom name
-        if (row[18] && strlen(row[18]) > 0)
+        std::string_view nametag = row.Nametag();
+        if (!nametag.empty())
         {
-            item->set_custom_name(row[18]);
+            item->set_custom_name(nametag.data(), nametag.size());
         }
 
         // Rarity (add 1 to match expected range)
-        item->set_rarity(row[3] ? static_cast<uint32_t>(atoi(row[3]) + 1) : 0);
+        item->set_rarity(row.isNull[3] ? 0 : static_cast<uint32_t>(row.rarity + 1));
 
         // Set attributes based on item type
         if (def_index == 1209)
@@ -760,26 +850,26 @@ CSOEconItem *GCNetwork_Inventory::CreateItemFromDatabaseRow(
             {
                 AddFloatAttribute(item, ATTR_PAINT_INDEX, paint_index);
 
-                if (row[2] && strlen(row[2]) > 0)
+                if (!row.isNull[2])
                 {
-                    AddFloatAttribute(item, ATTR_PAINT_WEAR, std::stof(row[2]));
+                    AddFloatAttribute(item, ATTR_PAINT_WEAR, row.floatval);
                 }
 
-                if (row[19] && strlen(row[19]) > 0)
+                if (!row.isNull[19])
                 {
-                    AddFloatAttribute(item, ATTR_PAINT_SEED, atoi(row[19]));
+                    AddFloatAttribute(item, ATTR_PAINT_SEED, row.patternIndex);
                 }
             }
 
             // StatTrak
-            if (row[6] && atoi(row[6]) == 1)
+            if (!row.isNull[6] && row.stattrak == 1)
             {
-                AddUint32Attribute(item, ATTR_KILLEATER_SCORE, row[7] ? atoi(row[7]) : 0);
+                AddUint32Attribute(item, ATTR_KILLEATER_SCORE, row.isNull[7] ? 0 : row.stattrakKills);
                 AddUint32Attribute(item, ATTR_KILLEATER_TYPE, 0);
             }
 
             // Untradable
-            if (row[5] && atoi(row[5]) == 0)
+            if (!row.isNull[5] && row.tradable == 0)
             {
                 AddUint32Attribute(item, ATTR_TRADE_RESTRICTION, 3133696800); // 4/20/2069
             }
@@ -795,11 +885,10 @@ CSOEconItem *GCNetwork_Inventory::CreateItemFromDatabaseRow(
         }
 
         // Equipment state
-        bool equipped_ct = row[20] ? atoi(row[20]) == 1 : false;
-        bool equipped_t = row[21] ? atoi(row[21]) == 1 : false;
+        bool equipped_ct = !row.isNull[20] && row.equippedCt == 1;
+        bool equipped_t = !row.isNull[21] && row.equippedT == 1;
 
-        std::string item_id = row[1] ? row[1] : "";
-        bool isCollectible = (item_id.length() >= 12) ? (item_id.substr(0, 12) == "collectible-") : false;
+        bool isCollectible = typed ? row.itemKind == ItemKindCollectible : row.ItemId().starts_with("collectible-");
         bool isMusicKit = (def_index == 1314);
 
         if (isCollectible || isMusicKit)
@@ -816,17 +905,17 @@ CSOEconItem *GCNetwork_Inventory::CreateItemFromDatabaseRow(
             AddEquippedState(item, equipped_t, CLASS_T, def_index);
         }
 
-        return item;
+        return true;
     }
     catch (const std::exception &e)
     {
         logger::error("CreateItemFromDatabaseRow: Exception caught: %s", e.what());
-        return nullptr;
+        return false;
     }
     catch (...)
     {
         logger::error("CreateItemFromDatabaseRow: Unknown exception caught");
-        return nullptr;
+        return false;
     }
 }
 
@@ -851,36 +940,24 @@ CSOEconItem *GCNetwork_Inventory::FetchItemFromDatabase(
         return nullptr;
     }
 
-    // Query to fetch the item data
-    char query[512];
-    snprintf(query, sizeof(query),
-             "SELECT id, item_id, floatval, rarity, quality, tradable, "
-             "stattrak, stattrak_kills, "
-             "sticker_1, sticker_1_wear, sticker_2, sticker_2_wear, "
-             "sticker_3, sticker_3_wear, sticker_4, sticker_4_wear, "
-             "sticker_5, sticker_5_wear, nametag, pattern_index, "
-             "equipped_ct, equipped_t, acknowledged, acquired_by "
-             "FROM csgo_items "
-             "WHERE id = %llu AND owner_steamid2 = '%s'",
-             itemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
-
-    if (mysql_query(inventory_db, query) != 0)
+    DbStatement *stmt = DbStatementCache::Get(inventory_db, SqlSelectItemById);
+    if (!stmt)
     {
-        logger::error("FetchItemFromDatabase: MySQL query failed: %s", mysql_error(inventory_db));
         return nullptr;
     }
 
-    MYSQL_RES *result = mysql_store_result(inventory_db);
-    if (!result)
+    stmt->BindUInt64(0, itemId);
+    stmt->BindUInt64(1, GCNetwork_Users::SteamID64ToAccountID(steamId));
+    if (!stmt->Execute())
     {
-        logger::error("FetchItemFromDatabase: Failed to store MySQL result");
+        logger::error("FetchItemFromDatabase: MySQL query failed: %s", stmt->Error());
         return nullptr;
     }
 
-    MYSQL_ROW row = mysql_fetch_row(result);
+    ItemRow row;
     CSOEconItem *item = nullptr;
 
-    if (row)
+    if (stmt->BindResult(row.Bind()) && stmt->Fetch())
     {
         item = CreateItemFromDatabaseRow(steamId, row, overrideAcknowledged);
     }
@@ -889,141 +966,522 @@ CSOEconItem *GCNetwork_Inventory::FetchItemFromDatabase(
         logger::error("FetchItemFromDatabase: Item not found: %llu", itemId);
     }
 
-    mysql_free_result(result);
+    stmt->FreeResult();
+
+    // every read-back after a write lands here, which keeps the cache current.
+    // An overridden position is only for display and isn't what the row holds
+    if (item && overrideAcknowledged < 0)
+    {
+        InventoryCache::GetInstance()->Store(steamId, *item, row.rowVersion);
+    }
+
     return item;
 }
 
 /**
- * Checks for new items and sends them to the client
- * For items with acquired_by="0", also sends the same item as an UnlockCrateResponse
+ * Looks an item up in the inventory cache, falling back to the database for players that aren't cached
  *
- * @param p2psocket The socket to send updates to
- * @param steamId The steam ID of the player
- * @param lastItemId Reference to the last known item ID, which will be updated
- * @param inventory_db Database connection to fetch inventory data
- * @return True if new items were found and sent
+ * @param itemId The unique ID of the item
+ * @param steamId The owner's Steam ID
+ * @param inventory_db Database connection
+ * @return Pointer to a new CSOEconItem object (caller must manage memory)
  */
-bool GCNetwork_Inventory::CheckAndSendNewItemsSince(
-    SNetSocket_t p2psocket,
-    uint64_t steamId,
-    uint64_t &lastItemId,
-    MYSQL *inventory_db)
+CSOEconItem *GCNetwork_Inventory::GetItem(uint64_t itemId, uint64_t steamId, MYSQL *inventory_db)
 {
-    if (!inventory_db)
+    InventoryCache *cache = InventoryCache::GetInstance();
+    if (cache->IsLoaded(steamId))
     {
-        logger::error("CheckAndSendNewItemsSince: Database connection is null");
-        return false;
+        CSOEconItem *item = new CSOEconItem();
+        if (cache->GetItem(steamId, itemId, *item))
+        {
+            return item;
+        }
+
+        // the cache holds the whole inventory, so it isn't theirs
+        delete item;
+        logger::error("GetItem: Item not found: %llu", itemId);
+        return nullptr;
     }
 
-    // query to find new items with an id higher than lastItemId
-    char query[512];
-    snprintf(query, sizeof(query),
-             "SELECT id, item_id, floatval, rarity, quality, tradable, "
-             "stattrak, stattrak_kills, "
-             "sticker_1, sticker_1_wear, sticker_2, sticker_2_wear, "
-             "sticker_3, sticker_3_wear, sticker_4, sticker_4_wear, "
-             "sticker_5, sticker_5_wear, nametag, pattern_index, "
-             "equipped_ct, equipped_t, acknowledged, acquired_by "
-             "FROM csgo_items "
-             "WHERE owner_steamid2 = '%s' AND id > %llu "
-             "ORDER BY id ASC",
-             GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str(), lastItemId);
+    return FetchItemFromDatabase(itemId, steamId, inventory_db);
+}
 
-    if (mysql_query(inventory_db, query) != 0)
+/**
+ * Reads every item a player owns
+ *
+ * @param steamId The owner's Steam ID
+ * @param inventory_db Database connection
+ * @param items Output map of the items by id
+ * @param versions Output row version of every item
+ * @param latestItemId Output highest item id, 0 for an empty inventory
+ * @return True if the query succeeded
+ */
+bool GCNetwork_Inventory::ReadItemsByOwner(uint64_t steamId, MYSQL *inventory_db, ItemMap &items, ItemVersions &versions, uint64_t &latestItemId)
+{
+    DbStatement *stmt = DbStatementCache::Get(inventory_db, SqlSelectItemsByOwner);
+    if (!stmt)
     {
-        logger::error("CheckAndSendNewItemsSince: MySQL query failed: %s", mysql_error(inventory_db));
         return false;
     }
 
-    MYSQL_RES *result = mysql_store_result(inventory_db);
-    if (!result)
+    stmt->BindUInt64(0, GCNetwork_Users::SteamID64ToAccountID(steamId));
+    if (!stmt->Execute())
     {
-        logger::error("CheckAndSendNewItemsSince: Failed to store MySQL result");
+        logger::error("ReadItemsByOwner: MySQL query failed: %s", stmt->Error());
         return false;
     }
 
-    int numRows = mysql_num_rows(result);
-    if (numRows == 0)
+    ItemRow row;
+    if (!stmt->BindResult(row.Bind()))
+    {
+        stmt->FreeResult();
+        return false;
+    }
+
+    latestItemId = 0;
+    while (stmt->Fetch())
+    {
+        latestItemId = std::max(latestItemId, row.id);
+
+        if (row.isNull[1])
+        {
+            logger::error("ReadItemsByOwner: Item ID is NULL in database row");
+            continue;
+        }
+
+        // built in place, no temporary item per row
+        CSOEconItem &item = items[row.id];
+        if (!FillItemFromDatabaseRow(&item, steamId, row))
+        {
+            items.erase(row.id);
+            continue;
+        }
+
+        versions[row.id] = row.rowVersion;
+    }
+
+    stmt->FreeResult();
+    return true;
+}
+
+/**
+ * Loads a player's inventory into the inventory cache, replacing what was cached
+ * Nothing is cached for players InventoryCache::Admit wasn't called for
+ *
+ * @param steamId The steam ID of the player
+ * @param inventory_db Database connection
+ * @param latestItemId Output highest item id of the player
+ * @return True if the inventory was loaded
+ */
+bool GCNetwork_Inventory::LoadInventory(uint64_t steamId, MYSQL *inventory_db, uint64_t &latestItemId)
+{
+    ItemMap items;
+    ItemVersions versions;
+    if (!ReadItemsByOwner(steamId, inventory_db, items, versions, latestItemId))
     {
-        // no items
-        mysql_free_result(result);
         return false;
     }
 
-    logger::info("CheckAndSendNewItemsSince: Found %d new items for player %llu", numRows, steamId);
+    size_t count = items.size();
+    if (!InventoryCache::GetInstance()->Set(steamId, std::move(items), std::move(versions)))
+    {
+        // the session expired while this was loading
+        logger::info("LoadInventory: Player %llu went offline, not caching their items", steamId);
+        return true;
+    }
+
+    logger::info("LoadInventory: Cached %zu items for player %llu", count, steamId);
+    return true;
+}
+
+/**
+ * Re-reads items after a write that didn't read them back, e.g. inserts and bulk updates
+ * Items that no longer exist (or changed owner) are dropped from the cache
+ *
+ * @param steamId The owner's Steam ID
+ * @param itemIds The items to refresh
+ * @param inventory_db Database connection
+ */
+void GCNetwork_Inventory::RefreshCachedItems(uint64_t steamId, const std::vector<uint64_t> &itemIds, MYSQL *inventory_db)
+{
+    InventoryCache *cache = InventoryCache::GetInstance();
+    if (itemIds.empty() || !cache->IsLoaded(steamId))
+    {
+        return;
+    }
+
+    DbStatement *stmt = DbStatementCache::Get(inventory_db, SqlSelectItemsByIds);
+    if (!stmt)
+    {
+        return;
+    }
 
-    bool updateSuccess = false;
-    uint64_t highestItemId = lastItemId;
+    uint32_t owner = GCNetwork_Users::SteamID64ToAccountID(steamId);
+    ItemRow row;
 
-    // find highest item id
-    MYSQL_ROW row;
-    mysql_data_seek(result, 0);
-    while ((row = mysql_fetch_row(result)))
+    for (size_t offset = 0; offset < itemIds.size(); offset += ItemsByIdBatch)
     {
-        uint64_t itemId = row[0] ? strtoull(row[0], nullptr, 10) : 0;
-        if (itemId > highestItemId)
+        for (size_t i = 0; i < ItemsByIdBatch; i++)
+        {
+            size_t index = offset + i;
+            stmt->BindUInt64(static_cast<unsigned int>(i), index < itemIds.size() ? itemIds[index] : 0);
+        }
+
+        if (!stmt->Execute())
+        {
+            logger::error("RefreshCachedItems: MySQL query failed: %s", stmt->Error());
+            return;
+        }
+
+        if (!stmt->BindResult(row.Bind()))
         {
-            highestItemId = itemId;
+            stmt->FreeResult();
+            return;
         }
+
+        std::vector<uint64_t> missing(itemIds.begin() + offset, itemIds.begin() + std::min(offset + ItemsByIdBatch, itemIds.size()));
+        while (stmt->Fetch())
+        {
+            if (row.ownerAccountId != owner)
+            {
+                continue;
+            }
+
+            CSOEconItem *item = CreateItemFromDatabaseRow(steamId, row);
+            if (item)
+            {
+                cache->Store(steamId, *item, row.rowVersion);
+                delete item;
+                missing.erase(std::remove(missing.begin(), missing.end(), row.id), missing.end());
+            }
+        }
+        stmt->FreeResult();
+
+        for (uint64_t itemId : missing)
+        {
+            cache->Remove(steamId, itemId);
+        }
+    }
+}
+
+/**
+ * Sends items created since the last poll to their online owners
+ * All owners are covered by one range scan on the primary key instead of a query per session.
+ * Items with acquired_by="0" were already sent as an UnlockCrateResponse, they are only marked as seen
+ *
+ * @param watermark Highest item id already looked at, advanced past every row read
+ * @param watches Online sessions to route items to, their lastItemId is advanced and notified set
+ * @param inventory_db Database connection to fetch inventory data
+ * @param until Highest item id to read, rows past it are left for a later scan
+ * @return The number of new rows read
+ */
+size_t GCNetwork_Inventory::SendNewItemsSince(
+    uint64_t &watermark,
+    std::vector<ItemWatch> &watches,
+    MYSQL *inventory_db,
+    uint64_t until)
+{
+    constexpr uint64_t BatchSize = 500;
+
+    if (!inventory_db)
+    {
+        logger::error("SendNewItemsSince: Database connection is null");
+        return 0;
+    }
+
+    DbStatement *stmt = DbStatementCache::Get(inventory_db, SqlSelectNewItems);
+    if (!stmt)
+    {
+        return 0;
     }
-    mysql_data_seek(result, 0);
 
-    // one item - SOSingleObject
-    row = mysql_fetch_row(result);
-    if (row)
+    // rows are keyed by account id (owner_account_id), sessions by steamid64
+    std::unordered_map<uint32_t, ItemWatch *> owners;
+    owners.reserve(watches.size());
+    for (ItemWatch &watch : watches)
     {
-        CSOEconItem *item = CreateItemFromDatabaseRow(steamId, row);
-        if (item)
+        owners[GCNetwork_Users::SteamID64ToAccountID(watch.steamId)] = &watch;
+    }
+
+    std::vector<uint64_t> crateItemIds;
+    size_t totalRows = 0;
+    bool reachedEnd = false;
+    ItemRow row;
+
+    while (!reachedEnd)
+    {
+        stmt->BindUInt64(0, watermark);
+        stmt->BindUInt64(1, BatchSize);
+        if (!stmt->Execute())
+        {
+            logger::error("SendNewItemsSince: MySQL query failed: %s", stmt->Error());
+            break;
+        }
+
+        if (!stmt->BindResult(row.Bind()))
         {
-            bool isFromCrate = (row[23] && strcmp(row[23], "0") == 0);
+            stmt->FreeResult();
+            break;
+        }
+
+        uint64_t rows = 0;
+        while (stmt->Fetch())
+        {
+            if (row.id > until)
+            {
+                reachedEnd = true;
+                break;
+            }
+
+            rows++;
+            watermark = std::max(watermark, row.id);
+
+            auto it = owners.find(row.ownerAccountId);
+            if (it == owners.end())
+            {
+                continue; // owner isn't online
+            }
+
+            // already part of the SOCache sent at login
+            ItemWatch &watch = *it->second;
+            if (row.id <= watch.lastItemId)
+            {
+                continue;
+            }
+            watch.lastItemId = row.id;
 
-            if (isFromCrate)
+            if (row.AcquiredBy() == "0")
             {
                 // Item from crate opening - skip sending it here since it was already sent in HandleUnboxCrate
-                logger::info("CheckAndSendNewItemsSince: Skipping item %llu with acquired_by='0' (already sent as UnlockCrateResponse)", item->id());
-                
-                // Update the acquired_by field to "crate" to prevent sending it again
-                char updateQuery[256];
-                snprintf(updateQuery, sizeof(updateQuery),
-                         "UPDATE csgo_items SET acquired_by = 'crate' WHERE id = %llu",
-                         item->id());
-                
-                if (mysql_query(inventory_db, updateQuery) != 0)
-                {
-                    logger::error("CheckAndSendNewItemsSince: Failed to update acquired_by field: %s", mysql_error(inventory_db));
-                }
-                
-                updateSuccess = true;  // Mark as success even though we didn't send anything
+                crateItemIds.push_back(row.id);
+                watch.notified = true;
+                continue;
             }
-            else
+
+            CSOEconItem *item = CreateItemFromDatabaseRow(watch.steamId, row);
+            if (item)
             {
-                // For other items, send as standard SOSingleObject
-                logger::info("CheckAndSendNewItemsSince: Sending 1 new item with SOSingleObject");
-                updateSuccess = SendSOSingleObject(p2psocket, steamId, SOTypeItem, *item);
+                InventoryCache::GetInstance()->Store(watch.steamId, *item, row.rowVersion);
+                logger::info("SendNewItemsSince: Sending new item %llu to player %llu", item->id(), watch.steamId);
+                if (SendSOSingleObject(watch.socket, watch.steamId, SOTypeItem, *item))
+                {
+                    watch.notified = true;
+                }
+                delete item;
             }
+        }
+        stmt->FreeResult();
 
-            delete item;
+        totalRows += rows;
+        if (rows < BatchSize)
+        {
+            break;
         }
     }
 
-    mysql_free_result(result);
+    MarkCrateItemsSeen(crateItemIds);
+
+    if (totalRows > 0)
+    {
+        logger::info("SendNewItemsSince: Read %zu new items, watermark now %llu", totalRows, watermark);
+    }
+
+    return totalRows;
+}
+
+/**
+ * Sends items touched by outbox events to their online owners
+ * Inserts are sent whoever wrote them, like the poller did; updates and deletes only when
+ * they came from outside the GC, the GC already notifies the client about its own changes
+ *
+ * @param events Events read from the outbox, in event order
+ * @param watches Online sessions to route items to, notified is set for every session that got something
+ * @param inventory_db Database connection to fetch inventory data
+ * @return The number of objects sent
+ */
+size_t GCNetwork_Inventory::SendItemEvents(
+    const std::vector<ItemEvent> &events,
+    std::vector<ItemWatch> &watches,
+    MYSQL *inventory_db)
+{
+    std::unordered_map<uint32_t, ItemWatch *> owners;
+    owners.reserve(watches.size());
+    for (ItemWatch &watch : watches)
+    {
+        owners[GCNetwork_Users::SteamID64ToAccountID(watch.steamId)] = &watch;
+    }
 
-    if (highestItemId > lastItemId)
+    // the last event per (item, owner) wins, a trade shows up as a delete
+    // for one owner and an insert for the other
+    std::map<std::pair<uint64_t, ItemWatch *>, ItemEventAction> pending;
+    for (const ItemEvent &event : events)
     {
-        if (updateSuccess)
+        if (event.action != ItemEventAction::Insert && !event.external)
         {
-            logger::info("CheckAndSendNewItemsSince: Successfully sent new items to player %llu", steamId);
+            continue;
         }
-        else
+
+        auto it = owners.find(event.ownerAccountId);
+        if (it == owners.end())
+        {
+            continue; // owner isn't online
+        }
+
+        auto key = std::make_pair(event.itemId, it->second);
+        auto existing = pending.find(key);
+        if (existing != pending.end() && existing->second == ItemEventAction::Insert && event.action == ItemEventAction::Update)
+        {
+            continue; // still new to the client
+        }
+        pending[key] = event.action;
+    }
+
+    size_t sent = 0;
+    std::vector<uint64_t> upsertIds;
+    for (const auto &[key, action] : pending)
+    {
+        if (action != ItemEventAction::Delete)
+        {
+            upsertIds.push_back(key.first);
+            continue;
+        }
+
+        ItemWatch &watch = *key.second;
+        CSOEconItem item;
+        item.set_id(key.first);
+        item.set_account_id(watch.steamId & 0xFFFFFFFF);
+
+        logger::info("SendItemEvents: Item %llu removed from player %llu", key.first, watch.steamId);
+        InventoryCache::GetInstance()->Remove(watch.steamId, key.first);
+        if (SendSOSingleObject(watch.socket, watch.steamId, SOTypeItem, item, k_EMsgGC_CC_DeleteItem))
+        {
+            watch.notified = true;
+            sent++;
+        }
+    }
+
+    if (upsertIds.empty())
+    {
+        return sent;
+    }
+
+    DbStatement *stmt = DbStatementCache::Get(inventory_db, SqlSelectItemsByIds);
+    if (!stmt)
+    {
+        return sent;
+    }
+
+    std::sort(upsertIds.begin(), upsertIds.end());
+    upsertIds.erase(std::unique(upsertIds.begin(), upsertIds.end()), upsertIds.end());
+
+    std::vector<uint64_t> crateItemIds;
+    ItemRow row;
+
+    for (size_t offset = 0; offset < upsertIds.size(); offset += ItemsByIdBatch)
+    {
+        for (size_t i = 0; i < ItemsByIdBatch; i++)
+        {
+            size_t index = offset + i;
+            stmt->BindUInt64(static_cast<unsigned int>(i), index < upsertIds.size() ? upsertIds[index] : 0);
+        }
+
+        if (!stmt->Execute())
+        {
+            logger::error("SendItemEvents: MySQL query failed: %s", stmt->Error());
+            break;
+        }
+
+        if (!stmt->BindResult(row.Bind()))
         {
-            logger::warning("CheckAndSendNewItemsSince: Failed to send new items to player %llu, updating lastItemId anyway", steamId);
+            stmt->FreeResult();
+            break;
         }
 
-        logger::info("CheckAndSendNewItemsSince: Updated lastItemId from %llu to %llu", lastItemId, highestItemId);
-        lastItemId = highestItemId;
+        while (stmt->Fetch())
+        {
+            // the row's current owner, an event for a previous owner was a delete
+            auto it = owners.find(row.ownerAccountId);
+            if (it == owners.end())
+            {
+                continue;
+            }
+
+            ItemWatch &watch = *it->second;
+            auto action = pending.find(std::make_pair(row.id, &watch));
+            if (action == pending.end() || action->second == ItemEventAction::Delete)
+            {
+                continue;
+            }
+
+            watch.lastItemId = std::max(watch.lastItemId, row.id);
+            watch.notified = true;
+
+            if (action->second == ItemEventAction::Insert && row.AcquiredBy() == "0")
+            {
+                // Item from crate opening - already sent (and cached) in HandleUnboxCrate
+                crateItemIds.push_back(row.id);
+                continue;
+            }
+
+            CSOEconItem *item = CreateItemFromDatabaseRow(watch.steamId, row);
+            if (item)
+            {
+                InventoryCache::GetInstance()->Store(watch.steamId, *item, row.rowVersion);
+                if (SendSOSingleObject(watch.socket, watch.steamId, SOTypeItem, *item))
+                {
+                    sent++;
+                }
+                delete item;
+            }
+        }
+        stmt->FreeResult();
+    }
+
+    MarkCrateItemsSeen(crateItemIds);
+    return sent;
+}
+
+// Update the acquired_by field to "crate" to prevent sending these again,
+// nobody waits for it so it goes through the write-behind queue
+void GCNetwork_Inventory::MarkCrateItemsSeen(const std::vector<uint64_t> &itemIds)
+{
+    WriteBehindQueue *queue = WriteBehindQueue::GetInstance();
+    for (uint64_t itemId : itemIds)
+    {
+        queue->CrateItemSeen(itemId);
+    }
+}
+
+// starting point for the batched poller
+bool GCNetwork_Inventory::GetLatestItemId(uint64_t &latestItemId, MYSQL *inventory_db)
+{
+    DbStatement *stmt = DbStatementCache::Get(inventory_db, SqlSelectLatestItemIdGlobal);
+    if (!stmt || !stmt->Execute())
+    {
+        logger::error("GetLatestItemId: MySQL query failed");
+        return false;
+    }
+
+    uint64_t maxId = 0;
+    my_bool isNull = 0;
+
+    MYSQL_BIND column;
+    memset(&column, 0, sizeof(column));
+    column.buffer_type = MYSQL_TYPE_LONGLONG;
+    column.buffer = &maxId;
+    column.is_unsigned = 1;
+    column.is_null = &isNull;
+
+    bool found = stmt->BindResult(&column) && stmt->Fetch();
+    stmt->FreeResult();
+
+    if (!found)
+    {
+        return false;
     }
 
-    return updateSuccess;
+    latestItemId = isNull ? 0 : maxId; // empty table
+    return true;
 }
 
 // helper for new item notif
@@ -1038,33 +1496,35 @@ uint64_t GCNetwork_Inventory::GetLatestItemIdForUser(
     }
 
     // Query to find the highest item ID for this user
-    char query[256];
-    snprintf(query, sizeof(query),
-             "SELECT MAX(id) FROM csgo_items WHERE owner_steamid2 = '%s'",
-             GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
-
-    if (mysql_query(inventory_db, query) != 0)
+    DbStatement *stmt = DbStatementCache::Get(inventory_db, SqlSelectLatestItemId);
+    if (!stmt)
     {
-        logger::error("GetLatestItemIdForUser: MySQL query failed: %s", mysql_error(inventory_db));
         return 0;
     }
 
-    MYSQL_RES *result = mysql_store_result(inventory_db);
-    if (!result)
+    stmt->BindUInt64(0, GCNetwork_Users::SteamID64ToAccountID(steamId));
+    if (!stmt->Execute())
     {
-        logger::error("GetLatestItemIdForUser: Failed to store MySQL result");
+        logger::error("GetLatestItemIdForUser: MySQL query failed: %s", stmt->Error());
         return 0;
     }
 
     uint64_t maxId = 0;
-    MYSQL_ROW row = mysql_fetch_row(result);
+    my_bool isNull = 0;
 
-    if (row && row[0])
+    MYSQL_BIND column;
+    memset(&column, 0, sizeof(column));
+    column.buffer_type = MYSQL_TYPE_LONGLONG;
+    column.buffer = &maxId;
+    column.is_unsigned = 1;
+    column.is_null = &isNull;
+
+    if (!stmt->BindResult(&column) || !stmt->Fetch() || isNull)
     {
-        maxId = strtoull(row[0], nullptr, 10);
+        maxId = 0;
     }
 
-    mysql_free_result(result);
+    stmt->FreeResult();
 
     logger::info("GetLatestItemIdForUser: Found highest item ID %llu for user %llu",
                  maxId, steamId);
@@ -1103,167 +1563,151 @@ int GCNetwork_Inventory::ProcessClientAcknowledgment(
     logger::info("ProcessClientAcknowledgment: Processing acknowledgment for %d items from player %llu",
                  message.item_id_size(), steamId);
 
-    // get the current highest inventory position for this user
-    char max_pos_query[256];
-    snprintf(max_pos_query, sizeof(max_pos_query),
-             "SELECT COALESCE(MAX(acknowledged), 1) FROM csgo_items WHERE owner_steamid2 = '%s'",
-             GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
-
-    if (mysql_query(inventory_db, max_pos_query) != 0)
-    {
-        logger::error("ProcessClientAcknowledgment: Failed to get max position: %s", mysql_error(inventory_db));
-        return 0;
-    }
-
-    MYSQL_RES *max_result = mysql_store_result(inventory_db);
-    if (!max_result)
+    // duplicates would get two positions in the CASE below
+    std::vector<uint64_t> itemIds;
+    itemIds.reserve(message.item_id_size());
+    for (uint64_t itemId : message.item_id())
     {
-        logger::error("ProcessClientAcknowledgment: Failed to store max position result");
-        return 0;
+        if (std::find(itemIds.begin(), itemIds.end(), itemId) == itemIds.end())
+        {
+            itemIds.push_back(itemId);
+        }
     }
 
-    MYSQL_ROW max_row = mysql_fetch_row(max_result);
-    uint32_t next_position = 1; // default start at 1
+    // positions are handed out here in message order, items that turn out to be
+    // acknowledged already just leave a gap
+    uint32_t firstPosition = GetNextInventoryPosition(steamId, inventory_db, static_cast<uint32_t>(itemIds.size()));
+    uint32_t owner = GCNetwork_Users::SteamID64ToAccountID(steamId);
 
-    if (max_row && max_row[0])
+    std::string query = "UPDATE csgo_items SET acknowledged = CASE id";
+    std::string idList;
+    for (size_t i = 0; i < itemIds.size(); i++)
     {
-        next_position = atoi(max_row[0]);
+        query += " WHEN " + std::to_string(itemIds[i]) + " THEN " + std::to_string(firstPosition + i);
+        if (i > 0)
+        {
+            idList += ", ";
+        }
+        idList += std::to_string(itemIds[i]);
     }
+    query += " END WHERE owner_account_id = " + std::to_string(owner) + " AND id IN (" + idList + ")"
+             " AND (acknowledged = 0 OR acknowledged IS NULL)";
 
-    mysql_free_result(max_result);
-
-    // start transaction
-    if (mysql_query(inventory_db, "START TRANSACTION") != 0)
+    // a single statement is atomic, no transaction needed
+    if (mysql_query(inventory_db, query.c_str()) != 0)
     {
-        logger::error("ProcessClientAcknowledgment: Failed to start transaction: %s", mysql_error(inventory_db));
+        logger::error("ProcessClientAcknowledgment: MySQL query failed: %s", mysql_error(inventory_db));
         return 0;
     }
 
-    int successCount = 0;
-
-    // one item?
-    bool isSingleItem = (message.item_id_size() == 1);
-    CSOEconItem *singleItem = nullptr;
-
-    // For multiple items, prepare the multiple objects message
-    CMsgSOMultipleObjects updateMsg;
-    if (!isSingleItem)
+    int successCount = static_cast<int>(mysql_affected_rows(inventory_db));
+    if (successCount == 0)
     {
-        InitMultipleObjectsMessage(updateMsg, steamId);
+        logger::warning("ProcessClientAcknowledgment: No items were acknowledged (not found or already acknowledged)");
+        return 0;
     }
 
-    // for each item
-    for (int i = 0; i < message.item_id_size(); i++)
+    // read the updated rows back, rows that weren't updated keep their old position
+    // and are left out
+    DbStatement *stmt = DbStatementCache::Get(inventory_db, SqlSelectAcknowledgedItems);
+    if (!stmt)
     {
-        uint64_t itemId = message.item_id(i);
-
-        next_position++;
-        if (next_position == 1)
-            next_position = 2; // skip position 1 (cause thats the nametag)
+        return successCount;
+    }
 
-        // set acknowledged status to next available position for acknowledged id overhead
-        char query[512];
-        snprintf(query, sizeof(query),
-                 "UPDATE csgo_items SET acknowledged = %u "
-                 "WHERE id = %llu AND owner_steamid2 = '%s' AND (acknowledged = 0 OR acknowledged IS NULL)",
-                 next_position, itemId,
-                 GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+    std::vector<CSOEconItem *> items;
+    ItemRow row;
+    stmt->BindUInt64(0, owner);
 
-        if (mysql_query(inventory_db, query) != 0)
+    for (size_t offset = 0; offset < itemIds.size(); offset += AcknowledgeBatch)
+    {
+        for (size_t i = 0; i < AcknowledgeBatch; i++)
         {
-            logger::error("ProcessClientAcknowledgment: MySQL query failed for item %llu: %s",
-                          itemId, mysql_error(inventory_db));
-            continue;
+            size_t index = offset + i;
+            stmt->BindUInt64(static_cast<unsigned int>(i + 1), index < itemIds.size() ? itemIds[index] : 0);
         }
 
-        if (mysql_affected_rows(inventory_db) == 0)
+        if (!stmt->Execute())
         {
-            logger::warning("ProcessClientAcknowledgment: Item %llu not found or already acknowledged", itemId);
-            next_position--;
-            continue;
+            logger::error("ProcessClientAcknowledgment: Failed to read back items: %s", stmt->Error());
+            break;
         }
 
-        // acknowledge success
-        successCount++;
+        if (!stmt->BindResult(row.Bind()))
+        {
+            stmt->FreeResult();
+            break;
+        }
 
-        // make item
-        CSOEconItem *item = FetchItemFromDatabase(itemId, steamId, inventory_db, next_position);
-        if (item)
+        while (stmt->Fetch())
         {
-            if (isSingleItem)
+            auto it = std::find(itemIds.begin(), itemIds.end(), row.id);
+            if (it == itemIds.end() || row.isNull[22] ||
+                static_cast<uint32_t>(row.acknowledged) != firstPosition + (it - itemIds.begin()))
             {
-                // For a single item, just store it for later use
-                singleItem = item;
+                continue;
             }
-            else
+
+            CSOEconItem *item = CreateItemFromDatabaseRow(steamId, row);
+            if (item)
             {
-                // For multiple items, add to the message
-                AddToMultipleObjectsMessage(updateMsg, SOTypeItem, *item);
-                delete item;
+                InventoryCache::GetInstance()->Store(steamId, *item, row.rowVersion);
+                items.push_back(item);
             }
         }
+        stmt->FreeResult();
     }
 
-    // process
-    if (successCount > 0)
+    if (items.size() == 1)
     {
-        if (mysql_query(inventory_db, "COMMIT") != 0)
-        {
-            logger::error("ProcessClientAcknowledgment: Failed to commit transaction: %s", mysql_error(inventory_db));
-            mysql_query(inventory_db, "ROLLBACK");
-
-            // Clean up if we have a single item
-            if (singleItem)
-            {
-                delete singleItem;
-            }
-
-            return 0;
-        }
-
-        if (isSingleItem && singleItem)
-        {
-            // Send single item update
-            logger::info("ProcessClientAcknowledgment: Sending single item update with SOSingleObject for item %llu",
-                         singleItem->id());
-            SendSOSingleObject(p2psocket, steamId, SOTypeItem, *singleItem);
-            delete singleItem;
-        }
-        else if (!isSingleItem && updateMsg.objects_modified_size() > 0)
+        logger::info("ProcessClientAcknowledgment: Sending single item update with SOSingleObject for item %llu",
+                     items[0]->id());
+        SendSOSingleObject(p2psocket, steamId, SOTypeItem, *items[0]);
+    }
+    else if (items.size() > 1)
+    {
+        CMsgSOMultipleObjects updateMsg;
+        InitMultipleObjectsMessage(updateMsg, steamId);
+        for (CSOEconItem *item : items)
         {
-            // Send multiple items update
-            logger::info("ProcessClientAcknowledgment: Sending %d modified items with SOMultipleObjects",
-                         updateMsg.objects_modified_size());
-            SendSOMultipleObjects(p2psocket, updateMsg);
+            AddToMultipleObjectsMessage(updateMsg, SOTypeItem, *item);
         }
 
-        logger::info("ProcessClientAcknowledgment: Successfully acknowledged %d items for player %llu",
-                     successCount, steamId);
+        logger::info("ProcessClientAcknowledgment: Sending %d modified items with SOMultipleObjects",
+                     updateMsg.objects_modified_size());
+        SendSOMultipleObjects(p2psocket, updateMsg);
     }
-    else
-    {
-        mysql_query(inventory_db, "ROLLBACK");
-        logger::warning("ProcessClientAcknowledgment: No items were acknowledged, transaction rolled back");
 
-        // Clean up if we have a single item
-        if (singleItem)
-        {
-            delete singleItem;
-        }
+    for (CSOEconItem *item : items)
+    {
+        delete item;
     }
 
+    logger::info("ProcessClientAcknowledgment: Successfully acknowledged %d items for player %llu",
+                 successCount, steamId);
+
     return successCount;
 }
 
 /**
- * Gets the next available inventory position for a new item
+ * Reserves inventory positions for new items
+ *
+ * Served from the inventory cache's high-water mark for online players, the
+ * MAX(acknowledged) scan is only the fallback for players that aren't cached
  *
  * @param steamId The steam ID of the player
  * @param inventory_db Database connection
- * @return The next available inventory position (skips position 1 for nametag)
+ * @param count Number of consecutive positions to reserve
+ * @return The first reserved inventory position (skips position 1 for nametag)
  */
-uint32_t GCNetwork_Inventory::GetNextInventoryPosition(uint64_t steamId, MYSQL *inventory_db)
+uint32_t GCNetwork_Inventory::GetNextInventoryPosition(uint64_t steamId, MYSQL *inventory_db, uint32_t count)
 {
+    uint32_t firstPosition;
+    if (InventoryCache::GetInstance()->ReservePositions(steamId, count, firstPosition))
+    {
+        return firstPosition;
+    }
+
     if (!inventory_db)
     {
         logger::error("GetNextInventoryPosition: Database connection is null");
@@ -1272,8 +1716,8 @@ uint32_t GCNetwork_Inventory::GetNextInventoryPosition(uint64_t steamId, MYSQL *
 
     char query[256];
     snprintf(query, sizeof(query),
-             "SELECT COALESCE(MAX(acknowledged), 1) FROM csgo_items WHERE owner_steamid2 = '%s'",
-             GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+             "SELECT COALESCE(MAX(acknowledged), 1) FROM csgo_items WHERE owner_account_id = %u",
+             GCNetwork_Users::SteamID64ToAccountID(steamId));
 
     if (mysql_query(inventory_db, query) != 0)
     {
@@ -1309,9 +1753,14 @@ uint32_t GCNetwork_Inventory::GetNextInventoryPosition(uint64_t steamId, MYSQL *
 /**
  * Handles the unboxing of a crate, generating a new item and saving it to the database
  *
+ * The crate DELETE and the new item INSERT (with its inventory position) run in one
+ * transaction, nothing is sent to the client until it has committed
+ *
  * @param p2psocket The socket to send updates to
  * @param steamId The steam ID of the player
  * @param crateItemId The ID of the crate being opened
+ * @param receivedAt When the request was read off the socket, the latency the player
+ *                   sees includes the wait for a worker
  * @param inventory_db Database connection to update
  * @return True if the crate was successfully opened
  */
@@ -1319,6 +1768,7 @@ bool GCNetwork_Inventory::HandleUnboxCrate(
     SNetSocket_t p2psocket,
     uint64_t steamId,
     uint64_t crateItemId,
+    std::chrono::steady_clock::time_point receivedAt,
     MYSQL *inventory_db)
 {
     if (!g_itemSchema || !inventory_db)
@@ -1328,7 +1778,7 @@ bool GCNetwork_Inventory::HandleUnboxCrate(
     }
 
     // verify
-    CSOEconItem *crateItem = FetchItemFromDatabase(crateItemId, steamId, inventory_db);
+    CSOEconItem *crateItem = GetItem(crateItemId, steamId, inventory_db);
     if (!crateItem)
     {
         logger::error("HandleUnboxCrate: Player %llu doesn't own crate %llu", steamId, crateItemId);
@@ -1346,30 +1796,63 @@ bool GCNetwork_Inventory::HandleUnboxCrate(
     }
 
     newItem.set_account_id(steamId & 0xFFFFFFFF);
-    
-    // Get next available inventory position for immediate display
-    uint32_t inventoryPosition = GetNextInventoryPosition(steamId, inventory_db);
-    newItem.set_inventory(inventoryPosition);
+
+    LatencyHistogram::Clock::time_point transactionStarted = LatencyHistogram::Clock::now();
+
+    if (mysql_query(inventory_db, "START TRANSACTION") != 0)
+    {
+        logger::error("HandleUnboxCrate: Failed to start transaction: %s", mysql_error(inventory_db));
+        delete crateItem;
+        return false;
+    }
+
+    // the crate goes first, a second open of the same crate finds nothing to delete
+    // and can't mint another item
+    char deleteQuery[256];
+    snprintf(deleteQuery, sizeof(deleteQuery),
+             "DELETE FROM csgo_items WHERE id = %llu AND owner_account_id = %u",
+             crateItemId, GCNetwork_Users::SteamID64ToAccountID(steamId));
+
+    if (mysql_query(inventory_db, deleteQuery) != 0)
+    {
+        logger::error("HandleUnboxCrate: Failed to delete crate %llu: %s", crateItemId, mysql_error(inventory_db));
+        mysql_query(inventory_db, "ROLLBACK");
+        delete crateItem;
+        return false;
+    }
+
+    if (mysql_affected_rows(inventory_db) != 1)
+    {
+        logger::error("HandleUnboxCrate: Crate %llu is no longer in the inventory of player %llu",
+                      crateItemId, steamId);
+        mysql_query(inventory_db, "ROLLBACK");
+        InventoryCache::GetInstance()->Remove(steamId, crateItemId);
+        delete crateItem;
+        return false;
+    }
+
+    // the position is written with the row, no follow-up UPDATE
+    newItem.set_inventory(GetNextInventoryPosition(steamId, inventory_db));
 
     uint64_t newItemId = SaveNewItemToDatabase(newItem, steamId, inventory_db);
     if (newItemId == 0)
     {
         logger::error("HandleUnboxCrate: Failed to save new item to database");
+        mysql_query(inventory_db, "ROLLBACK");
         delete crateItem;
         return false;
     }
 
-    // Update the database with the inventory position
-    char updatePosQuery[256];
-    snprintf(updatePosQuery, sizeof(updatePosQuery),
-             "UPDATE csgo_items SET acknowledged = %u WHERE id = %llu",
-             inventoryPosition, newItemId);
-    
-    if (mysql_query(inventory_db, updatePosQuery) != 0)
+    if (mysql_query(inventory_db, "COMMIT") != 0)
     {
-        logger::warning("HandleUnboxCrate: Failed to update inventory position: %s", mysql_error(inventory_db));
+        logger::error("HandleUnboxCrate: Failed to commit transaction: %s", mysql_error(inventory_db));
+        mysql_query(inventory_db, "ROLLBACK");
+        delete crateItem;
+        return false;
     }
 
+    s_unboxTransactionLatency.Record(LatencyHistogram::Clock::now() - transactionStarted);
+
     // setting id to newest
     newItem.set_id(newItemId);
 
@@ -1412,19 +1895,12 @@ bool GCNetwork_Inventory::HandleUnboxCrate(
     {
         logger::info("HandleUnboxCrate: Sent k_EMsgGCUnlockCrateResponse (1008) for item %llu", newItemId);
     }
-    
-    // Now delete from database
-    char deleteQuery[256];
-    snprintf(deleteQuery, sizeof(deleteQuery),
-             "DELETE FROM csgo_items WHERE id = %llu AND owner_steamid2 = '%s'",
-             crateItemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
-    
-    if (mysql_query(inventory_db, deleteQuery) != 0)
-    {
-        logger::warning("HandleUnboxCrate: Failed to delete crate from database: %s", mysql_error(inventory_db));
-    }
-    
-    logger::info("HandleUnboxCrate: EXACT LOCAL CLIENT SEQUENCE - Destroy→Create→Response(1008) [BUILD:v6.0]");
+
+    s_unboxLatency.Record(LatencyHistogram::Clock::now() - receivedAt);
+
+    // cache catches up after the client has its reply
+    InventoryCache::GetInstance()->Remove(steamId, crateItemId);
+    RefreshCachedItems(steamId, {newItemId}, inventory_db);
 
     delete crateItem;
     logger::info("HandleUnboxCrate: Successfully unboxed crate %llu for player %llu, got item %llu",
@@ -1432,6 +1908,15 @@ bool GCNetwork_Inventory::HandleUnboxCrate(
     return true;
 }
 
+/**
+ * Logs the unbox latency distribution, socket read to reply and the transaction alone
+ */
+void GCNetwork_Inventory::LogUnboxStats()
+{
+    s_unboxLatency.Log("HandleUnboxCrate: received to reply");
+    s_unboxTransactionLatency.Log("HandleUnboxCrate: transaction");
+}
+
 /**
  * Saves a newly generated item to the database
  *
@@ -1769,7 +2254,8 @@ uint64_t GCNetwork_Inventory::SaveNewItemToDatabase(
     }
 
     // Finish the query with remaining fields
-    query += ", '0.00', '0', '0', '" + acquiredBy + "', '0')";
+    // acknowledged, the inventory position when the caller already placed the item
+    query += ", '0.00', '0', '0', '" + acquiredBy + "', '" + std::to_string(item.inventory()) + "')";
 
     // Execute the query
     logger::info("SaveNewItemToDatabase: SQL Query: %s", query.c_str());
@@ -2104,7 +2590,7 @@ bool GCNetwork_Inventory::DeleteItem(
     }
 
     // Fetch the item before deleting it, so we can send its information
-    CSOEconItem *item = FetchItemFromDatabase(itemId, steamId, inventory_db);
+    CSOEconItem *item = GetItem(itemId, steamId, inventory_db);
     if (!item)
     {
         logger::error("DeleteItem: Item %llu not found or doesn't belong to user %llu",
@@ -2115,8 +2601,8 @@ bool GCNetwork_Inventory::DeleteItem(
     // Delete from database
     char query[256];
     snprintf(query, sizeof(query),
-             "DELETE FROM csgo_items WHERE id = %llu AND owner_steamid2 = '%s'",
-             itemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+             "DELETE FROM csgo_items WHERE id = %llu AND owner_account_id = %u",
+             itemId, GCNetwork_Users::SteamID64ToAccountID(steamId));
 
     if (mysql_query(inventory_db, query) != 0)
     {
@@ -2133,6 +2619,7 @@ bool GCNetwork_Inventory::DeleteItem(
     }
 
     logger::info("DeleteItem: Successfully deleted item %llu from database", itemId);
+    InventoryCache::GetInstance()->Remove(steamId, itemId);
 
     if (p2psocket != 0)
     {
@@ -2336,6 +2823,7 @@ CSOEconItem *GCNetwork_Inventory::CreateBaseItem(
 
         // Set the newly assigned ID
         item->set_id(newItemId);
+        RefreshCachedItems(steamId, {newItemId}, inventory_db);
         logger::info("CreateBaseItem: Created base item with defIndex %u, ID %llu for player %llu",
                      defIndex, newItemId, steamId);
     }
@@ -2757,8 +3245,8 @@ bool GCNetwork_Inventory::EquipItem(
 
         char query[512];
         snprintf(query, sizeof(query),
-                 "UPDATE csgo_items SET %s = 1 WHERE id = %llu AND owner_steamid2 = '%s'",
-                 column, itemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+                 "UPDATE csgo_items SET %s = 1 WHERE id = %llu AND owner_account_id = %u",
+                 column, itemId, GCNetwork_Users::SteamID64ToAccountID(steamId));
 
         if (mysql_query(inventory_db, query) != 0)
         {
@@ -2784,6 +3272,12 @@ bool GCNetwork_Inventory::EquipItem(
             return false;
         }
 
+        // featured medal shows on the profile
+        if (slotId == 55)
+        {
+            ProfileCache::GetInstance()->Invalidate(GCNetwork_Users::SteamID64ToAccountID(steamId));
+        }
+
         // Send the update to the client
         success = SendEquipUpdate(p2psocket, steamId, itemId, classId, slotId, inventory_db);
 
@@ -2980,9 +3474,9 @@ bool GCNetwork_Inventory::UnequipItem(
         // Get current item state and class/slot information
         char query[512];
         snprintf(query, sizeof(query),
-                 "SELECT equipped_ct, equipped_t, id, item_id FROM csgo_items "
-                 "WHERE id = %llu AND owner_steamid2 = '%s'",
-                 itemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+                 "SELECT equipped_ct, equipped_t, id, item_id, def_index, item_kind FROM csgo_items "
+                 "WHERE id = %llu AND owner_account_id = %u",
+                 itemId, GCNetwork_Users::SteamID64ToAccountID(steamId));
 
         if (mysql_query(inventory_db, query) != 0)
         {
@@ -3004,10 +3498,15 @@ bool GCNetwork_Inventory::UnequipItem(
         MYSQL_ROW row = mysql_fetch_row(result);
         bool was_equipped_ct = row[0] && atoi(row[0]) == 1;
         bool was_equipped_t = row[1] && atoi(row[1]) == 1;
+        bool was_medal = row[5] && atoi(row[5]) == ItemKindCollectible;
 
-        // Parse the item to get def_index for determining slot
+        // def_index for determining slot, parsed from item_id if the row has none
         uint32_t def_index = 0, paint_index = 0;
-        if (row[3] && !ParseItemId(row[3], def_index, paint_index))
+        if (row[4])
+        {
+            def_index = strtoul(row[4], nullptr, 10);
+        }
+        else if (row[3] && !ParseItemId(row[3], def_index, paint_index))
         {
             logger::error("UnequipItem: Failed to parse item_id: %s", row[3] ? row[3] : "null");
             mysql_free_result(result);
@@ -3020,8 +3519,8 @@ bool GCNetwork_Inventory::UnequipItem(
         // Update the database to unequip the item from all classes
         snprintf(query, sizeof(query),
                  "UPDATE csgo_items SET equipped_ct = 0, equipped_t = 0 "
-                 "WHERE id = %llu AND owner_steamid2 = '%s'",
-                 itemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+                 "WHERE id = %llu AND owner_account_id = %u",
+                 itemId, GCNetwork_Users::SteamID64ToAccountID(steamId));
 
         if (mysql_query(inventory_db, query) != 0)
         {
@@ -3038,6 +3537,11 @@ bool GCNetwork_Inventory::UnequipItem(
             return false;
         }
 
+        if (was_medal)
+        {
+            ProfileCache::GetInstance()->Invalidate(GCNetwork_Users::SteamID64ToAccountID(steamId));
+        }
+
         // Send the update to the client
         success = SendUnequipUpdate(p2psocket, steamId, itemId, inventory_db, was_equipped_ct, was_equipped_t, def_index);
 
@@ -3087,21 +3591,19 @@ bool GCNetwork_Inventory::UnequipItemsInSlot(
     // Check if this is for collectibles (slot 55) or music kits (slot 54)
     if (slotId == 55)
     {
-        // Special query for collectibles using "collectible-" prefix
+        // Special query for collectibles
         snprintf(query, sizeof(query),
                  "UPDATE csgo_items SET %s = 0 "
-                 "WHERE owner_steamid2 = '%s' AND %s = 1 AND "
-                 "item_id LIKE 'collectible-%%'",
-                 column, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str(), column);
+                 "WHERE owner_account_id = %u AND item_kind = %u AND %s = 1",
+                 column, GCNetwork_Users::SteamID64ToAccountID(steamId), ItemKindCollectible, column);
     }
     else if (slotId == 54)
     {
-        // Special query for music kits using "music_kit-" prefix
+        // Special query for music kits
         snprintf(query, sizeof(query),
                  "UPDATE csgo_items SET %s = 0 "
-                 "WHERE owner_steamid2 = '%s' AND %s = 1 AND "
-                 "item_id LIKE 'music_kit-%%'",
-                 column, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str(), column);
+                 "WHERE owner_account_id = %u AND item_kind = %u AND %s = 1",
+                 column, GCNetwork_Users::SteamID64ToAccountID(steamId), ItemKindMusicKit, column);
     }
     else
     {
@@ -3119,16 +3621,16 @@ bool GCNetwork_Inventory::UnequipItemsInSlot(
         {
             if (i > 0)
                 defIndexList += ",";
-            defIndexList += "'" + std::to_string(defindexes[i]) + "'";
+            defIndexList += std::to_string(defindexes[i]);
         }
         defIndexList += ")";
 
         // Original query for other item types
         snprintf(query, sizeof(query),
                  "UPDATE csgo_items SET %s = 0 "
-                 "WHERE owner_steamid2 = '%s' AND %s = 1 AND "
-                 "SUBSTRING_INDEX(SUBSTRING_INDEX(item_id, '_', 1), '-', -1) IN %s",
-                 column, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str(),
+                 "WHERE owner_account_id = %u AND %s = 1 AND "
+                 "def_index IN %s",
+                 column, GCNetwork_Users::SteamID64ToAccountID(steamId),
                  column, defIndexList.c_str());
     }
 
@@ -3141,6 +3643,25 @@ bool GCNetwork_Inventory::UnequipItemsInSlot(
     int affected = mysql_affected_rows(inventory_db);
     logger::info("UnequipItemsInSlot: Unequipped %d items from slot %u for class %u (player %llu)",
                  affected, slotId, classId, steamId);
+
+    // the update doesn't say which rows it touched, re-read whatever the cache has equipped for this class
+    if (affected > 0)
+    {
+        std::vector<uint64_t> equipped;
+        InventoryCache::GetInstance()->ForEachItem(steamId, [&](const CSOEconItem &item)
+        {
+            for (const auto &state : item.equipped_state())
+            {
+                if (state.new_class() == classId || state.new_class() == 0)
+                {
+                    equipped.push_back(item.id());
+                    break;
+                }
+            }
+        });
+        RefreshCachedItems(steamId, equipped, inventory_db);
+    }
+
     return true;
 }
 
@@ -3174,10 +3695,10 @@ bool GCNetwork_Inventory::SendEquipUpdate(
     // stupid hack
     if (slotId == 55 || slotId == 54)
     {
-        std::string itemIdStr;
+        uint32_t itemKind = ItemKindUnknown;
         char query[256];
         snprintf(query, sizeof(query),
-                 "SELECT item_id FROM csgo_items WHERE id = %llu", itemId);
+                 "SELECT item_kind FROM csgo_items WHERE id = %llu", itemId);
 
         if (mysql_query(inventory_db, query) == 0)
         {
@@ -3187,15 +3708,14 @@ bool GCNetwork_Inventory::SendEquipUpdate(
                 MYSQL_ROW row = mysql_fetch_row(result);
                 if (row && row[0])
                 {
-                    itemIdStr = row[0];
+                    itemKind = strtoul(row[0], nullptr, 10);
                 }
             }
             if (result)
                 mysql_free_result(result);
         }
 
-        bool isSpecialItem = (itemIdStr.substr(0, 12) == "collectible-") ||
-                             (itemIdStr.substr(0, 10) == "music_kit-");
+        bool isSpecialItem = itemKind == ItemKindCollectible || itemKind == ItemKindMusicKit;
 
         if (isSpecialItem)
         {
@@ -3293,8 +3813,8 @@ bool GCNetwork_Inventory::HandleNameItem(
     // Verify that the player owns the item
     char ownershipQuery[256];
     snprintf(ownershipQuery, sizeof(ownershipQuery),
-             "SELECT id FROM csgo_items WHERE id = %llu AND owner_steamid2 = '%s'",
-             itemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+             "SELECT id FROM csgo_items WHERE id = %llu AND owner_account_id = %u",
+             itemId, GCNetwork_Users::SteamID64ToAccountID(steamId));
 
     if (mysql_query(inventory_db, ownershipQuery) != 0)
     {
@@ -3388,6 +3908,7 @@ bool GCNetwork_Inventory::HandleNameBaseItem(
 
     // Set the new item ID
     newItem->set_id(newItemId);
+    RefreshCachedItems(steamId, {newItemId}, inventory_db);
 
     // Send the new item to the client
     bool createSent = SendSOSingleObject(p2psocket, steamId, SOTypeItem, *newItem);
@@ -3435,8 +3956,8 @@ bool GCNetwork_Inventory::HandleRemoveItemName(
                  "SELECT nametag, item_id, acquired_by, "
                  "(CASE WHEN sticker_1 > 0 OR sticker_2 > 0 OR sticker_3 > 0 OR sticker_4 > 0 OR sticker_5 > 0 "
                  "THEN 1 ELSE 0 END) as has_stickers "
-                 "FROM csgo_items WHERE id = %llu AND owner_steamid2 = '%s'",
-                 itemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+                 "FROM csgo_items WHERE id = %llu AND owner_account_id = %u",
+                 itemId, GCNetwork_Users::SteamID64ToAccountID(steamId));
 
         if (mysql_query(inventory_db, query) != 0)
         {
@@ -3487,7 +4008,7 @@ bool GCNetwork_Inventory::HandleRemoveItemName(
             logger::info("HandleRemoveItemName: Item %llu is a base item with no stickers, deleting it", itemId);
 
             // Fetch the item for sending delete notification
-            CSOEconItem *item = FetchItemFromDatabase(itemId, steamId, inventory_db);
+            CSOEconItem *item = GetItem(itemId, steamId, inventory_db);
             if (!item)
             {
                 logger::error("HandleRemoveItemName: Failed to fetch item");
@@ -3497,8 +4018,8 @@ bool GCNetwork_Inventory::HandleRemoveItemName(
 
             // Delete the item from the database
             snprintf(query, sizeof(query),
-                     "DELETE FROM csgo_items WHERE id = %llu AND owner_steamid2 = '%s'",
-                     itemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+                     "DELETE FROM csgo_items WHERE id = %llu AND owner_account_id = %u",
+                     itemId, GCNetwork_Users::SteamID64ToAccountID(steamId));
 
             if (mysql_query(inventory_db, query) != 0)
             {
@@ -3516,6 +4037,7 @@ bool GCNetwork_Inventory::HandleRemoveItemName(
                 delete item;
                 return false;
             }
+            InventoryCache::GetInstance()->Remove(steamId, itemId);
 
             // Send delete notification
             bool deleteSent = SendSOSingleObject(p2psocket, steamId, SOTypeItem, *item, k_EMsgGC_CC_DeleteItem);
@@ -3609,7 +4131,7 @@ bool GCNetwork_Inventory::HandleApplySticker(
     uint64_t stickerItemId = message.sticker_item_id();
 
     // Verify player owns the sticker
-    CSOEconItem *stickerItem = FetchItemFromDatabase(stickerItemId, steamId, inventory_db);
+    CSOEconItem *stickerItem = GetItem(stickerItemId, steamId, inventory_db);
     if (!stickerItem)
     {
         logger::error("HandleApplySticker: Player %llu doesn't own sticker item %llu",
@@ -3645,7 +4167,7 @@ bool GCNetwork_Inventory::HandleApplySticker(
     if (message.has_item_item_id() && message.item_item_id() > 0)
     {
         uint64_t targetItemId = message.item_item_id();
-        targetItem = FetchItemFromDatabase(targetItemId, steamId, inventory_db);
+        targetItem = GetItem(targetItemId, steamId, inventory_db);
 
         if (!targetItem)
         {
@@ -3706,18 +4228,18 @@ bool GCNetwork_Inventory::HandleApplySticker(
             // The item was just created, we already have the ID from CreateBaseItem
             snprintf(updateQuery, sizeof(updateQuery),
                      "UPDATE csgo_items SET sticker_%u = %u, sticker_%u_wear = 0.0 "
-                     "WHERE id = %llu AND owner_steamid2 = '%s'",
+                     "WHERE id = %llu AND owner_account_id = %u",
                      stickerSlot + 1, stickerKitId, stickerSlot + 1,
-                     targetItem->id(), GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+                     targetItem->id(), GCNetwork_Users::SteamID64ToAccountID(steamId));
         }
         else
         {
             // Existing item - update the sticker in the slot
             snprintf(updateQuery, sizeof(updateQuery),
                      "UPDATE csgo_items SET sticker_%u = %u, sticker_%u_wear = 0.0 "
-                     "WHERE id = %llu AND owner_steamid2 = '%s'",
+                     "WHERE id = %llu AND owner_account_id = %u",
                      stickerSlot + 1, stickerKitId, stickerSlot + 1,
-                     targetItem->id(), GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+                     targetItem->id(), GCNetwork_Users::SteamID64ToAccountID(steamId));
         }
 
         if (mysql_query(inventory_db, updateQuery) != 0)
@@ -3732,8 +4254,8 @@ bool GCNetwork_Inventory::HandleApplySticker(
         // Delete the sticker item
         char deleteQuery[256];
         snprintf(deleteQuery, sizeof(deleteQuery),
-                 "DELETE FROM csgo_items WHERE id = %llu AND owner_steamid2 = '%s'",
-                 stickerItemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+                 "DELETE FROM csgo_items WHERE id = %llu AND owner_account_id = %u",
+                 stickerItemId, GCNetwork_Users::SteamID64ToAccountID(steamId));
 
         if (mysql_query(inventory_db, deleteQuery) != 0)
         {
@@ -3753,6 +4275,7 @@ bool GCNetwork_Inventory::HandleApplySticker(
             delete targetItem;
             return false;
         }
+        InventoryCache::GetInstance()->Remove(steamId, stickerItemId);
 
         // Get fresh target item after modifications
         CSOEconItem *updatedItem = FetchItemFromDatabase(targetItem->id(), steamId, inventory_db);
@@ -3846,9 +4369,9 @@ bool GCNetwork_Inventory::HandleScrapeSticker(
         char query[512];
         snprintf(query, sizeof(query),
                  "SELECT id, sticker_%u, sticker_%u_wear, item_id FROM csgo_items "
-                 "WHERE id = %llu AND owner_steamid2 = '%s'",
+                 "WHERE id = %llu AND owner_account_id = %u",
                  stickerSlot + 1, stickerSlot + 1,
-                 itemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+                 itemId, GCNetwork_Users::SteamID64ToAccountID(steamId));
 
         if (mysql_query(inventory_db, query) != 0)
         {
@@ -3931,9 +4454,9 @@ bool GCNetwork_Inventory::HandleScrapeSticker(
                          "(sticker_3 > 0 AND sticker_3 != sticker_%u) OR "
                          "(sticker_4 > 0 AND sticker_4 != sticker_%u) OR "
                          "(sticker_5 > 0 AND sticker_5 != sticker_%u) THEN 1 ELSE 0 END) as has_other_stickers "
-                         "FROM csgo_items WHERE id = %llu AND owner_steamid2 = '%s'",
+                         "FROM csgo_items WHERE id = %llu AND owner_account_id = %u",
                          stickerSlot + 1, stickerSlot + 1, stickerSlot + 1, stickerSlot + 1, stickerSlot + 1,
-                         itemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+                         itemId, GCNetwork_Users::SteamID64ToAccountID(steamId));
 
                 if (mysql_query(inventory_db, query) != 0)
                 {
@@ -3961,12 +4484,12 @@ bool GCNetwork_Inventory::HandleScrapeSticker(
                 if ((isDefaultAcquired || endsWithZeroZero) && !hasNameTag && !hasOtherStickers)
                 {
                     // If this is a base item with no name tag and this is the only sticker, delete it
-                    CSOEconItem *item = FetchItemFromDatabase(itemId, steamId, inventory_db);
+                    CSOEconItem *item = GetItem(itemId, steamId, inventory_db);
 
                     // Delete the item from the database
                     snprintf(query, sizeof(query),
-                             "DELETE FROM csgo_items WHERE id = %llu AND owner_steamid2 = '%s'",
-                             itemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+                             "DELETE FROM csgo_items WHERE id = %llu AND owner_account_id = %u",
+                             itemId, GCNetwork_Users::SteamID64ToAccountID(steamId));
 
                     if (mysql_query(inventory_db, query) != 0)
                     {
@@ -3984,6 +4507,7 @@ bool GCNetwork_Inventory::HandleScrapeSticker(
                         delete item;
                         return false;
                     }
+                    InventoryCache::GetInstance()->Remove(steamId, itemId);
 
                     // Send delete notification
                     bool deleteSent = SendSOSingleObject(p2psocket, steamId, SOTypeItem, *item, k_EMsgGC_CC_DeleteItem);
@@ -4005,18 +4529,18 @@ bool GCNetwork_Inventory::HandleScrapeSticker(
             // Just remove the sticker from this slot
             snprintf(query, sizeof(query),
                      "UPDATE csgo_items SET sticker_%u = NULL, sticker_%u_wear = NULL "
-                     "WHERE id = %llu AND owner_steamid2 = '%s'",
+                     "WHERE id = %llu AND owner_account_id = %u",
                      stickerSlot + 1, stickerSlot + 1,
-                     itemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+                     itemId, GCNetwork_Users::SteamID64ToAccountID(steamId));
         }
         else
         {
             // Just increase the wear value
             snprintf(query, sizeof(query),
                      "UPDATE csgo_items SET sticker_%u_wear = %f "
-                     "WHERE id = %llu AND owner_steamid2 = '%s'",
+                     "WHERE id = %llu AND owner_account_id = %u",
                      stickerSlot + 1, newWear,
-                     itemId, GCNetwork_Users::SteamID64ToSteamID2(steamId).c_str());
+                     itemId, GCNetwork_Users::SteamID64ToAccountID(steamId));
         }
 
         if (mysql_query(inventory_db, query) != 0)
@@ -4265,6 +4789,7 @@ bool GCNetwork_Inventory::ProcessStorePurchase(
             return false;
         }
 
+        RefreshCachedItems(steamId, itemIds, inventory_db);
         return true;
     }
     catch (const std::exception &e)
@@ -5,12 +5,84 @@
 #include "steam_network_message.hpp"
 #include "item_schema.hpp"
 #include "cc_gcmessages.pb.h"
+#include "item_event_feed.hpp"
+#include "inventory.hpp"
+#include <chrono>
 #include <sstream>
 #include <iomanip>
+#include <string_view>
 #include <mariadb/mysql.h>
 
 extern ItemSchema *g_itemSchema;
 
+// csgo_items.item_kind, the prefix of item_id
+enum ItemKind
+{
+    ItemKindUnknown = 0,
+    ItemKindSkin = 1,
+    ItemKindMusicKit = 2,
+    ItemKindSticker = 3,
+    ItemKindCrate = 4,
+    ItemKindKey = 5,
+    ItemKindCollectible = 6
+};
+
+// One csgo_items row in the column order of ITEM_SELECT_COLUMNS, filled by the
+// binary protocol of a prepared statement instead of being parsed from text
+struct ItemRow
+{
+    // the trailing owner_account_id column is only bound by queries that select it
+    static constexpr int ColumnCount = 29;
+
+    uint64_t id;
+    char itemId[64];
+    float floatval;
+    int32_t rarity;
+    int32_t quality;
+    int32_t tradable;
+    int32_t stattrak;
+    int32_t stattrakKills;
+    int32_t stickers[5];
+    float stickerWear[5];
+    char nametag[256];
+    int32_t patternIndex;
+    int32_t equippedCt;
+    int32_t equippedT;
+    int32_t acknowledged;
+    char acquiredBy[32];
+    uint32_t defIndex;
+    uint32_t paintIndex;
+    uint8_t itemKind;
+    uint32_t rowVersion;
+    uint32_t ownerAccountId;
+
+    my_bool isNull[ColumnCount];
+    unsigned long lengths[ColumnCount];
+    MYSQL_BIND binds[ColumnCount];
+
+    ItemRow() = default;
+    ItemRow(const ItemRow &) = delete;
+    ItemRow &operator=(const ItemRow &) = delete;
+
+    // points the result binds at the fields above, for DbStatement::BindResult
+    MYSQL_BIND *Bind();
+
+    // string columns, clamped to their buffers; empty when NULL
+    std::string_view ItemId() const { return Text(1, itemId, sizeof(itemId)); }
+    std::string_view Nametag() const { return Text(18, nametag, sizeof(nametag)); }
+    std::string_view AcquiredBy() const { return Text(23, acquiredBy, sizeof(acquiredBy)); }
+
+private:
+    std::string_view Text(int column, const char *buffer, size_t size) const
+    {
+        if (isNull[column])
+        {
+            return {};
+        }
+        return std::string_view(buffer, std::min<size_t>(lengths[column], size - 1));
+    }
+};
+
 class GCNetwork_Inventory
 {
 public:
@@ -23,10 +95,17 @@ public:
     static void SendSOCache(SNetSocket_t p2psocket, uint64_t steamId, MYSQL *inventory_db);
 
     // item notif
-    static bool CheckAndSendNewItemsSince(
-        SNetSocket_t p2psocket,
-        uint64_t steamId,
-        uint64_t &lastItemId,
+    static size_t SendNewItemsSince(
+        uint64_t &watermark,
+        std::vector<ItemWatch> &watches,
+        MYSQL *inventory_db,
+        uint64_t until = UINT64_MAX);
+
+    static bool GetLatestItemId(uint64_t &latestItemId, MYSQL *inventory_db);
+
+    static size_t SendItemEvents(
+        const std::vector<ItemEvent> &events,
+        std::vector<ItemWatch> &watches,
         MYSQL *inventory_db);
 
     static uint64_t GetLatestItemIdForUser(
@@ -43,7 +122,13 @@ public:
     // create item helpers (these are for creating CSOEconItems)
     static CSOEconItem *CreateItemFromDatabaseRow(
         uint64_t steamId,
-        MYSQL_ROW &row,
+        const ItemRow &row,
+        int overrideAcknowledged = -1);
+
+    static bool FillItemFromDatabaseRow(
+        CSOEconItem *item,
+        uint64_t steamId,
+        const ItemRow &row,
         int overrideAcknowledged = -1);
 
     static CSOEconItem *FetchItemFromDatabase(
@@ -52,6 +137,11 @@ public:
         MYSQL *inventory_db,
         int overrideAcknowledged = -1);
 
+    // in-memory inventory of online players, see InventoryCache
+    static CSOEconItem *GetItem(uint64_t itemId, uint64_t steamId, MYSQL *inventory_db);
+    static bool LoadInventory(uint64_t steamId, MYSQL *inventory_db, uint64_t &latestItemId);
+    static void RefreshCachedItems(uint64_t steamId, const std::vector<uint64_t> &itemIds, MYSQL *inventory_db);
+
     // Network message helpers
     static bool DeleteItem(SNetSocket_t p2psocket, uint64_t steamId, uint64_t itemId, MYSQL *inventory_db);
     static bool SendSOSingleObject(SNetSocket_t p2psocket, uint64_t steamId, SOTypeId type, const google::protobuf::MessageLite &object, uint32_t messageType = k_EMsgGC_CC_GC2CL_SOSingleObject);
@@ -64,10 +154,12 @@ public:
     static bool IsDefaultItemId(uint64_t itemId, uint32_t &defIndex, uint32_t &paintKitIndex);
 
     // Case unboxing and item creation
-    static bool HandleUnboxCrate(SNetSocket_t p2psocket, uint64_t steamId, uint64_t crateItemId, MYSQL *inventory_db);
+    static bool HandleUnboxCrate(SNetSocket_t p2psocket, uint64_t steamId, uint64_t crateItemId,
+                                 std::chrono::steady_clock::time_point receivedAt, MYSQL *inventory_db);
     static uint64_t SaveNewItemToDatabase(const CSOEconItem &item, uint64_t steamId, MYSQL *inventory_db, bool isBaseWeapon = false);
     static bool GetWeaponInfo(uint32_t defIndex, std::string &weaponName, std::string &weaponId);
-    static uint32_t GetNextInventoryPosition(uint64_t steamId, MYSQL *inventory_db);
+    static uint32_t GetNextInventoryPosition(uint64_t steamId, MYSQL *inventory_db, uint32_t count = 1);
+    static void LogUnboxStats();
 
     // Equipping and unequipping
     static bool EquipItem(SNetSocket_t p2psocket, uint64_t steamId, uint64_t itemId, uint32_t classId, uint32_t slotId, MYSQL *inventory_db);
@@ -162,6 +254,8 @@ private:
         float value;
     };
     static bool ParseItemId(const std::string &item_id, uint32_t &def_index, uint32_t &paint_index);
-    static void AddStickerAttributes(CSOEconItem *item, MYSQL_ROW &row, int sticker_index);
+    static void MarkCrateItemsSeen(const std::vector<uint64_t> &itemIds);
+    static bool ReadItemsByOwner(uint64_t steamId, MYSQL *inventory_db, ItemMap &items, ItemVersions &versions, uint64_t &latestItemId);
+    static void AddStickerAttributes(CSOEconItem *item, const ItemRow &row, int sticker_index);
     static void AddEquippedState(CSOEconItem *item, bool equipped, uint32_t class_id, uint32_t def_index);
 };
\ No newline at end of file
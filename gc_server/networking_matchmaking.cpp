@@ -7,7 +7,7 @@
 void GCNetwork_Matchmaking::HandleMatchmakingClient2GCHello(SNetSocket_t p2psocket, void* message, 
                                                            uint32_t msgsize, uint64_t steamId, 
                                                            MYSQL* ranked_db) {
-    NetworkMessage netMsg(message, msgsize);
+    NetworkMessageView netMsg(message, msgsize);
     CMsgGCCStrike15_v2_MatchmakingClient2GCHello request;
     
     if (!netMsg.ParseTo(&request)) {
@@ -35,7 +35,7 @@ void GCNetwork_Matchmaking::HandleMatchmakingClient2GCHello(SNetSocket_t p2psock
 void GCNetwork_Matchmaking::HandleMatchmakingStart(SNetSocket_t p2psocket, void* message,
                                                   uint32_t msgsize, uint64_t steamId,
                                                   MYSQL* ranked_db) {
-    NetworkMessage netMsg(message, msgsize);
+    NetworkMessageView netMsg(message, msgsize);
     CMsgGCCStrike15_v2_MatchmakingStart request;
     
     if (!netMsg.ParseTo(&request)) {
@@ -81,7 +81,7 @@ void GCNetwork_Matchmaking::HandleMatchmakingStart(SNetSocket_t p2psocket, void*
 
 void GCNetwork_Matchmaking::HandleMatchmakingStop(SNetSocket_t p2psocket, void* message,
                                                  uint32_t msgsize, uint64_t steamId) {
-    NetworkMessage netMsg(message, msgsize);
+    NetworkMessageView netMsg(message, msgsize);
     CMsgGCCStrike15_v2_MatchmakingStop request;
     
     if (!netMsg.ParseTo(&request)) {
@@ -155,7 +155,7 @@ void GCNetwork_Matchmaking::HandleMatchmakingDecline(SNetSocket_t p2psocket, voi
 
 void GCNetwork_Matchmaking::HandleMatchEnd(SNetSocket_t p2psocket, void* message,
                                           uint32_t msgsize, uint64_t steamId, MYSQL* ranked_db) {
-    NetworkMessage netMsg(message, msgsize);
+    NetworkMessageView netMsg(message, msgsize);
     CMsgGCCStrike15_v2_MatchmakingServerMatchEnd request;
     
     if (!netMsg.ParseTo(&request)) {
@@ -225,7 +225,7 @@ void GCNetwork_Matchmaking::HandleMatchEnd(SNetSocket_t p2psocket, void* message
 
 void GCNetwork_Matchmaking::HandleMatchRoundStats(SNetSocket_t p2psocket, void* message,
                                                  uint32_t msgsize, uint64_t steamId) {
-    NetworkMessage netMsg(message, msgsize);
+    NetworkMessageView netMsg(message, msgsize);
     CMsgGCCStrike15_v2_MatchmakingServerRoundStats request;
     
     if (!netMsg.ParseTo(&request)) {
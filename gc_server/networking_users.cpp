@@ -1,4 +1,7 @@
 #include "networking_users.hpp"
+#include "networking_inventory.hpp" // ItemKind
+#include "profile_cache.hpp"
+#include "write_behind.hpp"
 
 std::string GCNetwork_Users::SteamID64ToSteamID2(uint64_t steamId64)
 {
@@ -50,111 +53,80 @@ RankId ScoreToRankId(int score)
     return RankGlobalElite;
 }
 
-uint32_t GCNetwork_Users::GetPlayerRankId(const std::string &steamId2, MYSQL *ranked_db)
+// query text and result parsing for the async lookups of BuildMatchmakingHello
+// and ViewPlayersProfile, each query goes out on its own connection at once
+
+// rank and wins live in the same row, one round trip for both
+static std::string PlayerRankingQuery(const std::string &steamId2)
 {
     char query[512];
     snprintf(query, sizeof(query),
-             "SELECT score FROM ranked WHERE steam = '%s'",
+             "SELECT score, match_win FROM ranked WHERE steam = '%s'",
              steamId2.c_str());
-
-    if (mysql_query(ranked_db, query) == 0)
-    {
-        MYSQL_RES *result = mysql_store_result(ranked_db);
-        if (result)
-        {
-            MYSQL_ROW row = mysql_fetch_row(result);
-            if (row)
-            {
-                int score = row[0] ? atoi(row[0]) : 0;
-                mysql_free_result(result);
-                return static_cast<uint32_t>(ScoreToRankId(score));
-            }
-            mysql_free_result(result);
-        }
-    }
-    else
-    {
-        logger::error("Failed to query rank info: %s", mysql_error(ranked_db));
-    }
-    return static_cast<uint32_t>(RankNone);
+    return query;
 }
 
-uint32_t GCNetwork_Users::GetPlayerWins(const std::string &steamId2, MYSQL *ranked_db)
+static GCNetwork_Users::PlayerRanking ReadPlayerRanking(MYSQL_RES *result)
 {
-    char query[512];
-    snprintf(query, sizeof(query),
-             "SELECT match_win FROM ranked WHERE steam = '%s'",
-             steamId2.c_str());
+    GCNetwork_Users::PlayerRanking ranking = {static_cast<uint32_t>(RankNone), 0};
 
-    if (mysql_query(ranked_db, query) == 0)
+    MYSQL_ROW row = result ? mysql_fetch_row(result) : nullptr;
+    if (!row)
     {
-        MYSQL_RES *result = mysql_store_result(ranked_db);
-        if (result)
-        {
-            MYSQL_ROW row = mysql_fetch_row(result);
-            if (row)
-            {
-                uint32_t wins = row[0] ? atoi(row[0]) : 0;
-                mysql_free_result(result);
-                return wins;
-            }
-            mysql_free_result(result);
-        }
+        return ranking;
     }
-    else
-    {
-        logger::error("Failed to query wins info: %s", mysql_error(ranked_db));
-    }
-    return 0;
+
+    int score = row[0] ? atoi(row[0]) : 0;
+    ranking.rankId = static_cast<uint32_t>(ScoreToRankId(score));
+    ranking.wins = row[1] ? atoi(row[1]) : 0;
+    return ranking;
 }
 
 // COMMENDS
 
-// fetch commends
-GCNetwork_Users::PlayerCommends GCNetwork_Users::GetPlayerCommends(uint64_t steamId, MYSQL *inventory_db)
+// totals are kept by triggers on player_commends (see SchemaMigrations), one row per receiver
+static std::string PlayerCommendsQuery(uint64_t steamId)
 {
-    PlayerCommends commends = {0, 0, 0}; // Initialize all to 0
-
     char query[512];
     snprintf(query, sizeof(query),
-             "SELECT type, COUNT(*) as count "
-             "FROM player_commends "
-             "WHERE receiver_steamid64 = %llu "
-             "GROUP BY type",
+             "SELECT friendly, teaching, leader "
+             "FROM player_commend_counts "
+             "WHERE receiver_steamid64 = %llu",
              steamId);
+    return query;
+}
 
-    if (mysql_query(inventory_db, query) == 0)
+static GCNetwork_Users::PlayerCommends ReadPlayerCommends(MYSQL_RES *result)
+{
+    GCNetwork_Users::PlayerCommends commends = {0, 0, 0}; // Initialize all to 0
+    MYSQL_ROW row = result ? mysql_fetch_row(result) : nullptr;
+    if (!row)
     {
-        MYSQL_RES *result = mysql_store_result(inventory_db);
-        if (result)
-        {
-            MYSQL_ROW row;
-            while ((row = mysql_fetch_row(result)))
-            {
-                int type = atoi(row[0]);
-                int count = atoi(row[1]);
-
-                switch (type)
-                {
-                case 1:
-                    commends.friendly = count;
-                    break;
-                case 2:
-                    commends.teaching = count;
-                    break;
-                case 3:
-                    commends.leader = count;
-                    break;
-                }
-            }
-            mysql_free_result(result);
-        }
+        return commends;
     }
-    else
+
+    // a drifted counter can go below zero until it's rebuilt
+    commends.friendly = row[0] ? std::max(0, atoi(row[0])) : 0;
+    commends.teaching = row[1] ? std::max(0, atoi(row[1])) : 0;
+    commends.leader = row[2] ? std::max(0, atoi(row[2])) : 0;
+    return commends;
+}
+
+// fetch commends
+GCNetwork_Users::PlayerCommends GCNetwork_Users::GetPlayerCommends(uint64_t steamId, MYSQL *inventory_db)
+{
+    if (mysql_query(inventory_db, PlayerCommendsQuery(steamId).c_str()) != 0)
     {
         logger::error("Failed to query commendations: %s", mysql_error(inventory_db));
+        return {0, 0, 0};
     }
 
+    MYSQL_RES *result = mysql_store_result(inventory_db);
+    PlayerCommends commends = ReadPlayerCommends(result);
+    if (result)
+    {
+        mysql_free_result(result);
+    }
     return commends;
 }
 
@@ -198,17 +170,9 @@ int GCNetwork_Users::GetPlayerCommendTokens(uint64_t steamId, MYSQL *inventory_d
 }
 
 // handle query
-void GCNetwork_Users::HandleCommendPlayerQuery(SNetSocket_t p2psocket, void *message, uint32 msgsize,
+void GCNetwork_Users::HandleCommendPlayerQuery(SNetSocket_t p2psocket, const CMsgGC_CC_ClientCommendPlayer &request,
                                                uint64_t senderSteamId, MYSQL *inventory_db)
 {
-    NetworkMessage netMsg(message, msgsize);
-    CMsgGC_CC_ClientCommendPlayer request;
-    if (!netMsg.ParseTo(&request))
-    {
-        logger::error("Failed to parse commend player query");
-        return;
-    }
-
     // Extract target information from the request
     uint32_t targetAccountId = request.account_id();
     uint64_t targetSteamId = ((uint64_t)1 << 56) | ((uint64_t)1 << 52) | ((uint64_t)1 << 32) | targetAccountId;
@@ -282,18 +246,9 @@ void GCNetwork_Users::HandleCommendPlayerQuery(SNetSocket_t p2psocket, void *mes
 }
 
 // actual commend
-void GCNetwork_Users::HandleCommendPlayer(SNetSocket_t p2psocket, void *message, uint32 msgsize,
+void GCNetwork_Users::HandleCommendPlayer(SNetSocket_t p2psocket, const CMsgGC_CC_ClientCommendPlayer &request,
                                           uint64_t senderSteamId, MYSQL *inventory_db)
 {
-    NetworkMessage netMsg(message, msgsize);
-    CMsgGC_CC_ClientCommendPlayer request;
-
-    if (!netMsg.ParseTo(&request))
-    {
-        logger::error("Failed to parse commend player request");
-        return;
-    }
-
     uint32_t targetAccountId = request.account_id();
     uint64_t targetSteamId = ((uint64_t)1 << 56) | ((uint64_t)1 << 52) | ((uint64_t)1 << 32) | targetAccountId;
 
@@ -383,9 +338,17 @@ void GCNetwork_Users::HandleCommendPlayer(SNetSocket_t p2psocket, void *message,
         }
     }
 
+    // all changes of one request land together, the counter triggers run in the same transaction
+    if (mysql_query(inventory_db, "START TRANSACTION") != 0)
+    {
+        logger::error("Failed to start commendation transaction: %s", mysql_error(inventory_db));
+        return;
+    }
+
     // Track if any changes were made
     bool commendAdded = false;
     bool commendRemoved = false;
+    bool writeFailed = false;
 
     // Process friendly commendation
     if (newFriendly != existingFriendly)
@@ -407,6 +370,7 @@ void GCNetwork_Users::HandleCommendPlayer(SNetSocket_t p2psocket, void *message,
             else
             {
                 logger::error("Failed to insert friendly commendation: %s", mysql_error(inventory_db));
+                writeFailed = true;
             }
         }
         else
@@ -428,6 +392,7 @@ void GCNetwork_Users::HandleCommendPlayer(SNetSocket_t p2psocket, void *message,
             else
             {
                 logger::error("Failed to remove friendly commendation: %s", mysql_error(inventory_db));
+                writeFailed = true;
             }
         }
     }
@@ -452,6 +417,7 @@ void GCNetwork_Users::HandleCommendPlayer(SNetSocket_t p2psocket, void *message,
             else
             {
                 logger::error("Failed to insert teaching commendation: %s", mysql_error(inventory_db));
+                writeFailed = true;
             }
         }
         else
@@ -473,6 +439,7 @@ void GCNetwork_Users::HandleCommendPlayer(SNetSocket_t p2psocket, void *message,
             else
             {
                 logger::error("Failed to remove teaching commendation: %s", mysql_error(inventory_db));
+                writeFailed = true;
             }
         }
     }
@@ -497,6 +464,7 @@ void GCNetwork_Users::HandleCommendPlayer(SNetSocket_t p2psocket, void *message,
             else
             {
                 logger::error("Failed to insert leader commendation: %s", mysql_error(inventory_db));
+                writeFailed = true;
             }
         }
         else
@@ -518,13 +486,23 @@ void GCNetwork_Users::HandleCommendPlayer(SNetSocket_t p2psocket, void *message,
             else
             {
                 logger::error("Failed to remove leader commendation: %s", mysql_error(inventory_db));
+                writeFailed = true;
             }
         }
     }
 
+    if (writeFailed || mysql_query(inventory_db, "COMMIT") != 0)
+    {
+        logger::error("Commendation changes rolled back: sender=%llu, target=%llu", senderSteamId, targetSteamId);
+        mysql_query(inventory_db, "ROLLBACK");
+        return;
+    }
+
     // Log if any changes were made
     if (commendAdded || commendRemoved)
     {
+        ProfileCache::GetInstance()->Invalidate(targetAccountId);
+
         if (needToken)
         {
             logger::info("Commendation transaction complete: sender=%llu, target=%llu, tokens_remaining=%d",
@@ -578,7 +556,9 @@ int GCNetwork_Users::GetPlayerReportTokens(uint64_t steamId, MYSQL *inventory_db
             MYSQL_ROW row = mysql_fetch_row(result);
             if (row)
             {
+                // reports still in the write-behind queue use a token too
                 int used_tokens = row[0] ? atoi(row[0]) : 0;
+                used_tokens += WriteBehindQueue::GetInstance()->PendingReportCount(steamId);
                 mysql_free_result(result);
 
                 // Return remaining tokens
@@ -592,21 +572,13 @@ int GCNetwork_Users::GetPlayerReportTokens(uint64_t steamId, MYSQL *inventory_db
         logger::error("Failed to query report tokens: %s", mysql_error(inventory_db));
     }
 
-    return DEFAULT_TOKENS; // Default if query fails
+    // Default if query fails
+    return std::max(0, DEFAULT_TOKENS - (int)WriteBehindQueue::GetInstance()->PendingReportCount(steamId));
 }
 
-void GCNetwork_Users::HandlePlayerReport(SNetSocket_t p2psocket, void *message, uint32 msgsize,
+void GCNetwork_Users::HandlePlayerReport(SNetSocket_t p2psocket, const CMsgGC_CC_CL2GC_ClientReportPlayer &request,
                                          uint64_t senderSteamId, MYSQL *inventory_db)
 {
-    NetworkMessage netMsg(message, msgsize);
-    CMsgGC_CC_CL2GC_ClientReportPlayer request;
-
-    if (!netMsg.ParseTo(&request))
-    {
-        logger::error("Failed to parse player report request");
-        return;
-    }
-
     uint32_t targetAccountId = request.account_id();
     uint64_t targetSteamId = ((uint64_t)1 << 56) | ((uint64_t)1 << 52) | ((uint64_t)1 << 32) | targetAccountId;
 
@@ -664,6 +636,12 @@ void GCNetwork_Users::HandlePlayerReport(SNetSocket_t p2psocket, void *message,
             logger::error("Failed to check existing reports: %s", mysql_error(inventory_db));
         }
 
+        // a report still in the write-behind queue isn't in the table yet
+        if (WriteBehindQueue::GetInstance()->IsReportPending(senderSteamId, targetSteamId))
+        {
+            canReport = false;
+        }
+
         if (!canReport)
         {
             // Already reported this player in the past week
@@ -677,7 +655,6 @@ void GCNetwork_Users::HandlePlayerReport(SNetSocket_t p2psocket, void *message,
         else
         {
             // Process reports - check all possible report types
-            bool reportSubmitted = false;
             uint64_t matchId = request.has_match_id() ? request.match_id() : 0;
 
             // Structure to track which report types were submitted
@@ -715,49 +692,27 @@ void GCNetwork_Users::HandlePlayerReport(SNetSocket_t p2psocket, void *message,
             }
             else
             {
-                // Process all report types that were selected
+                // one write for every type, applied in the background as a single
+                // multi-row INSERT so the client doesn't wait on the database
+                uint32_t types = 0;
                 for (int i = 0; i < 6; i++)
                 {
                     if (reportTypes[i].submitted)
                     {
-                        char query[1024];
-                        snprintf(query, sizeof(query),
-                                 "INSERT INTO player_reports (sender_steamid64, receiver_steamid64, type, match_id) "
-                                 "VALUES (%llu, %llu, %d, %llu)",
-                                 senderSteamId, targetSteamId, i + 1, matchId);
-
-                        if (mysql_query(inventory_db, query) == 0)
-                        {
-                            reportSubmitted = true;
-                            logger::info("Report type '%s' submitted: sender=%llu, target=%llu",
-                                         reportTypes[i].name, senderSteamId, targetSteamId);
-                        }
-                        else
-                        {
-                            logger::error("Failed to insert '%s' report: %s",
-                                          reportTypes[i].name, mysql_error(inventory_db));
-                        }
+                        types |= 1u << i;
+                        logger::info("Report type '%s' submitted: sender=%llu, target=%llu",
+                                     reportTypes[i].name, senderSteamId, targetSteamId);
                     }
                 }
 
-                if (reportSubmitted)
-                {
-                    response.set_response_type(0);            // Success
-                    response.set_response_result(0);          // Success
-                    response.set_tokens(availableTokens - 1); // Decrease available tokens
+                WriteBehindQueue::GetInstance()->PlayerReport(senderSteamId, targetSteamId, types, matchId);
 
-                    logger::info("Reports processed successfully: sender=%llu, target=%llu, types=%d, tokens_remaining=%d",
-                                 senderSteamId, targetSteamId, reportCount, availableTokens - 1);
-                }
-                else
-                {
-                    response.set_response_type(0);   // Error
-                    response.set_response_result(1); // General error
-                    response.set_tokens(availableTokens);
+                response.set_response_type(0);            // Success
+                response.set_response_result(0);          // Success
+                response.set_tokens(availableTokens - 1); // Decrease available tokens
 
-                    logger::error("All reports failed for sender=%llu, target=%llu",
-                                  senderSteamId, targetSteamId);
-                }
+                logger::info("Reports processed successfully: sender=%llu, target=%llu, types=%d, tokens_remaining=%d",
+                             senderSteamId, targetSteamId, reportCount, availableTokens - 1);
             }
         }
     }
@@ -769,158 +724,75 @@ void GCNetwork_Users::HandlePlayerReport(SNetSocket_t p2psocket, void *message,
 
 // HELPERS
 
-void GCNetwork_Users::GetPlayerMedals(uint64_t steamId, PlayerMedalsInfo *medals, MYSQL *inventory_db)
+static std::string PlayerMedalsQuery(uint64_t steamId)
 {
-    std::string steamId2 = SteamID64ToSteamID2(steamId);
-
     char query[512];
     snprintf(query, sizeof(query),
-             "SELECT item_id, equipped_t, equipped_ct "
+             "SELECT def_index, equipped_t, equipped_ct "
              "FROM csgo_items "
-             "WHERE owner_steamid2 = '%s' "
-             "AND item_id LIKE 'collectible-%%'",
-             steamId2.c_str());
-
-    if (mysql_query(inventory_db, query) == 0)
-    {
-        MYSQL_RES *result = mysql_store_result(inventory_db);
-        if (result)
-        {
-            MYSQL_ROW row;
-            bool found_featured = false;
-
-            while ((row = mysql_fetch_row(result)))
-            {
-                // parse defindex from item_id
-                const char *item_id = row[0];
-                const char *defindex_str = strchr(item_id, '-');
-                if (!defindex_str)
-                    continue;
-
-                uint32_t defindex = atoi(defindex_str + 1); // skip '-'
-                if (defindex == 0)
-                    continue;
-
-                // add
-                medals->add_display_items_defidx(defindex);
-
-                // for set_featured_display_item_defidx
-                bool equipped_t = row[1] ? atoi(row[1]) == 1 : false;
-                bool equipped_ct = row[2] ? atoi(row[2]) == 1 : false;
-
-                if (equipped_t && equipped_ct && !found_featured)
-                {
-                    medals->set_featured_display_item_defidx(defindex);
-                    found_featured = true;
-                }
-            }
-
-            if (!found_featured)
-            {
-                medals->set_featured_display_item_defidx(0);
-            }
-
-            mysql_free_result(result);
-        }
-    }
-    else
-    {
-        logger::error("Failed to query medals: %s", mysql_error(inventory_db));
-    }
+             "WHERE owner_account_id = %u AND item_kind = %u",
+             GCNetwork_Users::SteamID64ToAccountID(steamId), static_cast<uint32_t>(ItemKindCollectible));
+    return query;
 }
 
-bool GCNetwork_Users::IsPlayerBanned(const std::string &steamId2, MYSQL *classiccounter_db)
+static void ReadPlayerMedals(MYSQL_RES *result, PlayerMedalsInfo *medals)
 {
-    char query[512];
-    snprintf(query, sizeof(query),
-             "SELECT COUNT(*) as ban_count FROM sb_bans WHERE authid = '%s' AND length = 0 AND RemoveType IS NULL",
-             steamId2.c_str());
-
-    if (mysql_query(classiccounter_db, query) == 0)
-    {
-        MYSQL_RES *result = mysql_store_result(classiccounter_db);
-        if (result)
-        {
-            MYSQL_ROW row = mysql_fetch_row(result);
-            if (row)
-            {
-                int ban_count = row[0] ? atoi(row[0]) : 0;
-                mysql_free_result(result);
-                return ban_count > 0;
-            }
-            mysql_free_result(result);
-        }
-    }
-    else
+    if (!result)
     {
-        logger::error("Failed to query bans: %s", mysql_error(classiccounter_db));
+        return;
     }
-    return false;
-}
 
-void GCNetwork_Users::GetPlayerCooldownInfo(const std::string &steamId2, CMsgGC_CC_GC2CL_BuildMatchmakingHello &message, MYSQL *classiccounter_db)
-{
-    char query[512];
-    snprintf(query, sizeof(query),
-             "SELECT cooldown_reason, cooldown_expire, acknowledged "
-             "FROM cooldowns "
-             "WHERE sid = '%s' "
-             "ORDER BY id DESC LIMIT 1",
-             steamId2.c_str());
+    MYSQL_ROW row;
+    bool found_featured = false;
 
-    if (mysql_query(classiccounter_db, query) == 0)
+    while ((row = mysql_fetch_row(result)))
     {
-        MYSQL_RES *result = mysql_store_result(classiccounter_db);
-        if (result)
-        {
-            MYSQL_ROW row = mysql_fetch_row(result);
-            if (row)
-            {
-                int acknowledged = row[2] ? atoi(row[2]) : 0;
-
-                // only set if cooldown is unacknowledged
-                if (acknowledged == 0)
-                {
-                    // get reason
-                    int reason = row[0] ? atoi(row[0]) : 0;
-
-                    // get time
-                    time_t expire_time = row[1] ? atol(row[1]) : 0;
-                    time_t current_time = time(NULL);
+        uint32_t defindex = row[0] ? strtoul(row[0], nullptr, 10) : 0;
+        if (defindex == 0)
+            continue;
 
-                    // calculate seconds
-                    int penalty_seconds = 0;
-                    if (expire_time > 0)
-                    {
-                        penalty_seconds = (expire_time > current_time) ? static_cast<int>(expire_time - current_time) : 0;
-                    }
+        // add
+        medals->add_display_items_defidx(defindex);
 
-                    message.set_penalty_reason(reason);
-                    message.set_penalty_seconds(penalty_seconds);
+        // for set_featured_display_item_defidx
+        bool equipped_t = row[1] ? atoi(row[1]) == 1 : false;
+        bool equipped_ct = row[2] ? atoi(row[2]) == 1 : false;
 
-                    logger::info("Setting cooldown for %s: reason=%d, seconds=%d", steamId2.c_str(), reason, penalty_seconds);
-                }
-            }
-            mysql_free_result(result);
+        if (equipped_t && equipped_ct && !found_featured)
+        {
+            medals->set_featured_display_item_defidx(defindex);
+            found_featured = true;
         }
     }
-    else
+
+    if (!found_featured)
     {
-        logger::error("Failed to query cooldown info: %s", mysql_error(classiccounter_db));
+        medals->set_featured_display_item_defidx(0);
     }
 }
 
-// PROTOBUF MESSAGES
-
-void GCNetwork_Users::BuildMatchmakingHello(CMsgGC_CC_GC2CL_BuildMatchmakingHello &message,
-                                            uint64_t steamId, MYSQL *classiccounter_db,
-                                            MYSQL *inventory_db, MYSQL *ranked_db)
+void GCNetwork_Users::BuildMatchmakingHello(uint64_t steamId, const BanIndex &bans,
+                                            AsyncDatabase *inventory_db, AsyncDatabase *ranked_db,
+                                            std::function<void(const CMsgGC_CC_GC2CL_BuildMatchmakingHello &)> done)
 {
+    // every lookup is in flight at once, the callbacks run on the loop thread
+    // so the counter needs no lock
+    struct Pending
+    {
+        CMsgGC_CC_GC2CL_BuildMatchmakingHello message;
+        std::string steamId2;
+        int remaining = 2;
+        std::function<void(const CMsgGC_CC_GC2CL_BuildMatchmakingHello &)> done;
+    };
+
+    auto pending = std::make_shared<Pending>();
+    pending->steamId2 = SteamID64ToSteamID2(steamId);
+    pending->done = std::move(done);
+
+    CMsgGC_CC_GC2CL_BuildMatchmakingHello &message = pending->message;
     uint32_t accountId = steamId & 0xFFFFFFFF;
     message.set_account_id(accountId);
 
-    std::string steamId2 = SteamID64ToSteamID2(steamId);
-
     // GLOBAL
     auto globalStats = message.mutable_global_stats();
     globalStats->set_players_online(0);
@@ -939,52 +811,102 @@ void GCNetwork_Users::BuildMatchmakingHello(CMsgGC_CC_GC2CL_BuildMatchmakingHell
 
     globalStats->set_required_appid_version(ClientVersion);
 
-    // banned?
-    message.set_vac_banned(IsPlayerBanned(steamId2, classiccounter_db) ? 1 : 0);
-
     // RANK
     auto ranking = message.mutable_ranking();
     ranking->set_account_id(accountId);
-    ranking->set_rank_id(GetPlayerRankId(steamId2, ranked_db));
-    ranking->set_wins(GetPlayerWins(steamId2, ranked_db));
     ranking->set_rank_change(0.0f);
 
-    // COMMENDS
-    auto commends = GetPlayerCommends(steamId, inventory_db);
-    auto commendation = message.mutable_commendation();
-    commendation->set_cmd_friendly(commends.friendly);
-    commendation->set_cmd_teaching(commends.teaching);
-    commendation->set_cmd_leader(commends.leader);
-
-    // COOLDOWN
-    GetPlayerCooldownInfo(steamId2, message, classiccounter_db);
-
     // uhhh soon...?
     message.set_player_level(1); // todo: fetch from db
     message.set_player_cur_xp(0);
     // idk what this does
     message.set_player_xp_bonus_flags(0);
-}
 
-void GCNetwork_Users::ViewPlayersProfile(SNetSocket_t p2psocket, void *message, uint32 msgsize,
-                                         MYSQL *classiccounter_db, MYSQL *inventory_db, MYSQL *ranked_db)
-{
-    NetworkMessage netMsg(message, msgsize);
-    CMsgGC_CC_CL2GC_ViewPlayersProfileRequest request;
-    if (!netMsg.ParseTo(&request))
+    // banned?
+    message.set_vac_banned(bans.IsBanned(accountId) ? 1 : 0);
+
+    // COOLDOWN, only set if unacknowledged
+    PlayerCooldown cooldown;
+    if (bans.GetCooldown(accountId, cooldown))
     {
-        logger::error("Failed to parse view profile request");
-        return;
+        time_t current_time = time(NULL);
+
+        // calculate seconds
+        int penalty_seconds = 0;
+        if (cooldown.expire > 0)
+        {
+            penalty_seconds = (cooldown.expire > current_time) ? static_cast<int>(cooldown.expire - current_time) : 0;
+        }
+
+        message.set_penalty_reason(cooldown.reason);
+        message.set_penalty_seconds(penalty_seconds);
+
+        logger::info("Setting cooldown for %s: reason=%u, seconds=%d", pending->steamId2.c_str(), cooldown.reason, penalty_seconds);
     }
 
+    auto finish = [pending](const char *lookup, const AsyncResult &result)
+    {
+        if (!result.Ok())
+        {
+            logger::error("Failed to query %s: %s", lookup, result.Error().c_str());
+        }
+
+        if (--pending->remaining == 0)
+        {
+            pending->done(pending->message);
+        }
+    };
+
+    ranked_db->Query(PlayerRankingQuery(pending->steamId2), [pending, finish](const AsyncResult &result)
+    {
+        PlayerRanking ranking = ReadPlayerRanking(result.Get());
+        pending->message.mutable_ranking()->set_rank_id(ranking.rankId);
+        pending->message.mutable_ranking()->set_wins(ranking.wins);
+        finish("rank info", result);
+    });
+
+    // COMMENDS
+    inventory_db->Query(PlayerCommendsQuery(steamId), [pending, finish](const AsyncResult &result)
+    {
+        PlayerCommends commends = ReadPlayerCommends(result.Get());
+        auto commendation = pending->message.mutable_commendation();
+        commendation->set_cmd_friendly(commends.friendly);
+        commendation->set_cmd_teaching(commends.teaching);
+        commendation->set_cmd_leader(commends.leader);
+        finish("commendations", result);
+    });
+}
+
+void GCNetwork_Users::ViewPlayersProfile(SNetSocket_t p2psocket, const CMsgGC_CC_CL2GC_ViewPlayersProfileRequest &request,
+                                         AsyncDatabase *inventory_db, AsyncDatabase *ranked_db)
+{
     uint32_t targetAccountId = request.account_id();
     uint64_t targetSteamId = ((uint64_t)1 << 56) | ((uint64_t)1 << 52) | ((uint64_t)1 << 32) | targetAccountId;
     std::string steamId2 = SteamID64ToSteamID2(targetSteamId);
 
     // logger::info("Processing profile request for account %u (STEAM_ID: %s)", targetAccountId, steamId2.c_str());
 
-    CMsgGC_CC_GC2CL_ViewPlayersProfileResponse response;
-    auto profile = response.add_account_profiles();
+    ProfileCache *cache = ProfileCache::GetInstance();
+    CMsgGC_CC_GC2CL_ViewPlayersProfileResponse cached;
+    if (cache->Get(targetAccountId, cached))
+    {
+        NetworkMessage responseMsg = NetworkMessage::FromProto(cached, k_EMsgGC_CC_GC2CL_ViewPlayersProfileResponse);
+        responseMsg.WriteToSocket(p2psocket, true);
+        return;
+    }
+
+    // same fan-out as BuildMatchmakingHello, the reply goes out with the last lookup
+    struct Pending
+    {
+        CMsgGC_CC_GC2CL_ViewPlayersProfileResponse response;
+        int remaining = 3;
+        bool failed = false;
+        uint64_t generation;
+    };
+
+    auto pending = std::make_shared<Pending>();
+    pending->generation = cache->Generation();
+    auto profile = pending->response.add_account_profiles();
 
     // ACCOUNT
     profile->set_account_id(targetAccountId);
@@ -992,30 +914,67 @@ void GCNetwork_Users::ViewPlayersProfile(SNetSocket_t p2psocket, void *message,
     // RANK
     auto ranking = profile->mutable_ranking();
     ranking->set_account_id(targetAccountId);
-    ranking->set_rank_id(GetPlayerRankId(steamId2, ranked_db));
-    ranking->set_wins(GetPlayerWins(steamId2, ranked_db));
     ranking->set_rank_change(0.0f);
 
-    // COMMENDS
-    auto commends = GetPlayerCommends(targetSteamId, inventory_db);
-    auto commendation = profile->mutable_commendation();
-    commendation->set_cmd_friendly(commends.friendly);
-    commendation->set_cmd_teaching(commends.teaching);
-    commendation->set_cmd_leader(commends.leader);
-
-    // MEDALS
-    auto medals = profile->mutable_medals();
-    GetPlayerMedals(targetSteamId, medals, inventory_db);
-
     // OTHER (SOON)
     profile->set_player_level(1); // todo: fetch from db
     profile->set_player_cur_xp(0);
 
-    NetworkMessage responseMsg = NetworkMessage::FromProto(response, k_EMsgGC_CC_GC2CL_ViewPlayersProfileResponse);
-    responseMsg.WriteToSocket(p2psocket, true);
+    auto finish = [pending, p2psocket, targetAccountId](const char *lookup, const AsyncResult &result)
+    {
+        if (!result.Ok())
+        {
+            logger::error("Failed to query %s: %s", lookup, result.Error().c_str());
+            pending->failed = true;
+        }
+
+        if (--pending->remaining > 0)
+        {
+            return;
+        }
+
+        // a partial profile is still sent, just not kept
+        if (!pending->failed)
+        {
+            ProfileCache::GetInstance()->Put(targetAccountId, pending->generation, pending->response);
+        }
+
+        NetworkMessage responseMsg = NetworkMessage::FromProto(pending->response, k_EMsgGC_CC_GC2CL_ViewPlayersProfileResponse);
+        responseMsg.WriteToSocket(p2psocket, true);
+
+        const auto &sent = pending->response.account_profiles(0);
+        logger::info("Sent profile data for account %u (medals: %d, commends: %d/%d/%d)",
+                     targetAccountId,
+                     sent.medals().display_items_defidx_size(),
+                     sent.commendation().cmd_friendly(),
+                     sent.commendation().cmd_teaching(),
+                     sent.commendation().cmd_leader());
+    };
 
-    logger::info("Sent profile data for account %u (medals: %d, commends: %d/%d/%d)",
-                 targetAccountId,
-                 medals->display_items_defidx_size(),
-                 commends.friendly, commends.teaching, commends.leader);
+    // profile points into pending->response, which the callbacks keep alive
+    ranked_db->Query(PlayerRankingQuery(steamId2), [pending, profile, finish](const AsyncResult &result)
+    {
+        PlayerRanking ranking = ReadPlayerRanking(result.Get());
+        profile->mutable_ranking()->set_rank_id(ranking.rankId);
+        profile->mutable_ranking()->set_wins(ranking.wins);
+        finish("rank info", result);
+    });
+
+    // COMMENDS
+    inventory_db->Query(PlayerCommendsQuery(targetSteamId), [pending, profile, finish](const AsyncResult &result)
+    {
+        PlayerCommends commends = ReadPlayerCommends(result.Get());
+        auto commendation = profile->mutable_commendation();
+        commendation->set_cmd_friendly(commends.friendly);
+        commendation->set_cmd_teaching(commends.teaching);
+        commendation->set_cmd_leader(commends.leader);
+        finish("commendations", result);
+    });
+
+    // MEDALS
+    inventory_db->Query(PlayerMedalsQuery(targetSteamId), [pending, profile, finish](const AsyncResult &result)
+    {
+        ReadPlayerMedals(result.Get(), profile->mutable_medals());
+        finish("medals", result);
+    });
 }
\ No newline at end of file
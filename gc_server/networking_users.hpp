@@ -3,10 +3,13 @@
 #include "gc_const.hpp"
 #include "gc_const_csgo.hpp"
 #include "networking.hpp"
+#include "async_db.hpp"
+#include "ban_index.hpp"
 #include "steam_network_message.hpp" // for NetworkMessage class
 
 #include "cc_gcmessages.pb.h"
 
+#include <functional>
 #include <mariadb/mysql.h>
 
 RankId ScoreToRankId(int score);
@@ -21,32 +24,36 @@ public:
         uint32_t leader;
     };
 
-    static void BuildMatchmakingHello(CMsgGC_CC_GC2CL_BuildMatchmakingHello &message,
-                                      uint64_t steamId, MYSQL *classiccounter_db,
-                                      MYSQL *inventory_db, MYSQL *ranked_db);
+    struct PlayerRanking
+    {
+        uint32_t rankId;
+        uint32_t wins;
+    };
+
+    // bans and cooldowns come from the index, the other lookups run concurrently
+    // on the async engine and done is called on the loop thread
+    static void BuildMatchmakingHello(uint64_t steamId, const BanIndex &bans,
+                                      AsyncDatabase *inventory_db, AsyncDatabase *ranked_db,
+                                      std::function<void(const CMsgGC_CC_GC2CL_BuildMatchmakingHello &)> done);
 
-    static void ViewPlayersProfile(SNetSocket_t p2psocket, void *message, uint32 msgsize,
-                                   MYSQL *classiccounter_db, MYSQL *inventory_db, MYSQL *ranked_db);
+    static void ViewPlayersProfile(SNetSocket_t p2psocket, const CMsgGC_CC_CL2GC_ViewPlayersProfileRequest &request,
+                                   AsyncDatabase *inventory_db, AsyncDatabase *ranked_db);
 
     // commends
     static PlayerCommends GetPlayerCommends(uint64_t steamId, MYSQL *inventory_db);
     static int GetPlayerCommendTokens(uint64_t steamId, MYSQL *inventory_db);
 
-    static void HandleCommendPlayerQuery(SNetSocket_t p2psocket, void *message, uint32 msgsize,
+    static void HandleCommendPlayerQuery(SNetSocket_t p2psocket, const CMsgGC_CC_ClientCommendPlayer &request,
                                          uint64_t senderSteamId, MYSQL *inventory_db);
-    static void HandleCommendPlayer(SNetSocket_t p2psocket, void *message, uint32 msgsize,
+    static void HandleCommendPlayer(SNetSocket_t p2psocket, const CMsgGC_CC_ClientCommendPlayer &request,
                                     uint64_t senderSteamId, MYSQL *inventory_db);
 
     // reports
     static int GetPlayerReportTokens(uint64_t steamId, MYSQL *inventory_db);
-    static void HandlePlayerReport(SNetSocket_t p2psocket, void *message, uint32 msgsize,
+    static void HandlePlayerReport(SNetSocket_t p2psocket, const CMsgGC_CC_CL2GC_ClientReportPlayer &request,
                                    uint64_t senderSteamId, MYSQL *inventory_db);
 
     // helpers
     static std::string SteamID64ToSteamID2(uint64_t steamId64);
-    static bool IsPlayerBanned(const std::string &steamId2, MYSQL *classiccounter_db);
-    static void GetPlayerCooldownInfo(const std::string &steamId2, CMsgGC_CC_GC2CL_BuildMatchmakingHello &message, MYSQL *classiccounter_db);
-    static uint32_t GetPlayerRankId(const std::string &steamId2, MYSQL *ranked_db);
-    static uint32_t GetPlayerWins(const std::string &steamId2, MYSQL *ranked_db);
-    static void GetPlayerMedals(uint64_t steamId, PlayerMedalsInfo *medals, MYSQL *inventory_db);
+    static uint32_t SteamID64ToAccountID(uint64_t steamId64) { return static_cast<uint32_t>(steamId64 & 0xFFFFFFFF); }
 };
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "stdafx.h"
+#include "profile_cache.hpp"
+#include "logger.hpp"
+
+ProfileCache* ProfileCache::GetInstance()
+{
+    static ProfileCache instance;
+    return &instance;
+}
+
+bool ProfileCache::Get(uint32_t accountId, CMsgGC_CC_GC2CL_ViewPlayersProfileResponse& response)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_index.find(accountId);
+    if (it == m_index.end()) {
+        m_misses++;
+        return false;
+    }
+
+    if (it->second->expires <= Clock::now()) {
+        m_entries.erase(it->second);
+        m_index.erase(it);
+        m_expired++;
+        m_misses++;
+        return false;
+    }
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    response = it->second->response;
+    m_hits++;
+    return true;
+}
+
+uint64_t ProfileCache::Generation() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_generation;
+}
+
+void ProfileCache::Put(uint32_t accountId, uint64_t generation, const CMsgGC_CC_GC2CL_ViewPlayersProfileResponse& response)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (generation != m_generation) {
+        return;
+    }
+
+    auto it = m_index.find(accountId);
+    if (it != m_index.end()) {
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    m_entries.push_front({accountId, Clock::now() + TimeToLive, response});
+    m_index[accountId] = m_entries.begin();
+
+    while (m_entries.size() > Capacity) {
+        m_index.erase(m_entries.back().accountId);
+        m_entries.pop_back();
+        m_evictions++;
+    }
+}
+
+void ProfileCache::Invalidate(uint32_t accountId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_generation++;
+
+    auto it = m_index.find(accountId);
+    if (it != m_index.end()) {
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+    m_invalidations++;
+}
+
+void ProfileCache::LogStats() const
+{
+    size_t entries;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        entries = m_entries.size();
+    }
+
+    uint64_t hits = m_hits.load();
+    uint64_t misses = m_misses.load();
+    logger::info("ProfileCache: %zu profiles, %llu hits, %llu misses (%.1f%% hit rate), %llu expired, %llu evicted, %llu invalidated",
+                 entries, hits, misses, hits + misses ? 100.0 * hits / (hits + misses) : 0.0,
+                 m_expired.load(), m_evictions.load(), m_invalidations.load());
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "cc_gcmessages.pb.h"
+
+// Assembled ViewPlayersProfile responses, keyed by account id
+// A scoreboard opens the same handful of profiles for every player in the match,
+// so they are served from memory for a short while instead of three databases.
+// Bounded LRU with a TTL; commends and medal equips invalidate the target's entry,
+// rank changes only show up once the entry expires. Thread safe
+class ProfileCache {
+public:
+    static ProfileCache* GetInstance();
+
+    // false on a miss or when the entry has expired
+    bool Get(uint32_t accountId, CMsgGC_CC_GC2CL_ViewPlayersProfileResponse& response);
+
+    // take before querying and pass to Put, a response assembled while an
+    // invalidation happened may be stale and isn't stored
+    uint64_t Generation() const;
+    void Put(uint32_t accountId, uint64_t generation, const CMsgGC_CC_GC2CL_ViewPlayersProfileResponse& response);
+
+    void Invalidate(uint32_t accountId);
+
+    void LogStats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t Capacity = 4096;
+    static constexpr std::chrono::seconds TimeToLive{120};
+
+    struct Entry {
+        uint32_t accountId;
+        Clock::time_point expires;
+        CMsgGC_CC_GC2CL_ViewPlayersProfileResponse response;
+    };
+
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_entries; // most recently used first
+    std::unordered_map<uint32_t, std::list<Entry>::iterator> m_index;
+
+    // bumped by every Invalidate, invalidations are rare enough that a global
+    // counter costs a few skipped Puts at most
+    uint64_t m_generation = 0;
+
+    // stats
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+    std::atomic<uint64_t> m_expired{0};
+    std::atomic<uint64_t> m_evictions{0};
+    std::atomic<uint64_t> m_invalidations{0};
+};
@@ -0,0 +1,60 @@
+#include "stdafx.h"
+#include "request_arena.hpp"
+#include "logger.hpp"
+
+#include <atomic>
+#include <memory>
+
+// big enough for a few hundred items, larger requests spill into heap blocks
+// that are released again by the reset
+constexpr size_t InitialBlockSize = 256 * 1024;
+
+struct ThreadArena {
+    std::unique_ptr<char[]> block;
+    std::unique_ptr<google::protobuf::Arena> arena;
+    int depth = 0;
+};
+
+static thread_local ThreadArena t_arena;
+
+static std::atomic<uint64_t> s_requests{0};
+static std::atomic<uint64_t> s_spilled{0};
+static std::atomic<uint64_t> s_peakBytes{0};
+
+RequestArena::RequestArena()
+{
+    if (!t_arena.arena) {
+        t_arena.block.reset(new char[InitialBlockSize]);
+
+        google::protobuf::ArenaOptions options;
+        options.initial_block = t_arena.block.get();
+        options.initial_block_size = InitialBlockSize;
+        t_arena.arena = std::make_unique<google::protobuf::Arena>(options);
+    }
+
+    t_arena.depth++;
+    m_arena = t_arena.arena.get();
+}
+
+RequestArena::~RequestArena()
+{
+    if (--t_arena.depth > 0) {
+        return;
+    }
+
+    uint64_t allocated = m_arena->Reset();
+    s_requests++;
+    if (allocated > InitialBlockSize) {
+        s_spilled++;
+    }
+
+    uint64_t peak = s_peakBytes.load();
+    while (allocated > peak && !s_peakBytes.compare_exchange_weak(peak, allocated)) {
+    }
+}
+
+void RequestArena::LogStats()
+{
+    logger::info("RequestArena: %llu requests, %llu outgrew the first block, peak %llu bytes",
+                 s_requests.load(), s_spilled.load(), s_peakBytes.load());
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+#include <google/protobuf/arena.h>
+
+// Per-thread protobuf arena for message graphs that only live for one request
+// Everything created on it is freed at once when the outermost RequestArena on the
+// thread goes out of scope. The first block is owned by the thread and survives the
+// reset, so a typical SOCache is built without touching the heap. Scopes nest, an
+// inner one shares the outer arena
+class RequestArena {
+public:
+    RequestArena();
+    ~RequestArena();
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    google::protobuf::Arena* Get() const { return m_arena; }
+
+    template<typename T>
+    T* Create() const { return google::protobuf::Arena::CreateMessage<T>(m_arena); }
+
+    static void LogStats();
+
+private:
+    google::protobuf::Arena* m_arena;
+};
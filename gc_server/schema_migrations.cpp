@@ -0,0 +1,380 @@
+#include "stdafx.h"
+#include "schema_migrations.hpp"
+#include "db_statements.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <set>
+
+// primary key range updated per backfill batch
+constexpr uint64_t BackfillBatchSize = 5000;
+
+// STEAM_X:Y:Z -> account id 2Z + Y, NULL for anything that isn't a steamid2
+#define ACCOUNT_ID_FROM_STEAMID2(column)                                                    \
+    "IF(" column " LIKE 'STEAM\\_%:%:%', "                                                  \
+    "CAST(SUBSTRING_INDEX(" column ", ':', -1) AS UNSIGNED) * 2 + "                         \
+    "CAST(SUBSTRING_INDEX(SUBSTRING_INDEX(" column ", ':', 2), ':', -1) AS UNSIGNED), NULL)"
+
+// item_id -> item_kind/def_index/paint_index, mirrors GCNetwork_Inventory::ParseItemId
+// ("sticker-123", "crate-4001", "skin-7_44_0"); NULL where the string doesn't fit
+#define ITEM_IS_NUMBERED(column) column " REGEXP '^(music_kit|sticker|crate|key|collectible)-[0-9]+$'"
+#define ITEM_IS_PAINTED(column) column " REGEXP '^.{5}[0-9]+_[0-9]+_'"
+#define ITEM_PREFIX(column) "SUBSTRING_INDEX(" column ", '-', 1)"
+#define ITEM_NUMBER(column) "CAST(SUBSTRING_INDEX(" column ", '-', -1) AS UNSIGNED)"
+
+#define ITEM_KIND_FROM_ITEM_ID(column)                                                                  \
+    "CASE WHEN " ITEM_IS_NUMBERED(column) " "                                                           \
+    "THEN FIELD(" ITEM_PREFIX(column) ", 'music_kit', 'sticker', 'crate', 'key', 'collectible') + 1 "   \
+    "WHEN " column " LIKE 'skin-%' THEN 1 ELSE 0 END"
+
+#define DEF_INDEX_FROM_ITEM_ID(column)                                                                  \
+    "CASE WHEN " ITEM_IS_NUMBERED(column) " "                                                           \
+    "THEN CASE " ITEM_PREFIX(column) " WHEN 'music_kit' THEN 1314 WHEN 'sticker' THEN 1209 "             \
+    "ELSE " ITEM_NUMBER(column) " END "                                                                 \
+    "WHEN " ITEM_IS_PAINTED(column) " "                                                                 \
+    "THEN CAST(SUBSTRING_INDEX(SUBSTRING(" column ", 6), '_', 1) AS UNSIGNED) END"
+
+#define PAINT_INDEX_FROM_ITEM_ID(column)                                                                \
+    "CASE WHEN " ITEM_IS_NUMBERED(column) " "                                                           \
+    "THEN IF(" ITEM_PREFIX(column) " IN ('music_kit', 'sticker'), " ITEM_NUMBER(column) ", 0) "         \
+    "WHEN " ITEM_IS_PAINTED(column) " "                                                                 \
+    "THEN CAST(SUBSTRING_INDEX(SUBSTRING_INDEX(SUBSTRING(" column ", 6), '_', 2), '_', -1) AS UNSIGNED) END"
+
+#define SET_ITEM_TYPE_COLUMNS(column)                                                                   \
+    "SET NEW.item_kind = " ITEM_KIND_FROM_ITEM_ID(column) ", "                                          \
+    "NEW.def_index = " DEF_INDEX_FROM_ITEM_ID(column)
+
+// per receiver totals of player_commends (type 1-3), filled by migration 6 and
+// recomputed by RebuildPlayerCounters
+#define SQL_FILL_COMMEND_COUNTS                                                                     \
+    "INSERT INTO player_commend_counts (receiver_steamid64, friendly, teaching, leader) "           \
+    "SELECT receiver_steamid64, SUM(type = 1), SUM(type = 2), SUM(type = 3) "                       \
+    "FROM player_commends GROUP BY receiver_steamid64 "                                             \
+    "ON DUPLICATE KEY UPDATE friendly = VALUES(friendly), teaching = VALUES(teaching), "            \
+    "leader = VALUES(leader)"
+
+static const char SqlCreateMigrationsTable[] =
+    "CREATE TABLE IF NOT EXISTS gc_schema_migrations ("
+    "version INT UNSIGNED NOT NULL PRIMARY KEY, "
+    "name VARCHAR(128) NOT NULL, "
+    "applied_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP) ENGINE=InnoDB";
+
+const std::vector<SchemaMigration>& SchemaMigrations::Inventory()
+{
+    static const std::vector<SchemaMigration> migrations = {
+        {
+            1, "csgo_items numeric owner key",
+            {
+                "ALTER TABLE csgo_items ADD COLUMN IF NOT EXISTS owner_account_id INT UNSIGNED NULL AFTER owner_steamid2",
+
+                // keeps the column right for writers that only know the steamid2 (website, trades)
+                "CREATE TRIGGER IF NOT EXISTS csgo_items_owner_insert BEFORE INSERT ON csgo_items FOR EACH ROW "
+                "SET NEW.owner_account_id = " ACCOUNT_ID_FROM_STEAMID2("NEW.owner_steamid2"),
+
+                "CREATE TRIGGER IF NOT EXISTS csgo_items_owner_update BEFORE UPDATE ON csgo_items FOR EACH ROW "
+                "BEGIN "
+                "IF NOT (OLD.owner_steamid2 <=> NEW.owner_steamid2) THEN "
+                "SET NEW.owner_account_id = " ACCOUNT_ID_FROM_STEAMID2("NEW.owner_steamid2") "; "
+                "END IF; "
+                "END",
+            },
+            "UPDATE csgo_items SET owner_account_id = " ACCOUNT_ID_FROM_STEAMID2("owner_steamid2") " "
+            "WHERE id >= ? AND id < ? AND owner_account_id IS NULL AND owner_steamid2 IS NOT NULL",
+            "csgo_items",
+        },
+        {
+            // built after the backfill, filling an indexed column is slower
+            2, "csgo_items owner indexes",
+            {
+                "ALTER TABLE csgo_items "
+                "ADD INDEX IF NOT EXISTS idx_owner_account_id (owner_account_id, id), "
+                "ADD INDEX IF NOT EXISTS idx_owner_acknowledged (owner_account_id, acknowledged), "
+                "ALGORITHM=INPLACE, LOCK=NONE",
+            },
+        },
+        {
+            // the outbox is keyed by account id as well, unread events of an older
+            // layout don't matter since the feed starts from the end of it
+            3, "csgo_item_events outbox",
+            {
+                "DROP TRIGGER IF EXISTS csgo_items_event_insert",
+                "DROP TRIGGER IF EXISTS csgo_items_event_update",
+                "DROP TRIGGER IF EXISTS csgo_items_event_delete",
+                "DROP TABLE IF EXISTS csgo_item_events",
+
+                "CREATE TABLE csgo_item_events ("
+                "event_id BIGINT UNSIGNED NOT NULL AUTO_INCREMENT PRIMARY KEY, "
+                "item_id BIGINT UNSIGNED NOT NULL, "
+                "owner_account_id INT UNSIGNED NULL, "
+                "action TINYINT UNSIGNED NOT NULL, "
+                "external TINYINT(1) NOT NULL, "
+                "created_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, "
+                "KEY idx_created_at (created_at)) ENGINE=InnoDB",
+
+                "CREATE TRIGGER csgo_items_event_insert AFTER INSERT ON csgo_items FOR EACH ROW "
+                "INSERT INTO csgo_item_events (item_id, owner_account_id, action, external) "
+                "VALUES (NEW.id, NEW.owner_account_id, 1, @gc_writer IS NULL)",
+
+                // a change of owner is a delete for the old owner and an insert for the new one,
+                // rows rewritten by SchemaMigrations::Backfill (@gc_backfill) aren't events
+                "CREATE TRIGGER csgo_items_event_update AFTER UPDATE ON csgo_items FOR EACH ROW "
+                "BEGIN "
+                "IF @gc_backfill IS NULL THEN "
+                "IF NOT (OLD.owner_account_id <=> NEW.owner_account_id) THEN "
+                "INSERT INTO csgo_item_events (item_id, owner_account_id, action, external) "
+                "VALUES (OLD.id, OLD.owner_account_id, 3, @gc_writer IS NULL), "
+                "(NEW.id, NEW.owner_account_id, 1, @gc_writer IS NULL); "
+                "ELSE "
+                "INSERT INTO csgo_item_events (item_id, owner_account_id, action, external) "
+                "VALUES (NEW.id, NEW.owner_account_id, 2, @gc_writer IS NULL); "
+                "END IF; "
+                "END IF; "
+                "END",
+
+                "CREATE TRIGGER csgo_items_event_delete AFTER DELETE ON csgo_items FOR EACH ROW "
+                "INSERT INTO csgo_item_events (item_id, owner_account_id, action, external) "
+                "VALUES (OLD.id, OLD.owner_account_id, 3, @gc_writer IS NULL)",
+            },
+        },
+        {
+            // typed copies of what item_id encodes, so reads don't parse strings and
+            // slot/medal lookups don't need LIKE scans. paint_index is the existing column,
+            // whatever a writer stored there wins and item_id only fills it where it's NULL
+            4, "csgo_items item type columns",
+            {
+                "ALTER TABLE csgo_items "
+                "ADD COLUMN IF NOT EXISTS def_index INT UNSIGNED NULL AFTER item_id, "
+                "ADD COLUMN IF NOT EXISTS item_kind TINYINT UNSIGNED NOT NULL DEFAULT 0 AFTER paint_index",
+
+                "CREATE TRIGGER IF NOT EXISTS csgo_items_type_insert BEFORE INSERT ON csgo_items FOR EACH ROW "
+                SET_ITEM_TYPE_COLUMNS("NEW.item_id") ", "
+                "NEW.paint_index = COALESCE(NEW.paint_index, " PAINT_INDEX_FROM_ITEM_ID("NEW.item_id") ")",
+
+                // a new item_id only replaces paint_index if the same statement didn't set it
+                "CREATE TRIGGER IF NOT EXISTS csgo_items_type_update BEFORE UPDATE ON csgo_items FOR EACH ROW "
+                "BEGIN "
+                "IF NOT (OLD.item_id <=> NEW.item_id) THEN "
+                SET_ITEM_TYPE_COLUMNS("NEW.item_id") "; "
+                "IF OLD.paint_index <=> NEW.paint_index THEN "
+                "SET NEW.paint_index = COALESCE(" PAINT_INDEX_FROM_ITEM_ID("NEW.item_id") ", NEW.paint_index); "
+                "END IF; "
+                "END IF; "
+                "END",
+            },
+            "UPDATE csgo_items SET "
+            "item_kind = " ITEM_KIND_FROM_ITEM_ID("item_id") ", "
+            "def_index = " DEF_INDEX_FROM_ITEM_ID("item_id") ", "
+            "paint_index = COALESCE(paint_index, " PAINT_INDEX_FROM_ITEM_ID("item_id") ") "
+            "WHERE id >= ? AND id < ? AND def_index IS NULL",
+            "csgo_items",
+        },
+        {
+            5, "csgo_items item kind index",
+            {
+                "ALTER TABLE csgo_items "
+                "ADD INDEX IF NOT EXISTS idx_owner_item_kind (owner_account_id, item_kind), "
+                "ALGORITHM=INPLACE, LOCK=NONE",
+            },
+        },
+        {
+            // commend totals are read on every hello and profile, a GROUP BY over
+            // every commend a player ever got doesn't scale with popular players.
+            // Counts are signed so a decrement can't fail on a drifted row
+            6, "commend counters",
+            {
+                "CREATE TABLE IF NOT EXISTS player_commend_counts ("
+                "receiver_steamid64 BIGINT UNSIGNED NOT NULL PRIMARY KEY, "
+                "friendly INT NOT NULL DEFAULT 0, "
+                "teaching INT NOT NULL DEFAULT 0, "
+                "leader INT NOT NULL DEFAULT 0) ENGINE=InnoDB",
+
+                // maintained in the writer's transaction, whoever the writer is
+                "CREATE TRIGGER IF NOT EXISTS player_commends_count_insert AFTER INSERT ON player_commends FOR EACH ROW "
+                "INSERT INTO player_commend_counts (receiver_steamid64, friendly, teaching, leader) "
+                "VALUES (NEW.receiver_steamid64, NEW.type = 1, NEW.type = 2, NEW.type = 3) "
+                "ON DUPLICATE KEY UPDATE friendly = friendly + VALUES(friendly), "
+                "teaching = teaching + VALUES(teaching), leader = leader + VALUES(leader)",
+
+                "CREATE TRIGGER IF NOT EXISTS player_commends_count_delete AFTER DELETE ON player_commends FOR EACH ROW "
+                "UPDATE player_commend_counts SET friendly = friendly - (OLD.type = 1), "
+                "teaching = teaching - (OLD.type = 2), leader = leader - (OLD.type = 3) "
+                "WHERE receiver_steamid64 = OLD.receiver_steamid64",
+
+                SQL_FILL_COMMEND_COUNTS,
+
+                // token checks only look at the sender's last day/week
+                "ALTER TABLE player_commends "
+                "ADD INDEX IF NOT EXISTS idx_sender_created (sender_steamid64, created_at), "
+                "ALGORITHM=INPLACE, LOCK=NONE",
+
+                "ALTER TABLE player_reports "
+                "ADD INDEX IF NOT EXISTS idx_sender_created (sender_steamid64, created_at), "
+                "ALGORITHM=INPLACE, LOCK=NONE",
+            },
+        },
+        {
+            // bumped by every UPDATE whoever makes it, serialized items are cached per
+            // version (ItemBlobCache) so a changed row can't be served from old bytes
+            7, "csgo_items row version",
+            {
+                "ALTER TABLE csgo_items "
+                "ADD COLUMN IF NOT EXISTS row_version INT UNSIGNED NOT NULL DEFAULT 0",
+
+                "CREATE TRIGGER IF NOT EXISTS csgo_items_row_version BEFORE UPDATE ON csgo_items FOR EACH ROW "
+                "SET NEW.row_version = OLD.row_version + 1",
+            },
+        },
+    };
+    return migrations;
+}
+
+bool SchemaMigrations::Run(MYSQL* mysql, const char* database, const std::vector<SchemaMigration>& migrations)
+{
+    if (mysql_query(mysql, SqlCreateMigrationsTable) != 0) {
+        logger::error("SchemaMigrations: couldn't create gc_schema_migrations in %s: %s", database, mysql_error(mysql));
+        return false;
+    }
+
+    std::set<uint32_t> applied;
+    if (mysql_query(mysql, "SELECT version FROM gc_schema_migrations") != 0) {
+        logger::error("SchemaMigrations: couldn't read applied migrations of %s: %s", database, mysql_error(mysql));
+        return false;
+    }
+
+    MYSQL_RES* result = mysql_store_result(mysql);
+    if (!result) {
+        logger::error("SchemaMigrations: couldn't read applied migrations of %s: %s", database, mysql_error(mysql));
+        return false;
+    }
+
+    while (MYSQL_ROW row = mysql_fetch_row(result)) {
+        applied.insert(static_cast<uint32_t>(strtoul(row[0], nullptr, 10)));
+    }
+    mysql_free_result(result);
+
+    std::vector<const SchemaMigration*> pending;
+    for (const SchemaMigration& migration : migrations) {
+        if (!applied.count(migration.version)) {
+            pending.push_back(&migration);
+        }
+    }
+
+    std::sort(pending.begin(), pending.end(), [](const SchemaMigration* a, const SchemaMigration* b) {
+        return a->version < b->version;
+    });
+
+    for (const SchemaMigration* migration : pending) {
+        logger::info("SchemaMigrations: applying %s migration %u (%s)", database, migration->version, migration->name);
+        if (!Apply(mysql, *migration)) {
+            logger::error("SchemaMigrations: %s migration %u failed", database, migration->version);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool SchemaMigrations::RebuildPlayerCounters(MYSQL* mysql)
+{
+    // the scan of the source tables takes locks in the transaction, so a commend
+    // written meanwhile waits instead of being counted twice or not at all
+    static const char* const statements[] = {
+        "START TRANSACTION",
+        "DELETE FROM player_commend_counts",
+        SQL_FILL_COMMEND_COUNTS,
+        "COMMIT",
+    };
+
+    for (const char* statement : statements) {
+        if (mysql_query(mysql, statement) != 0) {
+            logger::error("SchemaMigrations: rebuilding player counters failed: %s", mysql_error(mysql));
+            mysql_query(mysql, "ROLLBACK");
+            return false;
+        }
+    }
+
+    logger::info("SchemaMigrations: rebuilt player_commend_counts");
+    return true;
+}
+
+bool SchemaMigrations::Apply(MYSQL* mysql, const SchemaMigration& migration)
+{
+    for (const char* statement : migration.statements) {
+        if (mysql_query(mysql, statement) != 0) {
+            logger::error("SchemaMigrations: %s", mysql_error(mysql));
+            return false;
+        }
+    }
+
+    if (migration.backfill && !Backfill(mysql, migration)) {
+        return false;
+    }
+
+    char query[256];
+    snprintf(query, sizeof(query),
+             "INSERT INTO gc_schema_migrations (version, name) VALUES (%u, '%s')",
+             migration.version, migration.name);
+
+    if (mysql_query(mysql, query) != 0) {
+        logger::error("SchemaMigrations: couldn't record migration %u: %s", migration.version, mysql_error(mysql));
+        return false;
+    }
+    return true;
+}
+
+bool SchemaMigrations::Backfill(MYSQL* mysql, const SchemaMigration& migration)
+{
+    char query[256];
+    snprintf(query, sizeof(query), "SELECT COALESCE(MAX(id), 0) FROM %s", migration.backfillTable);
+
+    if (mysql_query(mysql, query) != 0) {
+        logger::error("SchemaMigrations: %s", mysql_error(mysql));
+        return false;
+    }
+
+    MYSQL_RES* result = mysql_store_result(mysql);
+    if (!result) {
+        logger::error("SchemaMigrations: %s", mysql_error(mysql));
+        return false;
+    }
+
+    MYSQL_ROW row = mysql_fetch_row(result);
+    uint64_t maxId = row && row[0] ? strtoull(row[0], nullptr, 10) : 0;
+    mysql_free_result(result);
+
+    // rows written past maxId while this runs are covered by the triggers
+    DbStatement* stmt = DbStatementCache::Get(mysql, migration.backfill);
+    if (!stmt) {
+        return false;
+    }
+
+    // keeps csgo_items_event_update from queueing an event per backfilled row
+    if (mysql_query(mysql, "SET @gc_backfill = 1") != 0) {
+        logger::error("SchemaMigrations: %s", mysql_error(mysql));
+        return false;
+    }
+
+    uint64_t updated = 0;
+    for (uint64_t first = 0; first <= maxId; first += BackfillBatchSize) {
+        stmt->BindUInt64(0, first);
+        stmt->BindUInt64(1, first + BackfillBatchSize);
+        if (!stmt->Execute()) {
+            mysql_query(mysql, "SET @gc_backfill = NULL");
+            return false;
+        }
+
+        updated += stmt->AffectedRows();
+        if ((first / BackfillBatchSize) % 100 == 99) {
+            logger::info("SchemaMigrations: backfilled %s up to id %llu of %llu", migration.backfillTable,
+                         first + BackfillBatchSize, maxId);
+        }
+    }
+
+    if (mysql_query(mysql, "SET @gc_backfill = NULL") != 0) {
+        logger::error("SchemaMigrations: %s", mysql_error(mysql));
+        return false;
+    }
+
+    logger::info("SchemaMigrations: backfilled %llu rows of %s", updated, migration.backfillTable);
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <mariadb/mysql.h>
+
+// one step of a database schema, applied once and recorded in gc_schema_migrations
+// DDL isn't transactional in MySQL, so statements should be idempotent (IF NOT EXISTS)
+// to let a migration that died halfway be rerun
+struct SchemaMigration {
+    uint32_t version;
+    const char* name;
+    std::vector<const char*> statements;
+
+    // optional online data fix run after the statements: an UPDATE with two id
+    // placeholders (first, end) that is walked over the table in primary key
+    // ranges, so no batch holds locks for long
+    const char* backfill = nullptr;
+    const char* backfillTable = nullptr;
+};
+
+// Versioned migration runner
+// Migrations are applied in version order, each one recorded when it completed
+class SchemaMigrations {
+public:
+    // applies pending migrations, false when one fails (later ones aren't tried)
+    static bool Run(MYSQL* mysql, const char* database, const std::vector<SchemaMigration>& migrations);
+
+    // schema of ollum_inventory used by the GC
+    static const std::vector<SchemaMigration>& Inventory();
+
+    // recomputes player_commend_counts from the rows it counts,
+    // repair for counters that drifted (triggers dropped, rows edited by hand)
+    static bool RebuildPlayerCounters(MYSQL* mysql);
+
+private:
+    static bool Apply(MYSQL* mysql, const SchemaMigration& migration);
+    static bool Backfill(MYSQL* mysql, const SchemaMigration& migration);
+};
@@ -0,0 +1,116 @@
+#include "stdafx.h"
+#include "socache_encoder.hpp"
+#include "gc_const.hpp"
+#include "logger.hpp"
+
+#include <cstring>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::internal::WireFormatLite;
+
+// CMsgSOCacheSubscribed.objects, SubscribedType.type_id and SubscribedType.object_data
+constexpr uint32_t ObjectsTag = WireFormatLite::MakeTag(2, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+constexpr uint32_t TypeIdTag = WireFormatLite::MakeTag(1, WireFormatLite::WIRETYPE_VARINT);
+constexpr uint32_t ObjectDataTag = WireFormatLite::MakeTag(2, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+
+SOCacheEncoder::SOCacheEncoder(uint64_t steamId, uint64_t version)
+{
+    m_trailer.set_version(version);
+    m_trailer.mutable_owner_soid()->set_type(SoIdTypeSteamId);
+    m_trailer.mutable_owner_soid()->set_id(steamId);
+}
+
+size_t SOCacheEncoder::AddType(int32_t typeId)
+{
+    m_types.push_back({typeId, {}});
+    return m_types.size() - 1;
+}
+
+void SOCacheEncoder::AddObject(size_t type, const google::protobuf::MessageLite& object)
+{
+    m_types[type].objects.push_back({&object, nullptr});
+}
+
+void SOCacheEncoder::AddSerialized(size_t type, std::shared_ptr<const std::string> data)
+{
+    m_types[type].objects.push_back({nullptr, std::move(data)});
+}
+
+size_t SOCacheEncoder::ObjectCount() const
+{
+    size_t count = 0;
+    for (const Type& type : m_types) {
+        count += type.objects.size();
+    }
+    return count;
+}
+
+NetworkMessage SOCacheEncoder::Encode(uint32_t msgType)
+{
+    // sizes first, ByteSizeLong also caches them for the serialize pass
+    size_t total = 0;
+    for (Type& type : m_types) {
+        type.size = CodedOutputStream::VarintSize32(TypeIdTag) + CodedOutputStream::VarintSize32SignExtended(type.typeId);
+        for (const Object& object : type.objects) {
+            size_t size = object.message ? object.message->ByteSizeLong() : object.data->size();
+            type.size += CodedOutputStream::VarintSize32(ObjectDataTag) + CodedOutputStream::VarintSize32(size) + size;
+        }
+        total += CodedOutputStream::VarintSize32(ObjectsTag) + CodedOutputStream::VarintSize32(type.size) + type.size;
+    }
+    total += m_trailer.ByteSizeLong();
+
+    NetworkMessage::Buffer buffer = NetworkMessage::AcquireBuffer(NetworkHeaderSize + total);
+    uint8_t* target = buffer->data() + NetworkHeaderSize;
+
+    for (const Type& type : m_types) {
+        target = CodedOutputStream::WriteVarint32ToArray(ObjectsTag, target);
+        target = CodedOutputStream::WriteVarint32ToArray(type.size, target);
+        target = CodedOutputStream::WriteVarint32ToArray(TypeIdTag, target);
+        target = CodedOutputStream::WriteVarint32SignExtendedToArray(type.typeId, target);
+
+        for (const Object& object : type.objects) {
+            target = CodedOutputStream::WriteVarint32ToArray(ObjectDataTag, target);
+            target = CodedOutputStream::WriteVarint32ToArray(object.Size(), target);
+            if (object.message) {
+                target = object.message->SerializeWithCachedSizesToArray(target);
+            } else {
+                memcpy(target, object.data->data(), object.data->size());
+                target += object.data->size();
+            }
+        }
+    }
+    target = m_trailer.SerializeWithCachedSizesToArray(target);
+
+    if (target != buffer->data() + buffer->size()) {
+        // only possible if an object changed between the two passes
+        logger::error("SOCacheEncoder: wrote %zu bytes, expected %zu",
+                      static_cast<size_t>(target - buffer->data() - NetworkHeaderSize), total);
+    }
+
+    return NetworkMessage::FromBuffer(std::move(buffer), msgType);
+}
+
+bool SOCacheEncoder::Verify(const NetworkMessage& message) const
+{
+    CMsgSOCacheSubscribed reference = m_trailer;
+    for (const Type& type : m_types) {
+        CMsgSOCacheSubscribed_SubscribedType* object = reference.add_objects();
+        object->set_type_id(type.typeId);
+        for (const Object& data : type.objects) {
+            object->add_object_data(data.message ? data.message->SerializeAsString() : *data.data);
+        }
+    }
+
+    std::string expected = reference.SerializeAsString();
+    if (expected.size() != message.GetPayloadSize() ||
+        memcmp(expected.data(), message.GetPayload(), expected.size()) != 0) {
+        logger::error("SOCacheEncoder: output differs from CMsgSOCacheSubscribed (%u bytes, expected %zu)",
+                      message.GetPayloadSize(), expected.size());
+        return false;
+    }
+
+    return true;
+}
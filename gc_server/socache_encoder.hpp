@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/message_lite.h>
+
+#include "gcsdk_gcmessages.pb.h"
+#include "steam_network_message.hpp"
+
+// Writes a CMsgSOCacheSubscribed straight into the send buffer
+// Sizes are computed up front, then every object is serialized once into its final
+// place behind the reserved network header; no per-object strings and no second
+// pass over the whole message. The output is byte for byte what serializing the
+// equivalent CMsgSOCacheSubscribed gives, Verify checks exactly that
+class SOCacheEncoder {
+public:
+    SOCacheEncoder(uint64_t steamId, uint64_t version);
+
+    // types are written in the order they're added, returns the type's handle
+    size_t AddType(int32_t typeId);
+
+    // the object is only referenced, it has to stay alive and unchanged until Encode
+    void AddObject(size_t type, const google::protobuf::MessageLite& object);
+
+    // an object that's serialized already (ItemBlobCache), copied as is
+    void AddSerialized(size_t type, std::shared_ptr<const std::string> data);
+
+    NetworkMessage Encode(uint32_t msgType);
+
+    // builds the message the old way and compares, for GC_VERIFY_SOCACHE_ENCODER
+    bool Verify(const NetworkMessage& message) const;
+
+    size_t TypeCount() const { return m_types.size(); }
+    size_t ObjectCount() const;
+
+private:
+    // exactly one of the two is set
+    struct Object {
+        const google::protobuf::MessageLite* message;
+        std::shared_ptr<const std::string> data;
+
+        size_t Size() const { return message ? message->GetCachedSize() : data->size(); }
+    };
+
+    struct Type {
+        int32_t typeId;
+        std::vector<Object> objects;
+        size_t size = 0; // SubscribedType body, set by Encode
+    };
+
+    // version and owner, fields 3 and 4 come after the objects (field 2) on the wire
+    CMsgSOCacheSubscribed m_trailer;
+    std::vector<Type> m_types;
+};
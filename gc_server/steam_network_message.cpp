@@ -1,10 +1,28 @@
 // steam_network_message.cpp
 #include "steam_network_message.hpp"
 #include "logger.hpp"
+#include "event_loop.hpp"
+#include "buffer_pool.hpp"
 #include <steam/steam_gameserver.h>
 #include <arpa/inet.h>
+#include <algorithm>
+#include <cstring>
 
-NetworkMessage::NetworkMessage(const void* data, uint32_t size) 
+// replies are sized by the handler, a big SOCache goes past the largest class
+// and is released after the send instead of pinning memory
+static BufferPool s_sendBuffers("send");
+
+NetworkMessage::Buffer NetworkMessage::AcquireBuffer(size_t size)
+{
+    return Buffer(s_sendBuffers.Acquire(size));
+}
+
+void NetworkMessage::LogBufferStats()
+{
+    s_sendBuffers.LogStats();
+}
+
+NetworkMessageView::NetworkMessageView(const void* data, uint32_t size)
 {
     if (size < sizeof(uint32_t)) {
         logger::error("Message too small for header");
@@ -13,27 +31,27 @@ NetworkMessage::NetworkMessage(const void* data, uint32_t size)
 
     memcpy(&m_type, data, sizeof(uint32_t));
 
-    // header = type, header size, chunk count
-    const size_t headerSize = sizeof(uint32_t) * 3;
-    if (size < headerSize) {
+    if (size < NetworkHeaderSize) {
         logger::error("Message too small for full header");
-        m_data.clear();
         return;
     }
 
-    uint32_t chunks;
-    memcpy(&chunks, static_cast<const uint8_t*>(data) + sizeof(uint32_t) * 2, sizeof(uint32_t));
-    
-    const size_t dataSize = size - headerSize;
-    if (dataSize > 0) {
-        m_data.resize(dataSize);
-        memcpy(m_data.data(),
-            static_cast<const uint8_t*>(data) + headerSize,
-            dataSize);
-    }
+    m_payload = static_cast<const uint8_t*>(data) + NetworkHeaderSize;
+    m_payloadSize = size - NetworkHeaderSize;
+    m_valid = true;
 }
 
 bool NetworkMessage::WriteToSocket(SNetSocket_t socket, bool reliable, uint32_t chunks) const {
+    // steam networking is only driven from the loop thread, handlers running
+    // on workers hand their replies over and the send happens on the next wakeup
+    EventLoop* loop = EventLoop::GetInstance();
+    if (!loop->IsLoopThread()) {
+        loop->Post([message = *this, socket, reliable, chunks] {
+            message.WriteToSocket(socket, reliable, chunks);
+        });
+        return true;
+    }
+
     // AutoChunkCalcuator™️
     if (chunks == 0) {
         size_t totalSize = GetTotalSize();
@@ -45,84 +63,62 @@ bool NetworkMessage::WriteToSocket(SNetSocket_t socket, bool reliable, uint32_t
                          : WriteChunkMsg(socket, reliable, chunks);
 }
 
-bool NetworkMessage::WriteSingleMsg(SNetSocket_t socket, bool reliable) const 
+// type w mask, header size, chunk count
+static void WriteHeader(uint8_t* target, uint32_t type, uint32_t chunks)
 {
-    std::vector<uint8_t> fullMessage;
-
-    // type w mask
-    uint32_t maskedType = m_type | CCProtoMask;
-    fullMessage.insert(fullMessage.end(),
-        reinterpret_cast<const uint8_t*>(&maskedType),
-        reinterpret_cast<const uint8_t*>(&maskedType) + sizeof(maskedType));
-
-    // header size
-    uint32_t headerSize = 0;
-    fullMessage.insert(fullMessage.end(),
-        reinterpret_cast<const uint8_t*>(&headerSize),
-        reinterpret_cast<const uint8_t*>(&headerSize) + sizeof(headerSize));
-
-    // chunk count (always 1 in this function)
-    uint32_t chunkCount = 1;
-    fullMessage.insert(fullMessage.end(),
-        reinterpret_cast<const uint8_t*>(&chunkCount),
-        reinterpret_cast<const uint8_t*>(&chunkCount) + sizeof(chunkCount));
+    uint32_t header[3] = { type | CCProtoMask, 0, chunks };
+    memcpy(target, header, sizeof(header));
+}
 
-    // write
-    fullMessage.insert(fullMessage.end(), m_data.begin(), m_data.end());
+bool NetworkMessage::WriteSingleMsg(SNetSocket_t socket, bool reliable) const 
+{
+    // the header slot was reserved when the payload was serialized
+    WriteHeader(m_buffer->data(), m_type, 1);
 
     return SteamGameServerNetworking()->SendDataOnSocket(
         socket,
-        fullMessage.data(),
-        fullMessage.size(),
+        m_buffer->data(),
+        m_buffer->size(),
         reliable ? k_EP2PSendReliable : k_EP2PSendUnreliable
     );
 }
 
 bool NetworkMessage::WriteChunkMsg(SNetSocket_t socket, bool reliable, uint32_t chunks) const 
 {
-    const size_t chunkSize = (m_data.size() + chunks - 1) / chunks;
+    const size_t payloadSize = GetPayloadSize();
+    const size_t chunkSize = (payloadSize + chunks - 1) / chunks;
     
     logger::info("Splitting message - Total size: %zu, Chunks: %u, Chunk size: %zu",
-                 m_data.size(), chunks, chunkSize);
+                 payloadSize, chunks, chunkSize);
+
+    uint8_t* payload = m_buffer->data() + NetworkHeaderSize;
 
     for (uint32_t i = 0; i < chunks; i++) 
     {
-        std::vector<uint8_t> chunkMessage;
-
-        // type w mask
-        uint32_t maskedType = m_type | CCProtoMask;
-        chunkMessage.insert(chunkMessage.end(),
-            reinterpret_cast<const uint8_t*>(&maskedType),
-            reinterpret_cast<const uint8_t*>(&maskedType) + sizeof(maskedType));
-
-        // header size
-        uint32_t headerSize = 0;
-        chunkMessage.insert(chunkMessage.end(),
-            reinterpret_cast<const uint8_t*>(&headerSize),
-            reinterpret_cast<const uint8_t*>(&headerSize) + sizeof(headerSize));
-
-        // chunk count
-        chunkMessage.insert(chunkMessage.end(),
-            reinterpret_cast<const uint8_t*>(&chunks),
-            reinterpret_cast<const uint8_t*>(&chunks) + sizeof(chunks));
-
         // Calculate chunk bounds
-        size_t startPos = i * chunkSize;
-        size_t endPos = std::min(startPos + chunkSize, m_data.size());
-            
-        // write payload
-        chunkMessage.insert(chunkMessage.end(), 
-            m_data.begin() + startPos,
-            m_data.begin() + endPos);
+        size_t startPos = std::min(i * chunkSize, payloadSize);
+        size_t endPos = std::min(startPos + chunkSize, payloadSize);
 
-        logger::info("Sending chunk %u/%u - Size: %zu", i + 1, chunks, chunkMessage.size());
+        // each chunk's header goes over the tail of the previous chunk, which was
+        // sent already (SendDataOnSocket copies) and is put back right after
+        uint8_t* chunkStart = payload + startPos - NetworkHeaderSize;
+        uint8_t saved[NetworkHeaderSize];
+        memcpy(saved, chunkStart, NetworkHeaderSize);
+        WriteHeader(chunkStart, m_type, chunks);
 
-        if (!SteamGameServerNetworking()->SendDataOnSocket(
+        size_t messageSize = NetworkHeaderSize + (endPos - startPos);
+        logger::info("Sending chunk %u/%u - Size: %zu", i + 1, chunks, messageSize);
+
+        bool sent = SteamGameServerNetworking()->SendDataOnSocket(
             socket,
-            chunkMessage.data(),
-            chunkMessage.size(),
+            chunkStart,
+            messageSize,
             reliable ? k_EP2PSendReliable : k_EP2PSendUnreliable
-        )) {
+        );
+
+        memcpy(chunkStart, saved, NetworkHeaderSize);
+
+        if (!sent) {
             logger::error("Failed to send chunk %u/%u", i + 1, chunks);
             return false;
         }
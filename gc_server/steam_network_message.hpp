@@ -4,52 +4,88 @@
 #include <steam/steam_api.h>
 #include <memory>
 #include <string>
+#include <vector>
 #include "cc_gcmessages.pb.h"
 
+// header = type, header size, chunk count
+constexpr size_t NetworkHeaderSize = sizeof(uint32_t) * 3;
+
+// Read-only view of a received message, the payload is parsed straight out of
+// the receive buffer which has to outlive the view
+class NetworkMessageView {
+	public:
+		NetworkMessageView(const void* data, uint32_t size);
+
+		// a truncated message parses as an empty payload, same as before
+		template<typename T>
+		bool ParseTo(T* msg) const {
+			return msg->ParseFromArray(m_payload, static_cast<int>(m_payloadSize));
+		}
+
+		bool IsValid() const { return m_valid; }
+		uint32_t GetType() const { return m_type & ~CCProtoMask; }
+		const uint8_t* GetPayload() const { return m_payload; }
+		uint32_t GetPayloadSize() const { return m_payloadSize; }
+
+	private:
+		uint32_t m_type = 0;
+		const uint8_t* m_payload = nullptr;
+		uint32_t m_payloadSize = 0;
+		bool m_valid = false;
+	};
+
+// Outgoing message, the payload is serialized into a pooled buffer behind room
+// for the header so sending doesn't copy it again. Copies share the buffer
 class NetworkMessage {
 	public:
 		static constexpr size_t MAX_CHUNK_SIZE = 1024;
 
-		explicit NetworkMessage(const void* data, uint32_t size);
-	
+		using Buffer = std::shared_ptr<std::vector<uint8_t>>;
+
 		// create proto msgs
 		template<typename T>
 		static NetworkMessage FromProto(const T& msg, uint32_t msgType) {
 			NetworkMessage message;
 			message.m_type = msgType;
 			size_t size = msg.ByteSizeLong();
-			message.m_data.resize(size);
-			msg.SerializeToArray(message.m_data.data(), size);
+			message.m_buffer = AcquireBuffer(NetworkHeaderSize + size);
+			msg.SerializeWithCachedSizesToArray(message.m_buffer->data() + NetworkHeaderSize);
 			return message;
 		}
 
-		bool WriteToSocket(SNetSocket_t socket, bool reliable, uint32_t chunks = 0) const;
-
-		// parse msg types
-		template<typename T>
-		bool ParseTo(T* msg) const {
-			return msg->ParseFromArray(m_data.data(), m_data.size());
+		// payload already written behind the reserved header, see AcquireBuffer
+		static NetworkMessage FromBuffer(Buffer buffer, uint32_t msgType) {
+			NetworkMessage message;
+			message.m_type = msgType;
+			message.m_buffer = std::move(buffer);
+			return message;
 		}
 
+		bool WriteToSocket(SNetSocket_t socket, bool reliable, uint32_t chunks = 0) const;
+
 		// get msg type
 		uint32_t GetType() const { return m_type & ~CCProtoMask; }
-		
-		// get raw data
-		const std::vector<uint8_t>& GetData() const { return m_data; }
+
+		const uint8_t* GetPayload() const { return m_buffer->data() + NetworkHeaderSize; }
+		uint32_t GetPayloadSize() const { return m_buffer->size() - NetworkHeaderSize; }
 
 		// get total size
 		uint32_t GetTotalSize() const {
 			return sizeof(uint32_t) +  // type
 				   sizeof(uint32_t) +  // header size
-				   m_data.size();      // payload
+				   GetPayloadSize();   // payload
 		}
 
 		static uint16_t GetTypeFromData(const void* data, uint32_t size);
 
+		// recycled send buffers, see LogBufferStats
+		static Buffer AcquireBuffer(size_t size);
+		static void LogBufferStats();
+
 	private:
 		NetworkMessage() = default;
 		uint32_t m_type = 0;
-		std::vector<uint8_t> m_data;
+		Buffer m_buffer;
 
 		// helpers for WriteToSocket
 		bool WriteSingleMsg(SNetSocket_t socket, bool reliable) const;
@@ -0,0 +1,203 @@
+// SOCacheEncoder output against CMsgSOCacheSubscribed::SerializeAsString
+// Encodes the object mix SendSOCache produces (nametag, cached items, item blobs,
+// default equips, an empty type, persona and account client) and compares the payload
+// byte for byte with the message built the old way. No database or Steam connection
+#include "stdafx.h"
+#include "socache_encoder.hpp"
+#include "gc_const.hpp"
+#include "gc_const_csgo.hpp"
+#include "base_gcmessages.pb.h"
+#include "cstrike15_gcmessages.pb.h"
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+
+constexpr uint64_t SteamId = 76561198000000000ull;
+constexpr uint32_t AccountId = SteamId & 0xFFFFFFFF;
+
+static int s_failures = 0;
+
+static void Check(bool ok, const char* what)
+{
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        s_failures++;
+    }
+}
+
+static void MakeItem(CSOEconItem& item, uint64_t id, uint32_t position)
+{
+    item.set_id(id);
+    item.set_account_id(AccountId);
+    item.set_def_index(static_cast<uint32_t>(id % 600));
+    item.set_inventory(position);
+    item.set_level(1);
+    item.set_quality(4);
+    item.set_origin(kEconItemOrigin_Purchased);
+    item.set_rarity(static_cast<uint32_t>(id % 7));
+
+    // variable sized fields, so length prefixes of one and two bytes both show up
+    if (id % 3 == 0) {
+        item.set_custom_name(std::string(id % 150, 'n'));
+    }
+
+    CSOEconItemAttribute* paint = item.add_attribute();
+    paint->set_def_index(6);
+    float seed = static_cast<float>(id);
+    paint->set_value_bytes(&seed, sizeof(seed));
+}
+
+// one encoder and the reference message, every object goes to both
+class Fixture {
+public:
+    Fixture() : m_encoder(SteamId, InventoryVersion)
+    {
+        m_expected.set_version(InventoryVersion);
+        m_expected.mutable_owner_soid()->set_type(SoIdTypeSteamId);
+        m_expected.mutable_owner_soid()->set_id(SteamId);
+    }
+
+    size_t AddType(int32_t typeId)
+    {
+        m_expected.add_objects()->set_type_id(typeId);
+        return m_encoder.AddType(typeId);
+    }
+
+    void AddObject(size_t type, const google::protobuf::MessageLite& object)
+    {
+        m_expected.mutable_objects(static_cast<int>(type))->add_object_data(object.SerializeAsString());
+        m_encoder.AddObject(type, object);
+    }
+
+    void AddSerialized(size_t type, const google::protobuf::MessageLite& object)
+    {
+        auto data = std::make_shared<const std::string>(object.SerializeAsString());
+        m_expected.mutable_objects(static_cast<int>(type))->add_object_data(*data);
+        m_encoder.AddSerialized(type, data);
+    }
+
+    bool EncodeAndCompare(const char* name)
+    {
+        NetworkMessage message = m_encoder.Encode(k_EMsgGC_CC_GC2CL_SOCacheSubscribed);
+        std::string expected = m_expected.SerializeAsString();
+
+        bool same = message.GetPayloadSize() == expected.size() &&
+                    memcmp(message.GetPayload(), expected.data(), expected.size()) == 0;
+        if (!same) {
+            printf("%s: %u bytes encoded, %zu expected\n", name, message.GetPayloadSize(), expected.size());
+        }
+        Check(same, name);
+        Check(m_encoder.Verify(message), "Verify agrees with the comparison");
+        return same;
+    }
+
+private:
+    SOCacheEncoder m_encoder;
+    CMsgSOCacheSubscribed m_expected;
+};
+
+static void TestEmpty()
+{
+    Fixture fixture;
+    fixture.EncodeAndCompare("no types");
+}
+
+static void TestLogin()
+{
+    Fixture fixture;
+
+    // objects are only referenced by the encoder, keep them at stable addresses
+    std::deque<CSOEconItem> items;
+    std::deque<CSOEconDefaultEquippedDefinitionInstanceClient> equips;
+
+    size_t itemType = fixture.AddType(SOTypeItem);
+
+    CSOEconItem& nametag = items.emplace_back();
+    nametag.set_id(1);
+    nametag.set_account_id(AccountId);
+    nametag.set_def_index(1200);
+    nametag.set_inventory(1);
+    nametag.set_level(1);
+    nametag.set_quality(0);
+    nametag.set_flags(0);
+    nametag.set_origin(kEconItemOrigin_Purchased);
+    nametag.set_rarity(1);
+    fixture.AddObject(itemType, nametag);
+
+    // cached items and ItemBlobCache hits interleaved, as a partly warm cache gives them
+    for (uint32_t i = 0; i < 300; i++) {
+        CSOEconItem& item = items.emplace_back();
+        MakeItem(item, 1000 + i * 77777ull, i + 2);
+        if (i % 2) {
+            fixture.AddSerialized(itemType, item);
+        } else {
+            fixture.AddObject(itemType, item);
+        }
+    }
+
+    size_t equipType = fixture.AddType(SOTypeDefaultEquippedDefinitionInstanceClient);
+    const uint32_t defaults[][3] = {{61, 3, 2}, {60, 3, 15}, {64, 3, 6}, {64, 2, 6}, {63, 3, 5}, {63, 2, 5}};
+    for (const auto& [definition, classId, slot] : defaults) {
+        CSOEconDefaultEquippedDefinitionInstanceClient& equip = equips.emplace_back();
+        equip.set_account_id(AccountId);
+        equip.set_item_definition(definition);
+        equip.set_class_id(classId);
+        equip.set_slot_id(slot);
+        fixture.AddObject(equipType, equip);
+    }
+
+    // a type without objects is still written with its id
+    fixture.AddType(SOTypeItemRecipe);
+
+    CSOPersonaDataPublic persona;
+    persona.set_player_level(1);
+    persona.set_elevated_state(true);
+    fixture.AddObject(fixture.AddType(SOTypePersonaDataPublic), persona);
+
+    CSOEconGameAccountClient accountClient;
+    accountClient.set_additional_backpack_slots(0);
+    accountClient.set_bonus_xp_timestamp_refresh(1700000000);
+    accountClient.set_bonus_xp_usedflags(16);
+    accountClient.set_elevated_state(5);
+    accountClient.set_elevated_timestamp(5);
+    fixture.AddObject(fixture.AddType(SOTypeGameAccountClient), accountClient);
+
+    // an empty object, zero length object_data
+    CSOEconItem empty;
+    fixture.AddObject(fixture.AddType(SOTypeItem), empty);
+
+    fixture.EncodeAndCompare("login SOCache");
+}
+
+static void TestLargeType()
+{
+    // a type body past 2 MiB needs a four byte length prefix
+    Fixture fixture;
+    std::deque<CSOEconItem> items;
+
+    size_t itemType = fixture.AddType(SOTypeItem);
+    for (uint32_t i = 0; i < 20000; i++) {
+        CSOEconItem& item = items.emplace_back();
+        MakeItem(item, 5000000 + i, i + 2);
+        item.set_custom_name(std::string(100, 'x'));
+        fixture.AddObject(itemType, item);
+    }
+
+    fixture.EncodeAndCompare("large type");
+}
+
+int main()
+{
+    TestEmpty();
+    TestLogin();
+    TestLargeType();
+
+    if (s_failures) {
+        printf("%d checks failed\n", s_failures);
+        return 1;
+    }
+
+    printf("socache_encoder_test passed\n");
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "stdafx.h"
+#include "timer_scheduler.hpp"
+#include "logger.hpp"
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+TimerScheduler::TaskId TimerScheduler::Schedule(const std::string& name, Clock::duration interval,
+                                                Clock::duration jitter, Callback callback, bool runImmediately)
+{
+    TaskId id = m_nextId++;
+
+    Task& task = m_tasks[id];
+    task.name = name;
+    task.interval = interval;
+    task.jitter = jitter;
+    task.callback = std::move(callback);
+
+    Clock::time_point due = Clock::now();
+    if (!runImmediately) {
+        due += NextDelay(task);
+    }
+    m_heap.push({due, id});
+
+    return id;
+}
+
+void TimerScheduler::Cancel(TaskId id)
+{
+    // the heap entry is dropped lazily when it comes due
+    m_tasks.erase(id);
+}
+
+size_t TimerScheduler::RunDue(Clock::time_point now)
+{
+    size_t ran = 0;
+
+    while (!m_heap.empty() && m_heap.top().due <= now) {
+        HeapEntry entry = m_heap.top();
+        m_heap.pop();
+
+        auto it = m_tasks.find(entry.id);
+        if (it == m_tasks.end()) {
+            continue; // cancelled
+        }
+
+        // moved out while running so the callback can safely cancel itself
+        Callback callback = std::move(it->second.callback);
+
+        Clock::time_point start = Clock::now();
+        callback();
+        Clock::time_point end = Clock::now();
+        ran++;
+
+        it = m_tasks.find(entry.id);
+        if (it == m_tasks.end()) {
+            continue;
+        }
+
+        Task& task = it->second;
+        task.callback = std::move(callback);
+        Clock::duration runtime = end - start;
+        task.stats.runs++;
+        task.stats.totalRuntime += runtime;
+        task.stats.maxRuntime = std::max(task.stats.maxRuntime, runtime);
+        task.stats.maxLateness = std::max(task.stats.maxLateness, Clock::duration(start - entry.due));
+
+        // reschedule from the intended due time so the cadence doesn't drift,
+        // but never into the past after a long stall
+        Clock::time_point due = entry.due + NextDelay(task);
+        if (due <= end) {
+            due = end + NextDelay(task);
+        }
+        m_heap.push({due, entry.id});
+    }
+
+    return ran;
+}
+
+TimerScheduler::Clock::time_point TimerScheduler::NextDeadline() const
+{
+    return m_heap.empty() ? Clock::time_point::max() : m_heap.top().due;
+}
+
+void TimerScheduler::LogStats() const
+{
+    for (const auto& pair : m_tasks) {
+        const Task& task = pair.second;
+        if (task.stats.runs == 0) {
+            continue;
+        }
+
+        long long avgUs = duration_cast<microseconds>(task.stats.totalRuntime).count() / (long long)task.stats.runs;
+        logger::info("Scheduler: %s ran %llu times, avg %lld us, max %lld us, max late %lld ms",
+                     task.name.c_str(),
+                     task.stats.runs,
+                     avgUs,
+                     (long long)duration_cast<microseconds>(task.stats.maxRuntime).count(),
+                     (long long)duration_cast<milliseconds>(task.stats.maxLateness).count());
+    }
+}
+
+TimerScheduler::Clock::duration TimerScheduler::NextDelay(const Task& task)
+{
+    if (task.jitter <= Clock::duration::zero()) {
+        return task.interval;
+    }
+
+    std::uniform_int_distribution<Clock::rep> dist(0, task.jitter.count());
+    return task.interval + Clock::duration(dist(m_jitterEngine));
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Min-heap scheduler for periodic GC work
+// Intervals are measured on the monotonic clock so the firing rate no longer depends
+// on how fast the main loop spins. Not thread safe, owned and driven by the loop thread
+class TimerScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using TaskId = uint32_t;
+    using Callback = std::function<void()>;
+
+    struct TaskStats {
+        uint64_t runs = 0;
+        Clock::duration totalRuntime{0};
+        Clock::duration maxRuntime{0};
+        Clock::duration maxLateness{0};
+    };
+
+    // jitter adds a uniform random delay in [0, jitter] to every interval so jobs
+    // scheduled together drift apart instead of firing in the same iteration
+    TaskId Schedule(const std::string& name, Clock::duration interval, Clock::duration jitter,
+                    Callback callback, bool runImmediately = false);
+    void Cancel(TaskId id);
+
+    // runs every task due at 'now', returns how many ran
+    size_t RunDue(Clock::time_point now);
+
+    // Clock::time_point::max() when nothing is scheduled
+    Clock::time_point NextDeadline() const;
+
+    void LogStats() const;
+
+private:
+    struct Task {
+        std::string name;
+        Clock::duration interval;
+        Clock::duration jitter;
+        Callback callback;
+        TaskStats stats;
+    };
+
+    struct HeapEntry {
+        Clock::time_point due;
+        TaskId id;
+
+        bool operator>(const HeapEntry& other) const { return due > other.due; }
+    };
+
+    Clock::duration NextDelay(const Task& task);
+
+    std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> m_heap;
+    std::unordered_map<TaskId, Task> m_tasks;
+    TaskId m_nextId = 1;
+    std::mt19937 m_jitterEngine{ std::random_device{}() };
+};
@@ -0,0 +1,150 @@
+#include "stdafx.h"
+#include "worker_pool.hpp"
+#include "logger.hpp"
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+WorkerPool::~WorkerPool()
+{
+    Stop();
+}
+
+void WorkerPool::Start(size_t threadCount, ThreadHook onStart, ThreadHook onStop)
+{
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = false;
+    }
+
+    for (size_t i = 0; i < threadCount; i++) {
+        m_threads.emplace_back(&WorkerPool::WorkerMain, this, onStart, onStop);
+    }
+
+    logger::info("Started %zu worker threads", threadCount);
+}
+
+void WorkerPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_threads.empty()) {
+            return;
+        }
+        m_stopping = true;
+    }
+    m_wakeup.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+
+    LogStats();
+}
+
+void WorkerPool::Submit(uint64_t key, Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        Strand& strand = m_strands[key];
+        bool idle = strand.tasks.empty();
+        strand.tasks.push_back({std::move(task), Clock::now()});
+
+        // a strand is either idle, queued in m_ready or being run by a worker;
+        // only an idle strand needs to be made ready
+        if (idle) {
+            m_ready.push_back(key);
+        }
+
+        m_pending++;
+        m_maxPending = std::max(m_maxPending, m_pending);
+    }
+    m_wakeup.notify_one();
+}
+
+void WorkerPool::WorkerMain(ThreadHook onStart, ThreadHook onStop)
+{
+    if (onStart) {
+        onStart();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_wakeup.wait(lock, [this] { return !m_ready.empty() || m_stopping; });
+
+        if (m_ready.empty()) {
+            break; // stopping and drained
+        }
+
+        uint64_t key = m_ready.front();
+        m_ready.pop_front();
+
+        // the task stays at the front of its strand while running so Submit
+        // sees the strand as busy and doesn't make it ready a second time
+        QueuedTask& front = m_strands[key].tasks.front();
+        Task task = std::move(front.task);
+        Clock::time_point queuedAt = front.queuedAt;
+
+        lock.unlock();
+
+        Clock::time_point start = Clock::now();
+        task();
+        Clock::time_point end = Clock::now();
+
+        uint64_t queueUs = duration_cast<microseconds>(start - queuedAt).count();
+        m_totalQueueUs += queueUs;
+        m_totalRunUs += duration_cast<microseconds>(end - start).count();
+        m_completed++;
+
+        uint64_t maxQueueUs = m_maxQueueUs.load();
+        while (queueUs > maxQueueUs && !m_maxQueueUs.compare_exchange_weak(maxQueueUs, queueUs)) {}
+
+        lock.lock();
+
+        m_pending--;
+
+        auto it = m_strands.find(key);
+        it->second.tasks.pop_front();
+        if (it->second.tasks.empty()) {
+            m_strands.erase(it);
+        } else {
+            // back of the line so one busy player can't starve the others
+            m_ready.push_back(key);
+            m_wakeup.notify_one();
+        }
+    }
+
+    lock.unlock();
+
+    if (onStop) {
+        onStop();
+    }
+}
+
+void WorkerPool::LogStats() const
+{
+    uint64_t completed = m_completed.load();
+    if (completed == 0) {
+        return;
+    }
+
+    size_t maxPending;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        maxPending = m_maxPending;
+    }
+
+    logger::info("Workers: %llu tasks, avg queue %llu us, max queue %llu us, avg run %llu us, max pending %zu",
+                 completed,
+                 m_totalQueueUs.load() / completed,
+                 m_maxQueueUs.load(),
+                 m_totalRunUs.load() / completed,
+                 maxPending);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Thread pool for DB-bound handlers
+// Tasks are submitted with a key (the player's steamid); tasks sharing a key form
+// a strand and run one at a time in submission order, different keys run in parallel
+class WorkerPool {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Task = std::function<void()>;
+    using ThreadHook = std::function<void()>;
+
+    ~WorkerPool();
+
+    // onStart/onStop run on every worker thread, e.g. to open per-thread resources
+    void Start(size_t threadCount, ThreadHook onStart = nullptr, ThreadHook onStop = nullptr);
+
+    // runs everything already queued, then joins
+    void Stop();
+
+    void Submit(uint64_t key, Task task);
+
+    size_t ThreadCount() const { return m_threads.size(); }
+    void LogStats() const;
+
+private:
+    struct QueuedTask {
+        Task task;
+        Clock::time_point queuedAt;
+    };
+
+    struct Strand {
+        std::deque<QueuedTask> tasks;
+    };
+
+    void WorkerMain(ThreadHook onStart, ThreadHook onStop);
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::unordered_map<uint64_t, Strand> m_strands;
+    std::deque<uint64_t> m_ready; // strands with work that no worker is running
+    std::vector<std::thread> m_threads;
+    bool m_stopping = false;
+
+    // stats
+    std::atomic<uint64_t> m_completed{0};
+    std::atomic<uint64_t> m_totalQueueUs{0};
+    std::atomic<uint64_t> m_maxQueueUs{0};
+    std::atomic<uint64_t> m_totalRunUs{0};
+    size_t m_maxPending = 0;
+    size_t m_pending = 0;
+};
@@ -0,0 +1,377 @@
+#include "stdafx.h"
+#include "write_behind.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <mariadb/errmsg.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+constexpr size_t BatchSize = 500;
+// consecutive failures of a batch before its rows are tried one at a time
+constexpr uint32_t MaxAttempts = 5;
+constexpr std::chrono::milliseconds MaxBackoff{30000};
+
+// errors below the client range come from the server rejecting the statement,
+// retrying won't help; client errors (lost connection etc.) are worth a retry
+static bool IsServerError(unsigned int error)
+{
+    return error != 0 && error < CR_MIN_ERROR;
+}
+
+WriteBehindQueue* WriteBehindQueue::GetInstance()
+{
+    static WriteBehindQueue instance;
+    return &instance;
+}
+
+bool WriteBehindQueue::Open(const std::string& journalPath)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_journalPath = journalPath;
+
+    // W <seq> <kind> <id> <other> <types> <match id> for every write,
+    // C <seq> once everything up to seq is applied
+    std::vector<Write> writes;
+    uint64_t checkpoint = 0;
+    if (FILE* file = fopen(journalPath.c_str(), "r")) {
+        char line[256];
+        while (fgets(line, sizeof(line), file)) {
+            unsigned long long seq, id, other, matchId;
+            unsigned int kind, types;
+            if (sscanf(line, "W %llu %u %llu %llu %u %llu", &seq, &kind, &id, &other, &types, &matchId) == 6) {
+                writes.push_back({seq, static_cast<WriteKind>(kind), id, other, types, matchId});
+            } else if (sscanf(line, "C %llu", &seq) == 1) {
+                checkpoint = std::max<uint64_t>(checkpoint, seq);
+            }
+        }
+        fclose(file);
+    }
+
+    for (const Write& write : writes) {
+        m_nextSeq = std::max(m_nextSeq, write.seq + 1);
+        if (write.seq > checkpoint) {
+            m_queue.push_back(write);
+            TrackReport(write, true);
+        }
+    }
+
+    // start over with only what's still pending
+    if (!RewriteJournal()) {
+        logger::error("WriteBehindQueue: couldn't open journal %s, writes are kept in memory only", journalPath.c_str());
+        return false;
+    }
+
+    if (!m_queue.empty()) {
+        logger::info("WriteBehindQueue: replaying %zu writes from %s", m_queue.size(), journalPath.c_str());
+    }
+    return true;
+}
+
+void WriteBehindQueue::Close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_journal) {
+        fclose(m_journal);
+        m_journal = nullptr;
+    }
+
+    if (!m_queue.empty()) {
+        logger::warning("WriteBehindQueue: %zu writes left in %s for the next start", m_queue.size(), m_journalPath.c_str());
+    }
+}
+
+void WriteBehindQueue::PlayerReport(uint64_t senderSteamId, uint64_t receiverSteamId, uint32_t types, uint64_t matchId)
+{
+    Append({0, WriteKind::PlayerReport, senderSteamId, receiverSteamId, types, matchId});
+}
+
+void WriteBehindQueue::CrateItemSeen(uint64_t itemId)
+{
+    Append({0, WriteKind::CrateItemSeen, itemId, 0, 0, 0});
+}
+
+void WriteBehindQueue::Append(Write write)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    write.seq = m_nextSeq++;
+    WriteJournal(write);
+    m_queue.push_back(write);
+    TrackReport(write, true);
+    m_enqueued++;
+}
+
+void WriteBehindQueue::TrackReport(const Write& write, bool queued)
+{
+    if (write.kind != WriteKind::PlayerReport) {
+        return;
+    }
+
+    auto key = std::make_pair(write.id, write.other);
+    if (queued) {
+        if (m_pendingReports[key]++ == 0) {
+            m_pendingReporters[write.id]++;
+        }
+        return;
+    }
+
+    auto it = m_pendingReports.find(key);
+    if (it == m_pendingReports.end() || --it->second > 0) {
+        return;
+    }
+    m_pendingReports.erase(it);
+
+    auto sender = m_pendingReporters.find(write.id);
+    if (sender != m_pendingReporters.end() && --sender->second == 0) {
+        m_pendingReporters.erase(sender);
+    }
+}
+
+bool WriteBehindQueue::IsReportPending(uint64_t senderSteamId, uint64_t receiverSteamId) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pendingReports.count(std::make_pair(senderSteamId, receiverSteamId)) != 0;
+}
+
+uint32_t WriteBehindQueue::PendingReportCount(uint64_t senderSteamId) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pendingReporters.find(senderSteamId);
+    return it != m_pendingReporters.end() ? it->second : 0;
+}
+
+void WriteBehindQueue::WriteJournal(const Write& write)
+{
+    if (!m_journal) {
+        return;
+    }
+
+    // flushed to the OS, survives the process but not the machine going down
+    fprintf(m_journal, "W %llu %u %llu %llu %u %llu\n",
+            static_cast<unsigned long long>(write.seq), static_cast<unsigned int>(write.kind),
+            static_cast<unsigned long long>(write.id), static_cast<unsigned long long>(write.other),
+            write.types, static_cast<unsigned long long>(write.matchId));
+    fflush(m_journal);
+}
+
+// writes the pending set to <journal>.tmp and renames it over the journal, the old
+// journal stays intact until the new one is on disk. m_mutex held
+bool WriteBehindQueue::RewriteJournal()
+{
+    if (m_journal) {
+        fclose(m_journal);
+        m_journal = nullptr;
+    }
+
+    std::string tmpPath = m_journalPath + ".tmp";
+    bool replaced = false;
+    if (FILE* tmp = fopen(tmpPath.c_str(), "w")) {
+        m_journal = tmp;
+        for (const Write& write : m_queue) {
+            WriteJournal(write);
+        }
+        m_journal = nullptr;
+
+#ifdef _WIN32
+        bool synced = fflush(tmp) == 0 && _commit(_fileno(tmp)) == 0;
+#else
+        bool synced = fflush(tmp) == 0 && fsync(fileno(tmp)) == 0;
+#endif
+        fclose(tmp);
+
+        std::error_code error;
+        if (synced) {
+            std::filesystem::rename(tmpPath, m_journalPath, error);
+        }
+        replaced = synced && !error;
+    }
+
+    if (!replaced) {
+        logger::error("WriteBehindQueue: couldn't replace journal %s, keeping the old one", m_journalPath.c_str());
+    }
+
+    // on failure this appends to the old journal, which still holds every pending write
+    m_journal = fopen(m_journalPath.c_str(), "a");
+    return m_journal != nullptr;
+}
+
+bool WriteBehindQueue::Flush(MYSQL* mysql)
+{
+    Clock::time_point now = Clock::now();
+    if (now < m_retryAt) {
+        return false;
+    }
+
+    // only this strand pops, so the batch is still at the front afterwards
+    std::vector<Write> batch;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t count = std::min(m_queue.size(), BatchSize);
+        batch.assign(m_queue.begin(), m_queue.begin() + count);
+    }
+
+    if (batch.empty()) {
+        return true;
+    }
+
+    size_t done = batch.size();
+    if (!Apply(mysql, batch)) {
+        m_failedBatches++;
+        m_failures++;
+
+        done = 0;
+        if (m_failures >= MaxAttempts && IsServerError(m_lastError)) {
+            done = ApplyEach(mysql, batch);
+        }
+
+        if (done == 0) {
+            std::chrono::milliseconds backoff = std::min(MaxBackoff, std::chrono::milliseconds(250 << std::min(m_failures, 8u)));
+            m_retryAt = now + backoff;
+            logger::warning("WriteBehindQueue: batch of %zu writes failed (%u times), retrying in %lldms",
+                            batch.size(), m_failures, static_cast<long long>(backoff.count()));
+            return false;
+        }
+    }
+
+    m_failures = 0;
+    m_retryAt = Clock::time_point();
+
+    // committed (or dropped) by now, the database checks see these rows
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i < done; i++) {
+        TrackReport(m_queue[i], false);
+    }
+    m_queue.erase(m_queue.begin(), m_queue.begin() + done);
+    if (m_journal) {
+        fprintf(m_journal, "C %llu\n", static_cast<unsigned long long>(batch[done - 1].seq));
+        fflush(m_journal);
+        if (m_queue.empty()) {
+            // nothing pending, the journal can start over
+            RewriteJournal();
+        }
+    }
+    return done == batch.size();
+}
+
+bool WriteBehindQueue::FlushAll(MYSQL* mysql)
+{
+    uint32_t failures = 0;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_queue.empty()) {
+                return true;
+            }
+        }
+
+        m_retryAt = Clock::time_point();
+        if (Flush(mysql)) {
+            failures = 0;
+        } else if (++failures >= MaxAttempts * 2) {
+            return false;
+        }
+    }
+}
+
+bool WriteBehindQueue::Apply(MYSQL* mysql, const std::vector<Write>& writes)
+{
+    std::string reports;
+    std::vector<uint64_t> crateItems;
+
+    char values[128];
+    for (const Write& write : writes) {
+        switch (write.kind) {
+        case WriteKind::PlayerReport:
+            for (uint32_t type = 1; type <= 32; type++) {
+                if (!(write.types & (1u << (type - 1)))) {
+                    continue;
+                }
+                snprintf(values, sizeof(values), "%s(%llu, %llu, %u, %llu)", reports.empty() ? "" : ", ",
+                         static_cast<unsigned long long>(write.id), static_cast<unsigned long long>(write.other),
+                         type, static_cast<unsigned long long>(write.matchId));
+                reports += values;
+            }
+            break;
+        case WriteKind::CrateItemSeen:
+            crateItems.push_back(write.id);
+            break;
+        }
+    }
+
+    std::vector<std::string> statements;
+    if (!reports.empty()) {
+        statements.push_back("INSERT INTO player_reports (sender_steamid64, receiver_steamid64, type, match_id) VALUES " + reports);
+    }
+
+    if (!crateItems.empty()) {
+        std::sort(crateItems.begin(), crateItems.end());
+        crateItems.erase(std::unique(crateItems.begin(), crateItems.end()), crateItems.end());
+
+        std::string update = "UPDATE csgo_items SET acquired_by = 'crate' WHERE id IN (";
+        for (size_t i = 0; i < crateItems.size(); i++) {
+            if (i > 0) {
+                update += ',';
+            }
+            update += std::to_string(crateItems[i]);
+        }
+        update += ')';
+        statements.push_back(std::move(update));
+    }
+
+    if (statements.empty()) {
+        return true;
+    }
+
+    statements.insert(statements.begin(), "START TRANSACTION");
+    statements.push_back("COMMIT");
+
+    for (const std::string& statement : statements) {
+        if (mysql_query(mysql, statement.c_str()) != 0) {
+            logger::error("WriteBehindQueue: %s", mysql_error(mysql));
+            // ROLLBACK resets the error, keep the one that failed the batch
+            m_lastError = mysql_errno(mysql);
+            mysql_query(mysql, "ROLLBACK");
+            return false;
+        }
+    }
+
+    m_lastError = 0;
+    m_applied += writes.size();
+    m_batches++;
+    return true;
+}
+
+size_t WriteBehindQueue::ApplyEach(MYSQL* mysql, const std::vector<Write>& writes)
+{
+    size_t done = 0;
+    for (const Write& write : writes) {
+        if (!Apply(mysql, {write})) {
+            if (!IsServerError(m_lastError)) {
+                break; // connection trouble, the rest is retried later
+            }
+
+            logger::error("WriteBehindQueue: dropping write %llu (kind %u), the server rejected it",
+                          static_cast<unsigned long long>(write.seq), static_cast<unsigned int>(write.kind));
+            m_dropped++;
+        }
+        done++;
+    }
+    return done;
+}
+
+void WriteBehindQueue::LogStats() const
+{
+    size_t pending;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pending = m_queue.size();
+    }
+
+    logger::info("WriteBehindQueue: %zu pending, %llu enqueued, %llu applied in %llu batches, %llu failed batches, %llu dropped",
+                 pending, m_enqueued.load(), m_applied.load(), m_batches.load(), m_failedBatches.load(), m_dropped.load());
+}
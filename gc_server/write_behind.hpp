@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <mariadb/mysql.h>
+
+// Database writes the client doesn't wait for
+// Handlers enqueue and reply right away, a SystemStrand job applies the queue in
+// batches: report rows go out as one multi-row INSERT, crate item updates are
+// coalesced into one UPDATE, each batch in its own transaction.
+// Every write is appended to a journal before Enqueue returns and replayed at the next
+// Open if the process dies before it was applied. A crash between a batch's COMMIT and
+// its checkpoint line replays that batch, so writes are applied at least once.
+// Failed batches are retried with backoff; rows the server keeps rejecting are
+// eventually applied one by one and the bad ones dropped. Thread safe
+class WriteBehindQueue {
+public:
+    static WriteBehindQueue* GetInstance();
+
+    // loads writes left over in the journal, before the first Flush
+    bool Open(const std::string& journalPath);
+    void Close();
+
+    // types is a mask, bit n set for report type n + 1
+    void PlayerReport(uint64_t senderSteamId, uint64_t receiverSteamId, uint32_t types, uint64_t matchId);
+    // acquired_by '0' -> 'crate', the unbox response already showed the item
+    void CrateItemSeen(uint64_t itemId);
+
+    // reports still queued aren't in player_reports yet, the token and weekly
+    // duplicate checks add these to what they read from the database
+    bool IsReportPending(uint64_t senderSteamId, uint64_t receiverSteamId) const;
+    // distinct receivers with a queued report from this sender
+    uint32_t PendingReportCount(uint64_t senderSteamId) const;
+
+    // applies one batch unless a retry is pending, false on failure
+    bool Flush(MYSQL* mysql);
+    // shutdown, ignores the backoff and applies batches until the queue is empty
+    bool FlushAll(MYSQL* mysql);
+
+    void LogStats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class WriteKind : uint32_t {
+        PlayerReport = 1,
+        CrateItemSeen = 2,
+    };
+
+    struct Write {
+        uint64_t seq;
+        WriteKind kind;
+        uint64_t id;    // report sender, item id
+        uint64_t other; // report receiver
+        uint32_t types;
+        uint64_t matchId;
+    };
+
+    void Append(Write write);
+    void TrackReport(const Write& write, bool queued);
+    void WriteJournal(const Write& write);
+    bool RewriteJournal();
+    bool Apply(MYSQL* mysql, const std::vector<Write>& writes);
+    size_t ApplyEach(MYSQL* mysql, const std::vector<Write>& writes);
+
+    mutable std::mutex m_mutex;
+    std::deque<Write> m_queue;
+    FILE* m_journal = nullptr;
+    std::string m_journalPath;
+    uint64_t m_nextSeq = 1;
+    // (sender, receiver) -> queued report writes, sender -> distinct receivers
+    std::map<std::pair<uint64_t, uint64_t>, uint32_t> m_pendingReports;
+    std::map<uint64_t, uint32_t> m_pendingReporters;
+
+    // flush strand only
+    uint32_t m_failures = 0;
+    unsigned int m_lastError = 0;
+    Clock::time_point m_retryAt;
+
+    // stats
+    std::atomic<uint64_t> m_enqueued{0};
+    std::atomic<uint64_t> m_applied{0};
+    std::atomic<uint64_t> m_batches{0};
+    std::atomic<uint64_t> m_failedBatches{0};
+    std::atomic<uint64_t> m_dropped{0};
+};